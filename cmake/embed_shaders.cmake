@@ -0,0 +1,35 @@
+# Writes every compiled SPIR-V file into a C source as a uint32_t array,
+# so the executable does not need the shaders directory at runtime.
+# Usage: cmake -DSHADER_FILES="a.spv|b.spv" -DOUTPUT=embedded_shaders.c -P embed_shaders.cmake
+
+string(REPLACE "|" ";" SHADER_FILES "${SHADER_FILES}")
+
+set(CONTENT "// Generated by cmake/embed_shaders.cmake, do not edit\n#include \"vk/vk_fun.h\"\n\n")
+set(TABLE "")
+set(INDEX 0)
+foreach(SHADER_FILE ${SHADER_FILES})
+    get_filename_component(SHADER_NAME ${SHADER_FILE} NAME)
+    file(READ ${SHADER_FILE} SHADER_HEX HEX)
+    string(LENGTH "${SHADER_HEX}" SHADER_HEX_LENGTH)
+    math(EXPR SHADER_SIZE "${SHADER_HEX_LENGTH} / 2")
+    math(EXPR SHADER_REMAINDER "${SHADER_SIZE} % 4")
+    if(NOT SHADER_REMAINDER EQUAL 0)
+        message(FATAL_ERROR "${SHADER_FILE} is not a whole number of SPIR-V words")
+    endif()
+
+    # SPIR-V words are little endian on disk
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])" "0x\\4\\3\\2\\1," SHADER_WORDS "${SHADER_HEX}")
+    string(APPEND CONTENT "static const uint32_t shader${INDEX}[] = {${SHADER_WORDS}};\n")
+    string(APPEND TABLE "    {\"shaders/${SHADER_NAME}\", shader${INDEX}, ${SHADER_SIZE}},\n")
+    math(EXPR INDEX "${INDEX} + 1")
+endforeach()
+
+string(APPEND CONTENT "\nconst embeddedShader embeddedShaders[] = {\n${TABLE}};\nconst uint32_t embeddedShaderNum = ${INDEX};\n")
+
+# Only touch the output when it changed, to avoid needless rebuilds
+if(EXISTS ${OUTPUT})
+    file(READ ${OUTPUT} OLD_CONTENT)
+endif()
+if(NOT "${OLD_CONTENT}" STREQUAL "${CONTENT}")
+    file(WRITE ${OUTPUT} "${CONTENT}")
+endif()
@@ -1,6 +1,14 @@
 #ifndef SHARED_BUFFER_H
 #define SHARED_BUFFER_H
 #include "std_c.h"
+#include <stdatomic.h>
+
+#define PHYSICSSTEP (1.0f / 120.0f) // seconds simulated per physics step, whatever the frame rate
+#define PHYSICSMAXLAG 0.25f // seconds of steps caught up at most after a stall
+#define TRIPLEBUFFERFRESH 4u // set on the middle slot index until the reader takes it
+#define ARENAHALFWIDTH 10.0f // the walls are at plus and minus this in x and y
+#define ARENAHEIGHT 10.0f // the floor is at zero
+#define PLAYERRADIUS 0.25f // how far the player's and camera's centers stay inside the arena
 
 typedef enum PossiblePlayerStates {
     ON_GROUND,
@@ -12,6 +20,12 @@ typedef enum PossiblePlayerStates {
     ON_CEILING
 } possiblePlayerStates;
 
+typedef enum LatencyModes {
+    LATENCY_LOWEST,         // immediate/mailbox, fewest queued images
+    LATENCY_BALANCED,       // mailbox with triple buffering
+    LATENCY_POWER_SAVING    // fifo, capped at the refresh rate
+} latencyModes;
+
 typedef struct DynamicArray {
     void* array;    // array of elements
     int elemSize;   // size of each element
@@ -20,6 +34,13 @@ typedef struct DynamicArray {
     int minc;       // minimum capacity
 } vec;
 
+// indices into three caller owned slots, one writer and one reader thread
+typedef struct TripleBuffer {
+    atomic_uint middle; // last published slot, shared by both sides
+    uint32_t back; // written by the writer only
+    uint32_t front; // read by the reader only
+} tripleBuffer;
+
 typedef struct ThreeDimensionalObject {
     float pos[3]; //xyz (center)
     float dimension[3]; //xyz (depth,width,height)
@@ -43,7 +64,21 @@ typedef struct SharedBuffer {
     possiblePlayerStates playerState;
     float fov; //degrees
     bool thirdPerson;
+    latencyModes latencyMode;
+    bool depthPrepass; //depth only scene pass before the shaded one
+    uint64_t pollTime; //timer ticks taken right before glfwPollEvents
 } sharedBuffer;
 
+// The parts of a physics step the renderer blends between the last two steps
+typedef struct PhysicsPose {
+    float playerPos[3];
+    float playerRotation[3];
+    float cameraPos[3];
+    float cameraTarget[3];
+    float fov;
+} physicsPose;
+
 void update(sharedBuffer *pBuffer);
+void getPhysicsPose(const sharedBuffer *pBuffer, physicsPose *pPose);
+void interpolatePhysicsPose(sharedBuffer *pBuffer, const physicsPose *pPrevious, const float alpha);
 #endif // SHARED_BUFFER_H
\ No newline at end of file
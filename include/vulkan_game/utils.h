@@ -4,6 +4,7 @@
 #include "shared_buffer.h"
 // Utility functions and definitions
 #define PI 3.14159265358979323846
+#define HASHSEED 0xcbf29ce484222325ULL
 void printMatrix(const char* name, float matrix[4][4]);
 float lerp(const float a, const float b, const float t, const float dt, const float mindiff);
 float lerpDegrees(const float a, const float b, const float t, const float dt, const float mindiff);
@@ -22,5 +23,12 @@ void vectorAdd(vec *m, void* newElem);
 void vectorRem(vec* m, int index);
 void vectorCheckCapacity(vec *m);
 void initVector(vec *m, int elemSize, int capacity, int minCapacity);
+void copyVector(vec *dst, const vec src);
 void deleteVector(vec *m);
+
+void initTripleBuffer(tripleBuffer *pTriple);
+void publishTripleBuffer(tripleBuffer *pTriple);
+bool acquireTripleBuffer(tripleBuffer *pTriple);
+
+uint64_t hashBytes(const void *data, const size_t size, const uint64_t seed);
 #endif // UTILS_H
\ No newline at end of file
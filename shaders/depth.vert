@@ -0,0 +1,23 @@
+#version 450
+
+// position only stream of the depth pre-pass, the rest of vertex_t is skipped by the stride
+layout (location = 0) in vec3 inPos;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 view;
+	mat4 model;
+} ubo;
+
+out gl_PerVertex 
+{
+	vec4 gl_Position;
+};
+// same expression as scene.vert, the main pass compares depth for equality
+invariant gl_Position;
+
+void main() 
+{
+	gl_Position = ubo.projection * ubo.view * ubo.model * vec4(inPos.xyz, 1.0);
+}
@@ -0,0 +1,95 @@
+// clustered point lights and their atlas shadows, shared by scene.frag and quadric.frag
+// expects the ubo with view and clusterParams
+
+// every scene pipeline specializes these to CLUSTERX, CLUSTERY and CLUSTERZ from vk_fun.h
+layout (constant_id = 0) const uint CLUSTERX = 1;
+layout (constant_id = 1) const uint CLUSTERY = 1;
+layout (constant_id = 2) const uint CLUSTERZ = 1;
+
+struct PointLight
+{
+	vec4 posRadius;
+	vec4 colorIntensity;
+};
+
+layout (std430, binding = 2) readonly buffer Lights
+{
+	PointLight lights[];
+};
+
+// offset and count into the index list, per cluster
+layout (std430, binding = 3) readonly buffer Grid
+{
+	uvec2 clusters[];
+};
+
+layout (std430, binding = 4) readonly buffer LightIndices
+{
+	uint lightIndices[];
+};
+
+// cube faces of the shadow casting lights, the first ones in the light list, packed into one atlas
+layout (binding = 5) uniform sampler2D shadowAtlas;
+
+struct ShadowFace
+{
+	mat4 viewProj;
+	vec4 rect; // atlas uv offset, uv size, nonzero once rendered
+};
+
+struct ShadowRecord
+{
+	ShadowFace faces[6];
+	vec4 posFar; // where the faces were rendered from, the light has moved on since
+};
+
+layout (std430, binding = 6) readonly buffer Shadows
+{
+	uvec4 shadowInfo; // caster count, atlas size
+	ShadowRecord shadowRecords[];
+};
+
+#define ATLAS_EPSILON 0.01
+
+// one for lights without a rendered atlas face in this direction
+float atlasShadow(uint light, vec3 worldPos)
+{
+	if(light >= shadowInfo.x){
+		return 1.0;
+	}
+	vec3 lightVec = worldPos - shadowRecords[light].posFar.xyz;
+	vec3 a = abs(lightVec);
+	uint face = a.x >= a.y && a.x >= a.z ? (lightVec.x >= 0.0 ? 0u : 1u) : a.y >= a.z ? (lightVec.y >= 0.0 ? 2u : 3u) : (lightVec.z >= 0.0 ? 4u : 5u);
+	vec4 rect = shadowRecords[light].faces[face].rect;
+	if(rect.w == 0.0){
+		return 1.0;
+	}
+	vec4 clip = shadowRecords[light].faces[face].viewProj * vec4(worldPos, 1.0);
+	float halfTexel = 0.5 / float(shadowInfo.y);
+	vec2 uv = rect.xy + clamp((clip.xy / clip.w * 0.5 + 0.5) * rect.z, halfTexel, rect.z - halfTexel);
+	float sampledDist = textureLod(shadowAtlas, uv, 0.0).r;
+	return length(lightVec) / shadowRecords[light].posFar.w > sampledDist + ATLAS_EPSILON ? 0.0 : 1.0;
+}
+
+// diffuse light of the point lights binned into this fragment's cluster
+vec3 clusteredLighting(vec3 worldPos, vec3 N)
+{
+	float depth = -(ubo.view * vec4(worldPos, 1.0)).z;
+	float slice = log(max(depth, 1e-4)) * ubo.clusterParams.z + ubo.clusterParams.w;
+	uvec3 cluster = uvec3(min(uvec2(gl_FragCoord.xy * ubo.clusterParams.xy), uvec2(CLUSTERX - 1, CLUSTERY - 1)), uint(clamp(slice, 0.0, float(CLUSTERZ - 1))));
+	uvec2 range = clusters[(cluster.z * CLUSTERY + cluster.y) * CLUSTERX + cluster.x];
+	vec3 lighting = vec3(0.0);
+	for(uint i = 0; i < range.y; i++){
+		uint index = lightIndices[range.x + i];
+		PointLight light = lights[index];
+		vec3 L = light.posRadius.xyz - worldPos;
+		float dist = length(L);
+		float falloff = clamp(1.0 - (dist * dist) / (light.posRadius.w * light.posRadius.w), 0.0, 1.0);
+		float diffuse = max(dot(N, L / max(dist, 1e-4)), 0.0) * falloff * falloff;
+		if(diffuse > 0.0){
+			diffuse *= atlasShadow(index, worldPos);
+		}
+		lighting += diffuse * light.colorIntensity.rgb * light.colorIntensity.w;
+	}
+	return lighting;
+}
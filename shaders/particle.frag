@@ -0,0 +1,16 @@
+#version 450
+
+layout (location = 0) in vec3 inColor;
+layout (location = 1) in vec2 inCorner;
+
+layout (location = 0) out vec4 outFragColor;
+
+// a soft disc, added to the scene color
+void main()
+{
+	float r2 = dot(inCorner, inCorner);
+	if(r2 > 1.0){
+		discard;
+	}
+	outFragColor = vec4(inColor * (1.0 - r2), 1.0);
+}
@@ -0,0 +1,73 @@
+#version 450
+
+layout (set = 0, binding = 0) uniform UBO
+{
+	mat4 projection;
+	mat4 view;
+} ubo;
+
+struct Particle
+{
+	vec4 posLife;
+	vec4 velocity; // velocity, emitter index
+};
+
+struct Emitter
+{
+	vec4 posLife; // spawn center, longest life
+	vec4 velocity;
+	vec4 color; // rgb, billboard half size
+	vec4 physics;
+	uint first;
+	uint count;
+	float rate;
+	float pad;
+};
+
+layout (std430, set = 1, binding = 0) readonly buffer Params
+{
+	uvec4 info; // parity, emitter count, capacity, seed
+	float dt;
+	uint reset;
+	uvec2 pad;
+	Emitter emitters[8];
+};
+
+layout (std430, set = 1, binding = 1) readonly buffer State
+{
+	Particle particles[];
+};
+
+layout (location = 0) out vec3 outColor;
+layout (location = 1) out vec2 outCorner;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+const vec2 CORNERS[6] = vec2[](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0));
+
+// one instance per pool slot, the half particles.comp wrote this frame
+void main()
+{
+	Particle p = particles[(1u - info.x) * info.z + gl_InstanceIndex];
+	if(p.posLife.w <= 0.0){
+		gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+		outColor = vec3(0.0);
+		outCorner = vec2(0.0);
+		return;
+	}
+	Emitter emitter = emitters[uint(p.velocity.w)];
+	vec2 corner = CORNERS[gl_VertexIndex];
+
+	// the camera right and up axes are the first two rows of the view rotation
+	vec3 right = vec3(ubo.view[0][0], ubo.view[1][0], ubo.view[2][0]);
+	vec3 up = vec3(ubo.view[0][1], ubo.view[1][1], ubo.view[2][1]);
+	vec3 pos = p.posLife.xyz + (right * corner.x + up * corner.y) * emitter.color.w;
+	gl_Position = ubo.projection * ubo.view * vec4(pos, 1.0);
+
+	// fades out over the last quarter of the longest life
+	outColor = emitter.color.rgb * clamp(p.posLife.w / (0.25 * emitter.posLife.w), 0.0, 1.0);
+	outCorner = corner;
+}
@@ -0,0 +1,76 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 view;
+	mat4 model;
+	vec4 lightPos;
+	mat4 currViewProj;
+	mat4 prevViewProj;
+	vec4 clusterParams; // clusters per pixel in x and y, scale and bias of the log depth slice
+} ubo;
+
+layout (binding = 1) uniform samplerCube shadowCubeMap;
+
+layout (location = 0) in vec3 inWorldPos;
+layout (location = 1) flat in vec4 inCenter;
+layout (location = 2) flat in vec3 inRadii;
+layout (location = 3) flat in mat3 inAxes;
+layout (location = 6) flat in vec3 inColor;
+layout (location = 7) flat in vec3 inEyePos;
+
+layout (location = 0) out vec4 outFragColor;
+// only in quadric_velocity.frag, like scene.frag
+#ifdef WRITE_VELOCITY
+layout (location = 1) out vec2 outVelocity;
+#endif
+
+// same lighting as scene.frag
+#define EPSILON 0.005
+#define Ambient 0.7
+#define distanceLightFactor 4.0
+#define lightSourceSize 0.08
+
+#include "lighting.glsl"
+
+#include "quadric.glsl"
+
+void main() 
+{
+	vec3 dir = normalize(inWorldPos - inEyePos);
+	float t;
+	vec3 normal;
+	if(!intersectQuadric(transpose(inAxes) * (inEyePos - inCenter.xyz), transpose(inAxes) * dir, inCenter.w > 0.5, inRadii, t, normal)){
+		discard;
+	}
+	vec3 worldPos = inEyePos + t * dir;
+	vec4 clip = ubo.projection * ubo.view * ubo.model * vec4(worldPos, 1.0);
+	gl_FragDepth = clip.z / clip.w;
+
+	vec3 N = normalize(inAxes * normal);
+	vec3 L = normalize(ubo.lightPos.xyz - worldPos);
+	float diffuse = max(dot(N, L), 0.0)/2 + Ambient;
+
+	vec3 lightVec = worldPos - ubo.lightPos.xyz;
+	float sampledDist = texture(shadowCubeMap, lightVec).r;
+	float dist = length(lightVec) / length(vec3(10.1));
+	if(dist > sampledDist + EPSILON)
+	{
+		diffuse = Ambient;
+	}
+
+	outFragColor = vec4(diffuse * vec4(inColor, 1.0));
+	outFragColor.rgb *= 1.0 - dist / distanceLightFactor;
+	if(dist < lightSourceSize){
+		outFragColor.rgb *= lightSourceSize/dist;
+	}
+	outFragColor.rgb += inColor * clusteredLighting(worldPos, N);
+
+#ifdef WRITE_VELOCITY
+	vec4 curr = ubo.currViewProj * ubo.model * vec4(worldPos, 1.0);
+	vec4 prev = ubo.prevViewProj * ubo.model * vec4(worldPos, 1.0);
+	outVelocity = (curr.xy / curr.w - prev.xy / prev.w) * 0.5;
+#endif
+}
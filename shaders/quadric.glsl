@@ -0,0 +1,59 @@
+// shared by the colour and shadow quadric shaders so the two paths cannot drift apart
+
+// outward facing counter clockwise triangles over the corners, bit 0 is x, bit 1 is y, bit 2 is z
+const int boxIndices[36] = int[](
+	0, 4, 2, 2, 4, 6,
+	1, 3, 5, 3, 7, 5,
+	0, 1, 4, 1, 5, 4,
+	2, 6, 3, 3, 6, 7,
+	0, 2, 1, 1, 2, 3,
+	4, 5, 6, 5, 7, 6
+);
+
+// nearest hit in front of the origin, origin and direction in the quadric's unrotated frame around its center
+bool intersectQuadric(vec3 origin, vec3 dir, bool cylinder, vec3 radii, out float t, out vec3 normal)
+{
+	t = 1e30;
+	if(!cylinder){
+		vec3 o = origin / radii;
+		vec3 d = dir / radii;
+		float a = dot(d, d);
+		float b = dot(o, d);
+		float disc = b * b - a * (dot(o, o) - 1.0);
+		if(disc < 0.0){
+			return false;
+		}
+		float t0 = (-b - sqrt(disc)) / a;
+		float t1 = (-b + sqrt(disc)) / a;
+		t = t0 > 0.0 ? t0 : t1;
+		normal = (origin + t * dir) / (radii * radii);
+		return t > 0.0;
+	}
+	// elliptic cylinder along z, the side first, then both caps
+	vec2 o = origin.xy / radii.xy;
+	vec2 d = dir.xy / radii.xy;
+	float a = dot(d, d);
+	float b = dot(o, d);
+	float disc = b * b - a * (dot(o, o) - 1.0);
+	if(a > 0.0 && disc >= 0.0){
+		for(int i = -1; i <= 1; i += 2){
+			float s = (-b + i * sqrt(disc)) / a;
+			vec3 p = origin + s * dir;
+			if(s > 0.0 && s < t && abs(p.z) <= radii.z){
+				t = s;
+				normal = vec3(p.xy / (radii.xy * radii.xy), 0.0);
+			}
+		}
+	}
+	if(abs(dir.z) > 0.0){
+		for(int i = -1; i <= 1; i += 2){
+			float s = (i * radii.z - origin.z) / dir.z;
+			vec2 p = (origin.xy + s * dir.xy) / radii.xy;
+			if(s > 0.0 && s < t && dot(p, p) <= 1.0){
+				t = s;
+				normal = vec3(0.0, 0.0, i);
+			}
+		}
+	}
+	return t < 1e30;
+}
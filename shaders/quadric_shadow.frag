@@ -0,0 +1,40 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 view;
+	mat4 model;
+	vec4 lightPos;
+} ubo;
+
+layout(push_constant) uniform PushConsts 
+{
+	mat4 view;
+} pushConsts;
+
+layout (location = 0) in vec3 inWorldPos;
+layout (location = 1) flat in vec4 inCenter;
+layout (location = 2) flat in vec3 inRadii;
+layout (location = 3) flat in mat3 inAxes;
+
+layout (location = 0) out float outFragColor;
+
+#include "quadric.glsl"
+
+void main() 
+{
+	vec3 dir = normalize(inWorldPos - ubo.lightPos.xyz);
+	float t;
+	vec3 normal;
+	if(!intersectQuadric(transpose(inAxes) * (ubo.lightPos.xyz - inCenter.xyz), transpose(inAxes) * dir, inCenter.w > 0.5, inRadii, t, normal)){
+		discard;
+	}
+	vec3 worldPos = ubo.lightPos.xyz + t * dir;
+	vec4 clip = ubo.projection * pushConsts.view * ubo.model * vec4(worldPos, 1.0);
+	gl_FragDepth = clip.z / clip.w;
+
+	// same distance encoding as shadow.frag
+	outFragColor = t / length(vec3(10.1));
+}
@@ -0,0 +1,49 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// same instances and bounding box as quadric.vert, seen from the light
+layout (location = 0) in vec4 inCenter;
+layout (location = 1) in vec4 inRadii;
+layout (location = 2) in vec4 inAxisX;
+layout (location = 3) in vec4 inAxisY;
+layout (location = 4) in vec4 inAxisZ;
+layout (location = 5) in vec4 inColor;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 view;
+	mat4 model;
+	vec4 lightPos;
+} ubo;
+
+layout(push_constant) uniform PushConsts 
+{
+	mat4 view;
+} pushConsts;
+
+layout (location = 0) out vec3 outWorldPos;
+layout (location = 1) flat out vec4 outCenter;
+layout (location = 2) flat out vec3 outRadii;
+layout (location = 3) flat out mat3 outAxes;
+
+out gl_PerVertex 
+{
+	vec4 gl_Position;
+};
+
+#include "quadric.glsl"
+
+void main()
+{
+	int corner = boxIndices[gl_VertexIndex];
+	vec3 local = vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1) * 2.0 - 1.0;
+	mat3 axes = mat3(inAxisX.xyz, inAxisY.xyz, inAxisZ.xyz);
+	vec3 worldPos = inCenter.xyz + axes * (local * inRadii.xyz);
+
+	gl_Position = ubo.projection * pushConsts.view * ubo.model * vec4(worldPos, 1.0);
+	outWorldPos = worldPos;
+	outCenter = inCenter;
+	outRadii = inRadii.xyz;
+	outAxes = axes;
+}
@@ -1,4 +1,16 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 view;
+	mat4 model;
+	vec4 lightPos;
+	mat4 currViewProj;
+	mat4 prevViewProj;
+	vec4 clusterParams; // clusters per pixel in x and y, scale and bias of the log depth slice
+} ubo;
 
 layout (binding = 1) uniform samplerCube shadowCubeMap;
 
@@ -8,8 +20,14 @@ layout (location = 2) in vec3 inEyePos;
 layout (location = 3) in vec3 inLightVec;
 layout (location = 4) in vec3 inWorldPos;
 layout (location = 5) in vec3 inLightPos;
+layout (location = 6) in vec4 inCurrClip;
+layout (location = 7) in vec4 inPrevClip;
 
 layout (location = 0) out vec4 outFragColor;
+// only in scene_velocity.frag, the temporal upscaling variant whose pass has a second color attachment for the motion vectors
+#ifdef WRITE_VELOCITY
+layout (location = 1) out vec2 outVelocity;
+#endif
 
 #define EPSILON 0.005
 #define SHADOW_OPACITY 0.96
@@ -19,6 +37,8 @@ layout (location = 0) out vec4 outFragColor;
 //#define SPECULAR_INTENSITY 1.0
 //#define SHININESS 32.0
 
+#include "lighting.glsl"
+
 void main() 
 {
 
@@ -53,4 +73,11 @@ void main()
 	if(dist < lightSourceSize){
 	outFragColor.rgb *= lightSourceSize/dist;
 	}
+
+	outFragColor.rgb += inColor * clusteredLighting(inWorldPos, N);
+
+	// screen space motion since the last frame, in texture coordinates
+#ifdef WRITE_VELOCITY
+	outVelocity = (inCurrClip.xy / inCurrClip.w - inPrevClip.xy / inPrevClip.w) * 0.5;
+#endif
 }
\ No newline at end of file
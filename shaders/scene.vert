@@ -10,6 +10,8 @@ layout (binding = 0) uniform UBO
 	mat4 view;
 	mat4 model;
 	vec4 lightPos;
+	mat4 currViewProj; // without jitter, for motion vectors
+	mat4 prevViewProj;
 } ubo;
 
 layout (location = 0) out vec3 outNormal;
@@ -18,11 +20,15 @@ layout (location = 2) out vec3 outEyePos;
 layout (location = 3) out vec3 outLightVec;
 layout (location = 4) out vec3 outWorldPos;
 layout (location = 5) out vec3 outLightPos;
+layout (location = 6) out vec4 outCurrClip;
+layout (location = 7) out vec4 outPrevClip;
 
 out gl_PerVertex 
 {
 	vec4 gl_Position;
 };
+// matches depth.vert bit for bit, the depth pre-pass tests for equality
+invariant gl_Position;
 
 void main() 
 {
@@ -35,5 +41,8 @@ void main()
 	outWorldPos = inPos;
 	
 	outLightPos = ubo.lightPos.xyz;
+
+	outCurrClip = ubo.currViewProj * ubo.model * vec4(inPos, 1.0);
+	outPrevClip = ubo.prevViewProj * ubo.model * vec4(inPos, 1.0);
 }
 
@@ -0,0 +1,14 @@
+#version 450
+
+layout (location = 0) in vec3 inWorldPos;
+layout (location = 1) flat in vec4 inPosFar;
+
+layout (location = 0) out float outFragColor;
+
+layout (constant_id = 0) const bool CLEAR = false;
+
+void main()
+{
+	// distance to the light over the face far plane, like shadow.frag, a cleared tile is unoccluded
+	outFragColor = CLEAR ? 1.0 : length(inWorldPos - inPosFar.xyz) / inPosFar.w;
+}
@@ -0,0 +1,70 @@
+#version 450
+
+layout (location = 0) in vec3 inPos;
+
+layout (location = 0) out vec3 outWorldPos;
+layout (location = 1) flat out vec4 outPosFar;
+
+struct ShadowFace
+{
+	mat4 viewProj;
+	vec4 rect; // atlas uv offset, uv size, nonzero once rendered
+};
+
+struct ShadowRecord
+{
+	ShadowFace faces[6];
+	vec4 posFar;
+};
+
+layout (std430, binding = 6) readonly buffer Shadows
+{
+	uvec4 info; // caster count, atlas size
+	ShadowRecord records[];
+};
+
+// record * 6 + face per draw slot, ~0 for slots without a face this frame
+layout (std430, binding = 7) readonly buffer ShadowSlots
+{
+	uint slots[];
+};
+
+layout (push_constant) uniform PushConsts
+{
+	uint slot;
+} consts;
+
+// a far plane triangle over the whole face instead of the meshes, resets the tile before they are drawn
+layout (constant_id = 0) const bool CLEAR = false;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+	float gl_ClipDistance[4];
+};
+
+void main()
+{
+	uint face = slots[consts.slot];
+	if(face == 0xffffffffu){
+		gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+		gl_ClipDistance[0] = -1.0;
+		gl_ClipDistance[1] = -1.0;
+		gl_ClipDistance[2] = -1.0;
+		gl_ClipDistance[3] = -1.0;
+		return;
+	}
+	ShadowRecord record = records[face / 6];
+	vec4 rect = record.faces[face % 6].rect;
+	vec4 clip = CLEAR ? vec4(gl_VertexIndex == 1 ? 3.0 : -1.0, gl_VertexIndex == 2 ? 3.0 : -1.0, 1.0, 1.0) : record.faces[face % 6].viewProj * vec4(inPos, 1.0);
+
+	// the face frustum sides become the tile edges, the viewport covers the whole atlas
+	gl_ClipDistance[0] = clip.w - clip.x;
+	gl_ClipDistance[1] = clip.w + clip.x;
+	gl_ClipDistance[2] = clip.w - clip.y;
+	gl_ClipDistance[3] = clip.w + clip.y;
+	gl_Position = vec4(clip.xy * rect.z + (rect.xy * 2.0 - 1.0 + rect.z) * clip.w, clip.zw);
+
+	outWorldPos = inPos;
+	outPosFar = record.posFar;
+}
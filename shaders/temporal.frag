@@ -0,0 +1,58 @@
+#version 450
+
+layout (binding = 0) uniform sampler2D currentColor;
+layout (binding = 1) uniform sampler2D velocityMap;
+layout (binding = 2) uniform sampler2D historyColor;
+
+layout (binding = 3) uniform UBO
+{
+	vec2 jitter; // this frame's projection offset, in texture coordinates
+	float historyValid;
+	float feedback; // history weight for a still pixel
+} ubo;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+#define CLIP_GAMMA 1.25
+#define VELOCITY_FALLOFF 40.0
+
+void main()
+{
+	// the scene was drawn shifted by the jitter, undo it when reading the current frame
+	vec2 currentUV = inUV + ubo.jitter;
+	vec2 texel = 1.0 / vec2(textureSize(currentColor, 0));
+	vec3 current = texture(currentColor, currentUV).rgb;
+
+	// colour distribution of the current neighbourhood, history outside of it is rejected
+	vec3 m1 = vec3(0.0);
+	vec3 m2 = vec3(0.0);
+	vec3 minColor = current;
+	vec3 maxColor = current;
+	for(int y = -1; y <= 1; y++){
+		for(int x = -1; x <= 1; x++){
+			vec3 c = texture(currentColor, currentUV + vec2(x, y) * texel).rgb;
+			m1 += c;
+			m2 += c * c;
+			minColor = min(minColor, c);
+			maxColor = max(maxColor, c);
+		}
+	}
+	vec3 mean = m1 / 9.0;
+	vec3 sigma = sqrt(max(m2 / 9.0 - mean * mean, 0.0));
+	minColor = max(minColor, mean - CLIP_GAMMA * sigma);
+	maxColor = min(maxColor, mean + CLIP_GAMMA * sigma);
+
+	vec2 velocity = texture(velocityMap, currentUV).xy;
+	vec2 historyUV = inUV - velocity;
+	if(ubo.historyValid == 0.0 || any(lessThan(historyUV, vec2(0.0))) || any(greaterThan(historyUV, vec2(1.0)))){
+		outFragColor = vec4(current, 1.0);
+		return;
+	}
+
+	vec3 history = clamp(texture(historyColor, historyUV).rgb, minColor, maxColor);
+	// fast motion trusts the current frame more, the history would smear
+	float feedback = ubo.feedback / (1.0 + length(velocity / texel) / VELOCITY_FALLOFF);
+	outFragColor = vec4(mix(current, history, feedback), 1.0);
+}
@@ -51,6 +51,13 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
             case GLFW_KEY_TAB:
                 pBuffer->thirdPerson = !pBuffer->thirdPerson;
                 break;
+            case GLFW_KEY_L:
+                // Cycle lowest latency -> balanced -> power saving
+                pBuffer->latencyMode = (pBuffer->latencyMode + 1) % (LATENCY_POWER_SAVING + 1);
+                break;
+            case GLFW_KEY_P:
+                pBuffer->depthPrepass = !pBuffer->depthPrepass;
+                break;
             case GLFW_KEY_1:
                 pBuffer->debugInput[0] = true;
                 break;
@@ -5,38 +5,139 @@
 // Function prototypes
 static void *rendering_thread(void *arg);
 //static void *input_thread(void *arg);
-static void *physics_thread(void *arg);
-static void *audio_thread(void *arg);
+static void stepPhysics(sharedBuffer *pBuffer);
 static void framebufferSizeCallback(GLFWwindow *window, int width, int height);
-static void barrier_wait();
+static void initSnapshots();
+static void deleteSnapshots();
+static void copyInput(sharedBuffer *pDst, const sharedBuffer *pSrc);
+static void publishInput(const sharedBuffer *pInput);
+static void publishSnapshot(const sharedBuffer *pBuffer, const physicsPose *pPrevious, const tick_t stepTime, const uint64_t version);
+static void waitForStep(const double seconds);
+static uint64_t waitForSnapshot(const uint64_t seen);
+static void notifyThreads();
+static void stopThreads();
 static sharedBuffer * initBuffer();
 static void deleteSharedBuffer(sharedBuffer *pBuffer);
+static void renderHeadlessFrames(const uint32_t frameNumber);
+static int runHeadless(const uint32_t frameNumber, const char *readbackPath, const char *goldenPath, const double minPsnr, const bool compareDepthPrepass);
 
 // file scope Synchronization variables
 static struct cthreads_mutex mutex;
 static struct cthreads_cond cond;
-static int ready = 0;
-static int iteration = 0;
-static bool running = true;
-static const int threadCount = 4;
+static atomic_bool running = true;
+// Physics publishes its state and the main thread its input through lock-free triple buffers,
+// the rendering thread draws the newest state as often as it can and blends it with the step before
+static sharedBuffer snapshots[3];
+static physicsPose snapshotPoses[3]; // pose one step before the slot's state
+static tick_t snapshotTimes[3]; // wall clock time the slot's state was simulated up to
+static tripleBuffer snapshotSlots;
+static sharedBuffer inputs[3]; // only the fields copyInput touches
+static tripleBuffer inputSlots;
+static atomic_uint_fast64_t publishedVersion = 0; // physics steps in the newest snapshot
+// Only the main thread touches these
+static physicsPose physicsPrevious;
+static double physicsAccumulator = 0.0;
+static tick_t physicsTime;
+static uint64_t physicsVersion = 0;
+static const VkExtent2D headlessExtent = {1280, 720};
+static bool depthPrepass = false; // starting state, P toggles it at runtime
+
+int main(int argc, char **argv) {
+    // --headless <frames> [--readback <out.ppm>] [--golden <reference.ppm> [--min-psnr <dB>]] renders without a window
+    // --temporal <percent> renders below native resolution and reconstructs it with the temporal resolve
+    // --analytic-quadrics ray casts ellipsoids and elliptic cylinders instead of tessellating them
+    // --gpu-tessellation builds the object meshes in a compute pass from the uploaded object records
+    // --gpu-culling also culls those objects per pass on the gpu and draws them indirectly
+    // --occlusion-culling leaves objects hidden behind large ones out of the scene pass
+    // --lights <n> adds n animated point lights, shaded per cluster of the view frustum they touch
+    // --shadow-lights <n> shadows the first n of them through the shadow atlas
+    // --particles <n> simulates n dust, spark and player trail particles in a compute pass and draws them as billboards
+    // --sorted-draws draws the scene objects one by one, sorted by pipeline, material and then front to back
+    // --sort-benchmark times the draw key radix sort at 10k, 100k and 1M draws and exits
+    // --job-benchmark times a fork and join workload on the job system at 1 up to every cpu and exits
+    // --depth-prepass starts with the depth only scene pass, --compare-depth-prepass renders the headless frames with and without it
+    uint32_t headlessFrames = 0;
+    const char *readbackPath = NULL;
+    const char *goldenPath = NULL;
+    double minPsnr = 0.0;
+    bool compareDepthPrepass = false;
+    bool sortBenchmark = false;
+    bool jobBenchmark = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+            headlessFrames = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--readback") == 0 && i + 1 < argc) {
+            readbackPath = argv[++i];
+        } else if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc) {
+            goldenPath = argv[++i];
+        } else if (strcmp(argv[i], "--min-psnr") == 0 && i + 1 < argc) {
+            minPsnr = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--analytic-quadrics") == 0) {
+            enableAnalyticQuadrics();
+        } else if (strcmp(argv[i], "--gpu-tessellation") == 0) {
+            enableGpuTessellation();
+        } else if (strcmp(argv[i], "--gpu-culling") == 0) {
+            enableGpuCulling();
+        } else if (strcmp(argv[i], "--occlusion-culling") == 0) {
+            enableOcclusionCulling();
+        } else if (strcmp(argv[i], "--lights") == 0 && i + 1 < argc) {
+            enableClusteredLights((uint32_t)strtoul(argv[++i], NULL, 10));
+        } else if (strcmp(argv[i], "--shadow-lights") == 0 && i + 1 < argc) {
+            enableShadowAtlas((uint32_t)strtoul(argv[++i], NULL, 10));
+        } else if (strcmp(argv[i], "--particles") == 0 && i + 1 < argc) {
+            enableGpuParticles((uint32_t)strtoul(argv[++i], NULL, 10));
+        } else if (strcmp(argv[i], "--sorted-draws") == 0) {
+            enableSortedDraws();
+        } else if (strcmp(argv[i], "--sort-benchmark") == 0) {
+            sortBenchmark = true;
+        } else if (strcmp(argv[i], "--job-benchmark") == 0) {
+            jobBenchmark = true;
+        } else if (strcmp(argv[i], "--depth-prepass") == 0) {
+            depthPrepass = true;
+        } else if (strcmp(argv[i], "--compare-depth-prepass") == 0) {
+            compareDepthPrepass = true;
+        } else if (strcmp(argv[i], "--temporal") == 0 && i + 1 < argc) {
+            uint32_t scale = (uint32_t)strtoul(argv[++i], NULL, 10);
+            enableTemporalUpscaling(scale < GOVERNORMINSCALE ? GOVERNORMINSCALE : scale > 100 ? 100 : scale);
+        } else {
+            printf("usage: %s [--analytic-quadrics] [--gpu-tessellation] [--gpu-culling] [--occlusion-culling] [--lights <n> [--shadow-lights <n>]] [--particles <n>] [--sorted-draws] [--sort-benchmark] [--job-benchmark] [--depth-prepass] [--temporal <percent>] [--headless <frames> [--compare-depth-prepass] [--readback <out.ppm>] [--golden <reference.ppm> [--min-psnr <dB>]]]\n", argv[0]);
+            return -1;
+        }
+    }
+    if (sortBenchmark) {
+        timer_lib_initialize();
+        benchmarkDrawSort();
+        return 0;
+    }
+    if (jobBenchmark) {
+        timer_lib_initialize();
+        benchmarkJobSystem();
+        return 0;
+    }
+    if (headlessFrames > 0) {
+        return runHeadless(headlessFrames, readbackPath, goldenPath, minPsnr, compareDepthPrepass);
+    }
 
-int main() {
     glfwInit();
     char windowTitle[] = "Vulkan Triangle";
 	GLFWwindow *pWindow = createVulkanWindow(windowTitle);
     printf("Window created\n");
-    initVulkan(pWindow);
-    printf("Vulkan initialized\n");
+    // The startup timeline in initVulkan needs the timer
     timer_lib_initialize();
     printf("Timer initialized\n");
-    // Create and initialize the application state
+    initVulkan(pWindow);
+    printf("Vulkan initialized\n");
+    // Create and initialize the application state, the input callbacks write their own copy
     sharedBuffer *pBuffer = initBuffer();
+    sharedBuffer *pInput = initBuffer();
     printf("Buffer initialized\n");
 
-    struct cthreads_thread renderThread, physicsThread, audioThread;
-    struct cthreads_args renderArgs = { rendering_thread, pBuffer};
-    struct cthreads_args physicsArgs = { physics_thread, pBuffer};
-    struct cthreads_args audioArgs = { audio_thread, NULL };
+    initSnapshots();
+    printf("Snapshots initialized\n");
+
+    // Physics steps on the main thread between polls, only rendering has its own thread since it blocks on present
+    struct cthreads_thread renderThread;
+    struct cthreads_args renderArgs = { rendering_thread, NULL};
 
     // Initialize synchronization variables
     cthreads_mutex_init(&mutex, NULL);
@@ -44,16 +145,14 @@ int main() {
 
     // Create threads
     printf("Creating threads\n");
-    cthreads_thread_create(&renderThread, NULL, rendering_thread, pBuffer, &renderArgs);
-    cthreads_thread_create(&physicsThread, NULL, physics_thread, pBuffer, &physicsArgs);
-    cthreads_thread_create(&audioThread, NULL, audio_thread, NULL, &audioArgs);
+    cthreads_thread_create(&renderThread, NULL, rendering_thread, NULL, &renderArgs);
 
 
     // Make the window's context current
     glfwMakeContextCurrent(pWindow);
 
     // Set the user pointer for the window
-    glfwSetWindowUserPointer(pWindow, pBuffer);
+    glfwSetWindowUserPointer(pWindow, pInput);
 
         // Set the cursor mode to disabled
     glfwSetInputMode(pWindow, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -73,27 +172,27 @@ int main() {
         return -1;
     }
 
-    tick_t lastTime = timer_current();
+    pBuffer->dt = PHYSICSSTEP;
+    physicsTime = timer_current();
     while (!glfwWindowShouldClose(pWindow)) {
+        pInput->pollTime = timer_current();
         glfwPollEvents();
-        tick_t currentTime = timer_current();
-        pBuffer->dt = timer_ticks_to_seconds(timer_elapsed_ticks(lastTime));
-        lastTime = currentTime;
-        //if(iteration % 600 == 0){printf("main done!\n");}
-        barrier_wait();
+        publishInput(pInput);
+        stepPhysics(pBuffer);
+        // Poll once per physics step, the next one reads this input
+        waitForStep(PHYSICSSTEP - physicsAccumulator);
     }
     printf("Stopping threads\n");
-    running = false;
-    barrier_wait();
+    stopThreads();
     // Wait for threads to finish
     cthreads_thread_join(renderThread, NULL);
-    cthreads_thread_join(physicsThread, NULL);
-    cthreads_thread_join(audioThread, NULL);
 
     printf("Exiting main thread\n");
     // Destroy synchronization variables
     cthreads_mutex_destroy(&mutex);
     cthreads_cond_destroy(&cond);
+    deleteSnapshots();
+    deleteSharedBuffer(pInput);
     deleteSharedBuffer(pBuffer);
     printf("Destroying Vulkan\n");
     deleteVulkan();
@@ -104,8 +203,48 @@ int main() {
     return 0;
 }
 
+// Fixed time step and no input, so every run renders the same frames for golden comparison
+static void renderHeadlessFrames(const uint32_t frameNumber) {
+    sharedBuffer *pBuffer = initBuffer();
+    pBuffer->dt = 1.0f / 60.0f;
+
+    double *frameTimes = malloc(frameNumber * sizeof(double));
+    for (uint32_t i = 0; i < frameNumber; i++) {
+        tick_t start = timer_current();
+        update(pBuffer);
+        renderHeadlessFrame(*pBuffer);
+        frameTimes[i] = timer_ticks_to_seconds(timer_elapsed_ticks(start)) * 1000.0;
+    }
+    printHeadlessReport(frameTimes, frameNumber);
+    free(frameTimes);
+    deleteSharedBuffer(pBuffer);
+}
+
+static int runHeadless(const uint32_t frameNumber, const char *readbackPath, const char *goldenPath, const double minPsnr, const bool compareDepthPrepass) {
+    timer_lib_initialize();
+    initVulkanHeadless(headlessExtent);
+    if (compareDepthPrepass) {
+        // the same frames in both modes, a golden image below is then compared against the pre-pass one
+        depthPrepass = false;
+        renderHeadlessFrames(frameNumber);
+        gpuPassStats single = getGpuPassTimings(RECORDPASSNUM - 1);
+        resetGpuPassTimings();
+        depthPrepass = true;
+        renderHeadlessFrames(frameNumber);
+        gpuPassStats prepass = getGpuPassTimings(RECORDPASSNUM - 1);
+        printf("scene pass avg/p99: single %.3f/%.3f ms, depth pre-pass %.3f/%.3f ms\n", single.avg, single.p99, prepass.avg, prepass.p99);
+    } else {
+        renderHeadlessFrames(frameNumber);
+    }
+
+    bool success = finishHeadlessRendering(readbackPath, goldenPath, minPsnr);
+    deleteVulkan();
+    return success ? 0 : 1;
+}
+
 static sharedBuffer* initBuffer(){
-    sharedBuffer *pBuffer = malloc(sizeof(sharedBuffer));
+    // Zeroed so fields the physics reads before writing (player position, state) start deterministic
+    sharedBuffer *pBuffer = calloc(1, sizeof(sharedBuffer));
     pBuffer->cameraPos[0]=0.0f;
     pBuffer->cameraPos[1]=0.0f;
     pBuffer->cameraPos[2]=0.25f;
@@ -114,6 +253,9 @@ static sharedBuffer* initBuffer(){
     pBuffer->cameraFront[2]=0.0f;
     pBuffer->yaw = 0.0f;
     pBuffer->thirdPerson = false;
+    pBuffer->latencyMode = LATENCY_BALANCED;
+    pBuffer->depthPrepass = depthPrepass;
+    pBuffer->pollTime = 0;
     for (int i = 0; i < 6; i++) {
         pBuffer->cameraMoveInput[i] = false;
     }
@@ -159,55 +301,147 @@ static void deleteSharedBuffer(sharedBuffer *pBuffer) {
     free(pBuffer);
 }
 
-static void barrier_wait() {
-    cthreads_mutex_lock(&mutex);
-    //printf("Barrier wait, ready: %d, iteration: %d\n", ready, iteration);
-    ready++;
-    if (ready == threadCount) {
-        ready = 0;
-        //if(iteration % 600 == 0){printf("start\n");}
-        iteration++;
-        cthreads_cond_broadcast(&cond);
-    } else {
-        int current_iteration = iteration;
-        while (current_iteration == iteration) {
-            cthreads_cond_wait(&cond, &mutex);
-        }
+static void initSnapshots() {
+    for (int i = 0; i < 3; i++) {
+        initVector(&snapshots[i].cuboids, sizeof(obj3d), 1, 1);
+        initVector(&snapshots[i].ellipsoids, sizeof(obj3d), 1, 1);
+        initVector(&snapshots[i].ellipsoidCylinders, sizeof(obj3d), 1, 1);
     }
-    //printf("Barrier passed, ready: %d, iteration: %d\n", ready, iteration);
-    cthreads_mutex_unlock(&mutex);
+    initTripleBuffer(&snapshotSlots);
+    initTripleBuffer(&inputSlots);
 }
 
-static void framebufferSizeCallback(GLFWwindow *window, int width, int height){
-    recreateSwapChain(window, width, height);
+static void deleteSnapshots() {
+    for (int i = 0; i < 3; i++) {
+        deleteVector(&snapshots[i].cuboids);
+        deleteVector(&snapshots[i].ellipsoids);
+        deleteVector(&snapshots[i].ellipsoidCylinders);
+    }
 }
 
-static void *rendering_thread(void *arg) {
-    sharedBuffer *pBuffer = (sharedBuffer *)arg;
-    while(running) {
-        presentImage(*pBuffer);
-        //if(iteration % 600 == 0){printf("render done!\n");}
-        barrier_wait();
+// The fields key_callback, mouse_callback and the main loop write
+static void copyInput(sharedBuffer *pDst, const sharedBuffer *pSrc) {
+    pDst->yaw = pSrc->yaw;
+    memcpy(pDst->cameraFront, pSrc->cameraFront, sizeof(pDst->cameraFront));
+    memcpy(pDst->cameraMoveInput, pSrc->cameraMoveInput, sizeof(pDst->cameraMoveInput));
+    memcpy(pDst->debugInput, pSrc->debugInput, sizeof(pDst->debugInput));
+    pDst->thirdPerson = pSrc->thirdPerson;
+    pDst->latencyMode = pSrc->latencyMode;
+    pDst->depthPrepass = pSrc->depthPrepass;
+    pDst->pollTime = pSrc->pollTime;
+}
+
+static void publishInput(const sharedBuffer *pInput) {
+    copyInput(&inputs[inputSlots.back], pInput);
+    publishTripleBuffer(&inputSlots);
+}
+
+// Copies the state, object arrays included, so the rendering thread never reads memory physics can reallocate
+static void publishSnapshot(const sharedBuffer *pBuffer, const physicsPose *pPrevious, const tick_t stepTime, const uint64_t version) {
+    sharedBuffer *pSnapshot = &snapshots[snapshotSlots.back];
+    vec cuboids = pSnapshot->cuboids;
+    vec ellipsoids = pSnapshot->ellipsoids;
+    vec ellipsoidCylinders = pSnapshot->ellipsoidCylinders;
+    *pSnapshot = *pBuffer;
+    copyVector(&cuboids, pBuffer->cuboids);
+    copyVector(&ellipsoids, pBuffer->ellipsoids);
+    copyVector(&ellipsoidCylinders, pBuffer->ellipsoidCylinders);
+    pSnapshot->cuboids = cuboids;
+    pSnapshot->ellipsoids = ellipsoids;
+    pSnapshot->ellipsoidCylinders = ellipsoidCylinders;
+    snapshotPoses[snapshotSlots.back] = *pPrevious;
+    snapshotTimes[snapshotSlots.back] = stepTime;
+    publishTripleBuffer(&snapshotSlots);
+    atomic_store(&publishedVersion, version);
+    notifyThreads();
+}
+
+// Returns early when the threads are stopping, rounds up to whole milliseconds so the caller never spins on a short remainder
+static void waitForStep(const double seconds) {
+    const double milliseconds = ceil(seconds * 1000.0);
+    cthreads_mutex_lock(&mutex);
+    if (running) {
+        cthreads_cond_timedwait(&cond, &mutex, milliseconds > 1.0 ? (unsigned int)milliseconds : 1u);
     }
-    return NULL;
+    cthreads_mutex_unlock(&mutex);
 }
 
-static void *physics_thread(void *arg) {
-    sharedBuffer *pBuffer = (sharedBuffer *)arg;
-    while (running) {
-        update(pBuffer);
-        //if(iteration % 600 == 0){printf("physics done!\n");}
-        barrier_wait();
+// Sleeps until a version after seen is published, 0 once the threads are stopping
+static uint64_t waitForSnapshot(const uint64_t seen) {
+    cthreads_mutex_lock(&mutex);
+    while (running && atomic_load(&publishedVersion) <= seen) {
+        cthreads_cond_wait(&cond, &mutex);
     }
-    return NULL;
+    uint64_t version = running ? atomic_load(&publishedVersion) : 0;
+    cthreads_mutex_unlock(&mutex);
+    return version;
 }
 
-static void *audio_thread(void *arg) {
+// The mutex only orders sleeping and waking, the snapshots themselves are exchanged lock-free
+static void notifyThreads() {
+    cthreads_mutex_lock(&mutex);
+    cthreads_cond_broadcast(&cond);
+    cthreads_mutex_unlock(&mutex);
+}
+
+static void stopThreads() {
+    running = false;
+    notifyThreads();
+}
+
+static void framebufferSizeCallback(GLFWwindow *window, int width, int height){
+    (void)window;
+    // The rendering thread recreates the swapchain before its next frame
+    requestSwapChainRecreation(width, height);
+}
+
+static void *rendering_thread(void *arg) {
     //silence unused variable warning
     (void)arg;
+    // Nothing to draw before the first step, after that the front slot is drawn again until a newer one arrives
+    if (waitForSnapshot(0) == 0) {
+        return NULL;
+    }
+    tick_t lastTime = timer_current();
     while (running) {
-        //audio();
-        barrier_wait();
+        acquireTripleBuffer(&snapshotSlots);
+        const uint32_t slot = snapshotSlots.front;
+        tick_t currentTime = timer_current();
+        sharedBuffer frame = snapshots[slot];
+        // Per frame effects like the particles advance by the rendered frame time, not the physics step
+        frame.dt = timer_ticks_to_seconds(timer_elapsed_ticks(lastTime));
+        lastTime = currentTime;
+        float alpha = currentTime > snapshotTimes[slot] ? timer_ticks_to_seconds(currentTime - snapshotTimes[slot]) / PHYSICSSTEP : 0.0f;
+        interpolatePhysicsPose(&frame, &snapshotPoses[slot], alpha > 1.0f ? 1.0f : alpha);
+        // Nothing was drawn, retrying right away would spin until the window is restored
+        if (!presentImage(frame)) {
+            waitForStep(PHYSICSSTEP);
+        }
     }
     return NULL;
-}
\ No newline at end of file
+}
+
+// Fixed steps on the wall clock, independent of how fast the rendering thread draws
+static void stepPhysics(sharedBuffer *pBuffer) {
+    tick_t currentTime = timer_current();
+    physicsAccumulator += timer_ticks_to_seconds(timer_elapsed_ticks(physicsTime));
+    physicsTime = currentTime;
+    // After a stall the missed time is dropped instead of simulated in one burst
+    if (physicsAccumulator > PHYSICSMAXLAG) {
+        physicsAccumulator = PHYSICSMAXLAG;
+    }
+    if (physicsAccumulator < PHYSICSSTEP) {
+        return;
+    }
+    while (physicsAccumulator >= PHYSICSSTEP) {
+        if (acquireTripleBuffer(&inputSlots)) {
+            copyInput(pBuffer, &inputs[inputSlots.front]);
+        }
+        getPhysicsPose(pBuffer, &physicsPrevious);
+        update(pBuffer);
+        physicsAccumulator -= PHYSICSSTEP;
+        physicsVersion++;
+    }
+    // The state is where the wall clock was minus the time not simulated yet
+    publishSnapshot(pBuffer, &physicsPrevious, currentTime - (tick_t)(physicsAccumulator * timer_ticks_per_second()), physicsVersion);
+}
@@ -2,7 +2,11 @@
 #include "vulkan_game/utils.h"
 
 static const float Up[] = {0.0f, 0.0f, 1.0f}; // Up direction for the game
-static float nextPlayerPos[3] = {0.0f, 0.0f, 0.25f};
+// where the player's and camera's centers stop, the particles collide with the same arena
+static const float WallLimit = ARENAHALFWIDTH - PLAYERRADIUS;
+static const float FloorLimit = PLAYERRADIUS;
+static const float CeilingLimit = ARENAHEIGHT - PLAYERRADIUS;
+static float nextPlayerPos[3] = {0.0f, 0.0f, PLAYERRADIUS};
 static float nextRotation[3] = {0.0f, 0.0f, 0.0f};
 static float gravitySpeed = 0.0f;
 static float playerSpeed = 1.0f;
@@ -23,61 +27,61 @@ static void movePlayer(sharedBuffer *pBuffer){
 }
 
 static void playerPosMapCollision(sharedBuffer *pBuffer){
-    if(pBuffer->playerPos[0] < -9.75f){
+    if(pBuffer->playerPos[0] < -WallLimit){
         pBuffer->playerState = ON_WALL_X_NEG;
         pBuffer->playerModel.rotation[1] = atan2f(pBuffer->playerPos[1] - nextPlayerPos[1], pBuffer->playerPos[2] - nextPlayerPos[2]);
 
-        nextPlayerPos[0] = -9.75f;
-        pBuffer->playerPos[0] = -9.75f;
-    } else if(pBuffer->playerPos[0] > 9.75f){
+        nextPlayerPos[0] = -WallLimit;
+        pBuffer->playerPos[0] = -WallLimit;
+    } else if(pBuffer->playerPos[0] > WallLimit){
         pBuffer->playerState = ON_WALL_X_POS;
         pBuffer->playerModel.rotation[1] = atan2f(nextPlayerPos[1] - pBuffer->playerPos[1], nextPlayerPos[2] - pBuffer->playerPos[2]);
-        nextPlayerPos[0] = 9.75f;
-        pBuffer->playerPos[0] = 9.75f;
+        nextPlayerPos[0] = WallLimit;
+        pBuffer->playerPos[0] = WallLimit;
     }
 
-    if(pBuffer->playerPos[1] < -9.75f){
+    if(pBuffer->playerPos[1] < -WallLimit){
         pBuffer->playerState = ON_WALL_Y_NEG;
         pBuffer->playerModel.rotation[1] = atan2f(pBuffer->playerPos[0] -nextPlayerPos[0], pBuffer->playerPos[2] - nextPlayerPos[2]);
-        nextPlayerPos[1] = -9.75f;
-        pBuffer->playerPos[1] = -9.75f;
-    } else if(pBuffer->playerPos[1] > 9.75f){
+        nextPlayerPos[1] = -WallLimit;
+        pBuffer->playerPos[1] = -WallLimit;
+    } else if(pBuffer->playerPos[1] > WallLimit){
         pBuffer->playerState = ON_WALL_Y_POS;
         pBuffer->playerModel.rotation[1] = atan2f(nextPlayerPos[0] - pBuffer->playerPos[0], nextPlayerPos[2]- pBuffer->playerPos[2]);
-        nextPlayerPos[1] = 9.75f;
-        pBuffer->playerPos[1] = 9.75f;
+        nextPlayerPos[1] = WallLimit;
+        pBuffer->playerPos[1] = WallLimit;
     }
 
-    if(pBuffer->playerPos[2] < 0.25f){
+    if(pBuffer->playerPos[2] < FloorLimit){
         pBuffer->playerState = ON_GROUND;
         pBuffer->playerModel.rotation[2] = atan2f(pBuffer->playerPos[0] - nextPlayerPos[0], nextPlayerPos[1] - pBuffer->playerPos[1]);
-        nextPlayerPos[2] = 0.25f;
-        pBuffer->playerPos[2] = 0.25f;
-    } else if (pBuffer->playerPos[2] > 9.75f){
+        nextPlayerPos[2] = FloorLimit;
+        pBuffer->playerPos[2] = FloorLimit;
+    } else if (pBuffer->playerPos[2] > CeilingLimit){
         pBuffer->playerState = ON_CEILING;
         pBuffer->playerModel.rotation[2] = atan2f(pBuffer->playerPos[0] - nextPlayerPos[0], nextPlayerPos[1] - pBuffer->playerPos[1]);
-        nextPlayerPos[2] = 9.75f;
-        pBuffer->playerPos[2] = 9.75f;
+        nextPlayerPos[2] = CeilingLimit;
+        pBuffer->playerPos[2] = CeilingLimit;
     }
 }
 
 static void cameraPosMapCollision(float cameraPos[3]){
-    if(cameraPos[0] < -9.75f){
-        cameraPos[0] = -9.75f;
-    } else if(cameraPos[0] > 9.75f){
-        cameraPos[0] = 9.75f;
+    if(cameraPos[0] < -WallLimit){
+        cameraPos[0] = -WallLimit;
+    } else if(cameraPos[0] > WallLimit){
+        cameraPos[0] = WallLimit;
     }
 
-    if(cameraPos[1] < -9.75f){
-        cameraPos[1] = -9.75f;
-    } else if(cameraPos[1] > 9.75f){
-        cameraPos[1] = 9.75f;
+    if(cameraPos[1] < -WallLimit){
+        cameraPos[1] = -WallLimit;
+    } else if(cameraPos[1] > WallLimit){
+        cameraPos[1] = WallLimit;
     }
 
-    if(cameraPos[2] < 0.25f){
-        cameraPos[2] = 0.25f;
-    } else if (cameraPos[2] > 9.75f){
-        cameraPos[2] = 9.75f;
+    if(cameraPos[2] < FloorLimit){
+        cameraPos[2] = FloorLimit;
+    } else if (cameraPos[2] > CeilingLimit){
+        cameraPos[2] = CeilingLimit;
     }
 }
 
@@ -302,4 +306,31 @@ void update(sharedBuffer *pBuffer){
     updateCamera(pBuffer->cameraPos, pBuffer->cameraFront, pBuffer->cameraTarget, pBuffer->playerPos, pBuffer->thirdPerson);
     movePlayer(pBuffer);
     frameindex++;
-}
\ No newline at end of file
+}
+
+void getPhysicsPose(const sharedBuffer *pBuffer, physicsPose *pPose){
+    memcpy(pPose->playerPos, pBuffer->playerModel.pos, sizeof(pPose->playerPos));
+    memcpy(pPose->playerRotation, pBuffer->playerModel.rotation, sizeof(pPose->playerRotation));
+    memcpy(pPose->cameraPos, pBuffer->cameraPos, sizeof(pPose->cameraPos));
+    memcpy(pPose->cameraTarget, pBuffer->cameraTarget, sizeof(pPose->cameraTarget));
+    pPose->fov = pBuffer->fov;
+}
+
+static float lerpAngle(const float a, const float b, const float t){
+    float diff = fmodf(b - a, 2*PI);
+    if(diff > PI) diff -= 2*PI;
+    if(diff < -PI) diff += 2*PI;
+    return a + diff * t;
+}
+
+// pBuffer holds the newer step, alpha 0 gives the previous one and 1 leaves it as it is
+void interpolatePhysicsPose(sharedBuffer *pBuffer, const physicsPose *pPrevious, const float alpha){
+    for(int i = 0; i < 3; i++){
+        pBuffer->playerModel.pos[i] = pPrevious->playerPos[i] + (pBuffer->playerModel.pos[i] - pPrevious->playerPos[i]) * alpha;
+        pBuffer->playerModel.rotation[i] = lerpAngle(pPrevious->playerRotation[i], pBuffer->playerModel.rotation[i], alpha);
+        pBuffer->cameraPos[i] = pPrevious->cameraPos[i] + (pBuffer->cameraPos[i] - pPrevious->cameraPos[i]) * alpha;
+        pBuffer->cameraTarget[i] = pPrevious->cameraTarget[i] + (pBuffer->cameraTarget[i] - pPrevious->cameraTarget[i]) * alpha;
+    }
+    memcpy(pBuffer->playerPos, pBuffer->playerModel.pos, sizeof(pBuffer->playerPos));
+    pBuffer->fov = pPrevious->fov + (pBuffer->fov - pPrevious->fov) * alpha;
+}
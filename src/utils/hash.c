@@ -0,0 +1,12 @@
+#include "vulkan_game/std_c.h"
+
+// 64 bit FNV-1a, chain calls by passing the previous hash as seed
+uint64_t hashBytes(const void *data, const size_t size, const uint64_t seed) {
+    const unsigned char *bytes = data;
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
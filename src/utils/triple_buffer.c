@@ -0,0 +1,26 @@
+#include "vulkan_game/utils.h"
+
+// Lock-free publication between one writer and one reader thread. Each side owns one of the
+// three slots and trades it for the shared middle one, so neither ever sees a slot being written
+
+void initTripleBuffer(tripleBuffer *pTriple) {
+    pTriple->back = 0;
+    atomic_init(&pTriple->middle, 1);
+    pTriple->front = 2;
+}
+
+// The filled back slot becomes the middle one, the writer continues in the slot it got back
+void publishTripleBuffer(tripleBuffer *pTriple) {
+    uint32_t previous = atomic_exchange_explicit(&pTriple->middle, pTriple->back | TRIPLEBUFFERFRESH, memory_order_acq_rel);
+    pTriple->back = previous & ~TRIPLEBUFFERFRESH;
+}
+
+// False if nothing was published since the last call, the front slot then stays the same
+bool acquireTripleBuffer(tripleBuffer *pTriple) {
+    if (!(atomic_load_explicit(&pTriple->middle, memory_order_relaxed) & TRIPLEBUFFERFRESH)) {
+        return false;
+    }
+    uint32_t previous = atomic_exchange_explicit(&pTriple->middle, pTriple->front, memory_order_acq_rel);
+    pTriple->front = previous & ~TRIPLEBUFFERFRESH;
+    return true;
+}
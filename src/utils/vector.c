@@ -41,6 +41,18 @@ void initVector(vec *m, int elemSize, int capacity, int minCapacity) {
     m->minc = minCapacity;
 }
 
+// Replaces the contents of dst with those of src, reallocating only when dst is too small
+void copyVector(vec *dst, const vec src) {
+    dst->elemSize = src.elemSize;
+    dst->minc = src.minc;
+    if (dst->c < src.n) {
+        dst->c = src.c;
+        dst->array = realloc(dst->array, dst->c * dst->elemSize);
+    }
+    memcpy(dst->array, src.array, src.n * src.elemSize);
+    dst->n = src.n;
+}
+
 void deleteVector(vec *m) {
     free(m->array);
     m->array = NULL;
@@ -12,8 +12,14 @@ static sceneRenderPassAttachment scenePass;
 static offScreenRenderPassAttachment offScreenPass;
 static pipelines pipes;
 static commandAttachment command;
+static commandRecorder *recorder;
+static jobSystem *scheduler;
 static uint32_t imageIndex;
 static uint32_t currentFrame = 0;
+static uint32_t frameNum; // frames in flight, fixed at init even if the swapchain image count changes
+static uint32_t cacheImageNum; // swapchain images the command cache is sized for
+static uint64_t frameCount = 0;
+static uint32_t graphicsQueueFamilyIndex;
 static syncObjects sync;
 static mappedBuffer *uniformBuffers;
 static uniformDataScene uboScene;
@@ -24,13 +30,56 @@ static VkFormat depthFormat;
 static VkSampleCountFlagBits msaaSamples;
 static mapSize map;
 static dynamicBuffers buffers;
+static vec retiredSwapchains;
+static latencyModes activeLatencyMode = LATENCY_BALANCED;
+static latencyRecorder latency;
+static gpuProfiler profiler;
+static VkPipelineCache pipelineCache;
+static char pipelineCachePath[PATHMAXLENGTH];
+static bool pipelineCachePersistent;
+static shaderCache shaders;
+static uint32_t timestampValidBits;
+static bool headless = false;
+static headlessTarget target; // stands in for the swapchain when headless
+static renderGovernor governor;
+static double cpuFrameTime = 0.0; // acquire to submit of the last frame, in milliseconds
+static bool temporal = false;
+static uint32_t temporalScale = 100; // starting render scale in percent when temporal upscaling is enabled
+static temporalResolve resolve;
+static bool analyticQuadrics = false; // ellipsoids and cylinders ray cast from instances instead of tessellated
+static quadricBuffers quadricInstances;
+static bool tessellateOnGpu = false; // the cpu only uploads obj3d records, a compute pass builds the meshes
+static gpuTessellation tessellation;
+static bool cullOnGpu = false; // the tessellated objects are drawn from indirect commands a compute pass culled per view
+static gpuCulling culling;
+static bool occlusionCulling = false; // objects hidden behind large ones are left out of the scene pass
+static occlusionCuller occlusion;
+static uint32_t sceneIndexNum; // the scene pass stops where the occluded meshes start, the shadow passes draw them all
+static uint32_t sceneQuadricNum;
+static bool depthPrepass = false; // the meshes are drawn depth only first, then shaded once per pixel
+static uint32_t clusteredLightNum = 0; // point lights on top of the shadowed one, binned into clusters each frame
+static lightClusters clusters;
+static uint32_t shadowCasterNum = 0; // the first clustered lights, shadowed through the atlas
+static shadowAtlas atlas;
+static bool sortedDraws = false; // the scene pass draws its cpu meshes and quadrics one object at a time, sorted by key
+static drawQueue sceneDraws;
+static uint32_t particleNum = 0; // pool of the gpu simulated dust, sparks and player trail, none without it
+static gpuParticles particles;
+
+//written by the glfw callback on the main thread, consumed by the rendering thread
+static struct cthreads_mutex resizeMutex;
+static VkExtent2D framebufferExtent;
+static bool swapchainDirty = false;
 
 static const uint32_t imageArrayLayers = 1;
 static const uint32_t shadowMapResolution = 1024;
 
 static vec vertices;
 static vec indices;
+static vec quadrics;
 
+static const float cameraNear = 0.1f;
+static const float cameraFar = 50.0f;
 static const float zNear = 0.9f;
 static const float zFar = 10.1f;
 static const float lightPOV = 90.0f;
@@ -38,7 +87,6 @@ static const float Up[] = {0.0f, 0.0f, 1.0f}; // Up direction for the light
 static float lightPos[] = {0.00001f, 0.00001f, 9.0f, 1.0f}; // Position of the light source
 
 static const VkDeviceSize offsets[] = {0};
-static float viewMatrix[4][4];
 static const float identity[4][4] = {
 	{1.0f, 0.0f, 0.0f, 0.0f},
 	{0.0f, 1.0f, 0.0f, 0.0f},
@@ -47,7 +95,7 @@ static const float identity[4][4] = {
 };
 
 
-static void updateCubeFace(uint32_t faceIndex){
+static void updateCubeFace(float viewMatrix[4][4], const uint32_t faceIndex){
 	mat4_identity(viewMatrix);
 	switch (faceIndex)
 	{
@@ -75,54 +123,267 @@ static void updateCubeFace(uint32_t faceIndex){
 		mat4_rotate(viewMatrix, (const float(*)[4])viewMatrix, radians(180.0f), (float[]){0.0f, 0.0f, 1.0f});
 		break;
 	}
-	vkCmdBeginRenderPass(command.buffers[currentFrame], &offScreenPass.beginInfos[faceIndex], VK_SUBPASS_CONTENTS_INLINE);
-		vkCmdPushConstants(command.buffers[currentFrame], pipes.offscreen.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(viewMatrix), viewMatrix);
-		vkCmdBindPipeline(command.buffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, pipes.offscreen.pipe);
-		vkCmdBindDescriptorSets(command.buffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, pipes.offscreen.layout, 0, 1, &descriptor.sets.offscreen, 0, VK_NULL_HANDLE);
-		vkCmdBindVertexBuffers(command.buffers[currentFrame], 0, 1, &buffers.buffers[currentFrame].vertex.buffer, offsets);
-		vkCmdBindIndexBuffer(command.buffers[currentFrame], buffers.buffers[currentFrame].index.buffer, 0, VK_INDEX_TYPE_UINT16);
-		vkCmdDrawIndexed(command.buffers[currentFrame], indices.n, 1, 0, 0, 0);
-	vkCmdEndRenderPass(command.buffers[currentFrame]);
 }
 
-static void recordCommandBuffers(){
+//the scene draws of one pipeline in sorted order, index ranges for meshes and instance ranges for quadrics
+static void drawSortedScene(const VkCommandBuffer commandBuffer, const drawPipeline pipeline){
+	for(uint32_t draw = 0; draw < sceneDraws.drawNum; draw++){
+		if(getDrawKeyPipeline(sceneDraws.keys[draw]) != pipeline){
+			continue;
+		}
+		const drawCommand sorted = getSortedDraw(&sceneDraws, draw);
+		if(pipeline == DRAW_PIPELINE_MESH){
+			vkCmdDrawIndexed(commandBuffer, sorted.count, 1, sorted.first, 0, 0);
+		}else{
+			vkCmdDraw(commandBuffer, VerticesPerQuadric, sorted.count, 0, sorted.first);
+		}
+	}
+}
+
+//the cpu and gpu tessellated meshes of the scene pass, twice with the depth pre-pass
+static void drawSceneMeshes(const VkCommandBuffer commandBuffer){
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &buffers.buffers[currentFrame].vertex.buffer, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, buffers.buffers[currentFrame].index.buffer, 0, VK_INDEX_TYPE_UINT16);
+	if(sortedDraws){
+		drawSortedScene(commandBuffer, DRAW_PIPELINE_MESH);
+	}else{
+		vkCmdDrawIndexed(commandBuffer, sceneIndexNum, 1, 0, 0, 0);
+	}
+	if(tessellateOnGpu && tessellation.indexNum[currentFrame] > 0){
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &tessellation.vertices[currentFrame].buffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, tessellation.indices[currentFrame].buffer, 0, VK_INDEX_TYPE_UINT32);
+		if(cullOnGpu){
+			drawCulledObjects(commandBuffer, &culling, currentFrame, 6);
+		}else{
+			vkCmdDrawIndexed(commandBuffer, tessellation.indexNum[currentFrame], 1, 0, 0, 0);
+		}
+	}
+}
+
+//the faces come from the slot buffer, so the commands only change with the meshes, unused slots draw nothing
+static void recordShadowAtlasPass(const VkCommandBuffer commandBuffer){
+	vkCmdBeginRenderPass(commandBuffer, atlas.pass.beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdSetViewport(commandBuffer, 0, 1, &atlas.pipe.viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &atlas.pipe.scissor);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, atlas.pipe.layout, 0, 1, &descriptor.sets.sceneSets[currentFrame], 0, VK_NULL_HANDLE);
+		for(uint32_t slot = 0; slot < SHADOWFACEBUDGET; slot++){
+			vkCmdPushConstants(commandBuffer, atlas.pipe.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(slot), &slot);
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &buffers.buffers[currentFrame].vertex.buffer, offsets);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, atlas.pipe.clear);
+			vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, atlas.pipe.pipe);
+			vkCmdBindIndexBuffer(commandBuffer, buffers.buffers[currentFrame].index.buffer, 0, VK_INDEX_TYPE_UINT16);
+			vkCmdDrawIndexed(commandBuffer, indices.n, 1, 0, 0, 0);
+			if(tessellateOnGpu && tessellation.indexNum[currentFrame] > 0){
+				vkCmdBindVertexBuffers(commandBuffer, 0, 1, &tessellation.vertices[currentFrame].buffer, offsets);
+				vkCmdBindIndexBuffer(commandBuffer, tessellation.indices[currentFrame].buffer, 0, VK_INDEX_TYPE_UINT32);
+				vkCmdDrawIndexed(commandBuffer, tessellation.indexNum[currentFrame], 1, 0, 0, 0);
+			}
+		}
+	vkCmdEndRenderPass(commandBuffer);
+}
+
+//runs on the recording threads, passes 0-5 are the shadow cube faces and pass 6 is the scene
+static void recordPass(const VkCommandBuffer commandBuffer, const uint32_t pass){
+	if(pass < 6){
+		float viewMatrix[4][4];
+		updateCubeFace(viewMatrix, pass);
+		beginSecondaryCommandBuffer(commandBuffer, offScreenPass.renderPass, offScreenPass.frameBuffers[pass]);
+			vkCmdSetViewport(commandBuffer, 0, 1, &pipes.offscreen.viewport);
+			vkCmdSetScissor(commandBuffer, 0, 1, &pipes.offscreen.scissor);
+			//vkCmdSetDepthBias(commandBuffer, pipes.offscreen.bias.constant, pipes.offscreen.bias.clamp, pipes.offscreen.bias.slope);
+			vkCmdPushConstants(commandBuffer, pipes.offscreen.layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(viewMatrix), viewMatrix);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipes.offscreen.pipe);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipes.offscreen.layout, 0, 1, &descriptor.sets.offscreen, 0, VK_NULL_HANDLE);
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &buffers.buffers[currentFrame].vertex.buffer, offsets);
+			vkCmdBindIndexBuffer(commandBuffer, buffers.buffers[currentFrame].index.buffer, 0, VK_INDEX_TYPE_UINT16);
+			vkCmdDrawIndexed(commandBuffer, indices.n, 1, 0, 0, 0);
+			if(tessellateOnGpu && tessellation.indexNum[currentFrame] > 0){
+				vkCmdBindVertexBuffers(commandBuffer, 0, 1, &tessellation.vertices[currentFrame].buffer, offsets);
+				vkCmdBindIndexBuffer(commandBuffer, tessellation.indices[currentFrame].buffer, 0, VK_INDEX_TYPE_UINT32);
+				if(cullOnGpu){
+					drawCulledObjects(commandBuffer, &culling, currentFrame, pass);
+				}else{
+					vkCmdDrawIndexed(commandBuffer, tessellation.indexNum[currentFrame], 1, 0, 0, 0);
+				}
+			}
+			if(quadrics.n > 0){
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipes.offscreen.quadrics);
+				vkCmdBindVertexBuffers(commandBuffer, 0, 1, &quadricInstances.buffers[currentFrame].buffer, offsets);
+				vkCmdDraw(commandBuffer, VerticesPerQuadric, quadrics.n, 0, 0);
+			}
+		vkEndCommandBuffer(commandBuffer);
+	} else {
+		beginSecondaryCommandBuffer(commandBuffer, scenePass.renderPass, scenePass.frameBuffer);
+			vkCmdSetViewport(commandBuffer, 0, 1, &pipes.scene.viewport);
+			vkCmdSetScissor(commandBuffer, 0, 1, &pipes.scene.scissor);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipes.scene.layout, 0, 1, &descriptor.sets.sceneSets[currentFrame], 0, VK_NULL_HANDLE);
+			if(depthPrepass){
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipes.scene.depthPrepass);
+				drawSceneMeshes(commandBuffer);
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipes.scene.depthEqual);
+			}else{
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipes.scene.pipe);
+			}
+			drawSceneMeshes(commandBuffer);
+			//same layout, the descriptor set stays bound, the ray cast depth is only known in the fragment shader so quadrics skip the pre-pass
+			if(sceneQuadricNum > 0){
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipes.scene.quadrics);
+				vkCmdBindVertexBuffers(commandBuffer, 0, 1, &quadricInstances.buffers[currentFrame].buffer, offsets);
+				if(sortedDraws){
+					drawSortedScene(commandBuffer, DRAW_PIPELINE_QUADRIC);
+				}else{
+					vkCmdDraw(commandBuffer, VerticesPerQuadric, sceneQuadricNum, 0, 0);
+				}
+			}
+			//additive and without depth writes, after everything opaque
+			if(particleNum > 0){
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipes.scene.particles);
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipes.scene.particleLayout, 1, 1, &particles.sets[currentFrame], 0, VK_NULL_HANDLE);
+				vkCmdDraw(commandBuffer, 6, particles.capacity, 0, 0);
+			}
+		vkEndCommandBuffer(commandBuffer);
+	}
+}
+
+//everything the recorded commands depend on besides buffer contents and uniforms,
+//buffers and sets count by generation since a freed handle can come back with the same value,
+//recreated pipelines and render targets invalidate the cache where they are recreated
+static uint64_t getDrawListKey(){
+	const uint64_t state[] = {
+		(uint64_t)indices.n,
+		(uint64_t)vertices.n,
+		(uint64_t)sceneIndexNum << 32 | sceneQuadricNum,
+		buffers.generation,
+		(uint64_t)depthPrepass,
+		(uint64_t)quadrics.n,
+		analyticQuadrics ? quadricInstances.generation : 0,
+		tessellateOnGpu ? (uint64_t)tessellation.indexNum[currentFrame] : 0,
+		tessellateOnGpu ? ((uint64_t)tessellation.counts[currentFrame].cuboidNum << 32 | tessellation.counts[currentFrame].ellipsoidNum) : 0,
+		tessellateOnGpu ? (uint64_t)tessellation.counts[currentFrame].cylinderNum : 0,
+		tessellateOnGpu ? tessellation.generation : 0,
+		cullOnGpu ? culling.generation : 0,
+		sortedDraws ? sceneDraws.orderHash : 0
+	};
+	uint64_t key = hashBytes(state, sizeof(state), HASHSEED);
+	return key == 0 ? 1 : key;
+}
+
+//returns the primary command buffer for this frame slot and swapchain image, re-recorded only if its draw list changed
+static VkCommandBuffer recordCommandBuffers(){
+	const uint32_t slot = currentFrame * cacheImageNum + imageIndex;
+	//buffers may be reallocated here, so the key is taken afterwards
+	updateDynamicBuffers(&buffers, indices, vertices, device, physicalDevice, currentFrame);
+	if(analyticQuadrics){
+		updateQuadricBuffers(&quadricInstances, quadrics, device, physicalDevice, currentFrame);
+	}
+	const uint64_t key = getDrawListKey();
+	if(command.keys[slot] == key){
+		return command.buffers[slot];
+	}
+	command.keys[slot] = key;
+
 	//Reset command buffer
-	vkResetCommandBuffer(command.buffers[currentFrame], 0);
+	vkResetCommandBuffer(command.buffers[slot], 0);
 	//Begin recording command buffer
-	vkBeginCommandBuffer(command.buffers[currentFrame], &command.beginInfo);
-		updateDynamicBuffers(&buffers, indices, vertices, command.buffers[currentFrame], device, physicalDevice, currentFrame);
+	vkBeginCommandBuffer(command.buffers[slot], &command.beginInfo);
+		resetGpuTimestamps(&profiler, command.buffers[slot], currentFrame);
+		writeGpuFrameStart(&profiler, command.buffers[slot], currentFrame);
+		copyDynamicBuffers(&buffers, indices, vertices, command.buffers[slot], currentFrame);
+		if(analyticQuadrics){
+			copyQuadricBuffers(&quadricInstances, quadrics, command.buffers[slot], currentFrame);
+		}
+		if(tessellateOnGpu){
+			recordGpuTessellation(command.buffers[slot], &tessellation, currentFrame);
+		}
+		if(cullOnGpu){
+			recordGpuCulling(command.buffers[slot], &culling, &tessellation, currentFrame);
+		}
+		if(particleNum > 0){
+			recordGpuParticles(command.buffers[slot], &particles, currentFrame);
+		}
+		const VkCommandBuffer *secondaryBuffers = recordSecondaryCommandBuffers(recorder, slot);
 
-		//draw shadowmap / offscreen pass (push view matrix)
-		vkCmdSetViewport(command.buffers[currentFrame], 0, 1, &pipes.offscreen.viewport);
-		vkCmdSetScissor(command.buffers[currentFrame], 0, 1, &pipes.offscreen.scissor);
-		//vkCmdSetDepthBias(command.buffers[currentFrame], pipes.offscreen.bias.constant, pipes.offscreen.bias.clamp, pipes.offscreen.bias.slope);
+		//draw shadowmap / offscreen pass
 		for (uint32_t face = 0; face < 6; face++) {
-			updateCubeFace(face);
+			writeGpuTimestamp(&profiler, command.buffers[slot], currentFrame, face, false);
+			vkCmdBeginRenderPass(command.buffers[slot], &offScreenPass.beginInfos[face], VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+				vkCmdExecuteCommands(command.buffers[slot], 1, &secondaryBuffers[face]);
+			vkCmdEndRenderPass(command.buffers[slot]);
+			writeGpuTimestamp(&profiler, command.buffers[slot], currentFrame, face, true);
 		}
 
-		//Second pass: Scene rendering with applied shadow map
-		vkCmdBeginRenderPass(command.buffers[currentFrame], &scenePass.beginInfos[imageIndex], VK_SUBPASS_CONTENTS_INLINE);
-			vkCmdSetViewport(command.buffers[currentFrame], 0, 1, &pipes.scene.viewport);
-			vkCmdSetScissor(command.buffers[currentFrame], 0, 1, &pipes.scene.scissor);
-			vkCmdBindPipeline(command.buffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, pipes.scene.pipe);
-			vkCmdBindVertexBuffers(command.buffers[currentFrame], 0, 1, &buffers.buffers[currentFrame].vertex.buffer, offsets);
-			vkCmdBindIndexBuffer(command.buffers[currentFrame], buffers.buffers[currentFrame].index.buffer, 0, VK_INDEX_TYPE_UINT16);
-			vkCmdBindDescriptorSets(command.buffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, pipes.scene.layout, 0, 1, &descriptor.sets.sceneSets[currentFrame], 0, VK_NULL_HANDLE);
-			vkCmdDrawIndexed(command.buffers[currentFrame], indices.n, 1, 0, 0, 0);
-		vkCmdEndRenderPass(command.buffers[currentFrame]);
+		if(atlas.casterNum > 0){
+			recordShadowAtlasPass(command.buffers[slot]);
+		}
+
+		//Second pass: Scene rendering with applied shadow map, at the render extent and scaled to the swapchain image
+		writeGpuTimestamp(&profiler, command.buffers[slot], currentFrame, 6, false);
+		vkCmdBeginRenderPass(command.buffers[slot], scenePass.beginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+			vkCmdExecuteCommands(command.buffers[slot], 1, &secondaryBuffers[6]);
+		vkCmdEndRenderPass(command.buffers[slot]);
+		const VkImageLayout finalLayout = headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		if(temporal){
+			recordTemporalResolve(command.buffers[slot], &resolve, &pipes.temporal, currentFrame, swapchain.images[imageIndex], swapchain.extent, finalLayout);
+		} else {
+			recordSceneUpscale(command.buffers[slot], &scenePass, swapchain.images[imageIndex], swapchain.extent, finalLayout);
+		}
+		writeGpuTimestamp(&profiler, command.buffers[slot], currentFrame, 6, true);
 
 	//End recording command buffer
-	vkEndCommandBuffer(command.buffers[currentFrame]);
+	vkEndCommandBuffer(command.buffers[slot]);
+	return command.buffers[slot];
+}
+
+//unjittered, shared by the scene uniforms and the occlusion culling
+static void getCameraMatrices(const sharedBuffer buffer, float view[4][4], float proj[4][4]){
+    mat4_lookat(view, buffer.cameraPos, buffer.cameraTarget, Up);
+    mat4_perspective(proj, radians(buffer.fov), swapchain.extent.width / (float)swapchain.extent.height, cameraNear, cameraFar);
+    proj[1][1] *= -1; // Invert the Y axis for Vulkan
 }
 
 static void updateUniformBuffers(const sharedBuffer buffer) {
     // Update view matrix
     mat4_identity(uboScene.model);
-    mat4_lookat(uboScene.view, buffer.cameraPos, buffer.cameraTarget, Up);
-    mat4_perspective(uboScene.proj, radians(buffer.fov), swapchain.extent.width / (float)swapchain.extent.height, 0.1f, 50.0f);
-    uboScene.proj[1][1] *= -1; // Invert the Y axis for Vulkan
+    getCameraMatrices(buffer, uboScene.view, uboScene.proj);
+	//motion vectors come from the unjittered matrices, the first frame has no previous one
+	memcpy(uboScene.prevViewProj, uboScene.currViewProj, sizeof(uboScene.currViewProj));
+	mat4_multiply(uboScene.currViewProj, (const float(*)[4])uboScene.view, (const float(*)[4])uboScene.proj);
+	if(frameCount == 0){
+		memcpy(uboScene.prevViewProj, uboScene.currViewProj, sizeof(uboScene.currViewProj));
+	}
+	if(temporal){
+		//shifts clip space by a sub-pixel offset, scaled by w so it stays constant in screen space
+		float jitter[2];
+		nextTemporalJitter(&resolve, scenePass.extent, jitter);
+		for(uint32_t column = 0; column < 4; column++){
+			uboScene.proj[column][0] += jitter[0] * uboScene.proj[column][3];
+			uboScene.proj[column][1] += jitter[1] * uboScene.proj[column][3];
+		}
+		updateTemporalUniforms(&resolve, currentFrame, jitter);
+	}
     memcpy(uboScene.lightPos, lightPos, sizeof(lightPos));
-	memcpy(uniformBuffers[imageIndex].pMappedData, &uboScene, sizeof(uboScene));
+	//binned with the jittered projection, the froxels line up with the pixels the scene pass shades
+	getClusterParams(scenePass.extent, cameraNear, cameraFar, uboScene.clusterParams);
+	updateLightClusters(&clusters, currentFrame, frameCount, (const float(*)[4])uboScene.view, (const float(*)[4])uboScene.proj, uboScene.clusterParams);
+	updateShadowAtlas(&atlas, currentFrame, clusters.current, (const float(*)[4])uboScene.view, (const float(*)[4])uboScene.proj, scenePass.extent);
+	if(particleNum > 0){
+		updateGpuParticles(&particles, currentFrame, frameCount, buffer.dt, buffer.playerPos);
+	}
+	memcpy(uniformBuffers[currentFrame].pMappedData, &uboScene, sizeof(uboScene));
+}
+
+//the matrices the passes draw with, the scene one includes the temporal jitter
+static void updateCullingViews(){
+	float viewProj[CULLVIEWNUM][4][4];
+	for(uint32_t face = 0; face < 6; face++){
+		float faceView[4][4];
+		updateCubeFace(faceView, face);
+		mat4_multiply(viewProj[face], (const float(*)[4])uboOffscreen.model, (const float(*)[4])faceView);
+		mat4_multiply(viewProj[face], (const float(*)[4])viewProj[face], (const float(*)[4])uboOffscreen.proj);
+	}
+	mat4_multiply(viewProj[6], (const float(*)[4])uboScene.view, (const float(*)[4])uboScene.proj);
+	updateCullingFrusta(&culling, currentFrame, (const float(*)[4][4])viewProj);
 }
 
 static void updateOffScreenUniformBuffer(){
@@ -134,121 +395,722 @@ static void updateOffScreenUniformBuffer(){
 	memcpy(uniformBufferOffscreen.pMappedData, &uboOffscreen, sizeof(uboOffscreen));
 }
 
+static void (*const createObjectMeshes[OBJECTSHAPENUM])(obj3d obj, vec *pVertices, vec *pIndices) = {createCuboid, createEllipsoid, createEllipticCylinder};
+static void (*const createObjectQuadrics[OBJECTSHAPENUM])(obj3d obj, vec *pQuadrics) = {NULL, createEllipsoidQuadric, createEllipticCylinderQuadric};
+
+static float viewDepth(const float view[4][4], const float pos[3]){
+	return -(view[0][2] * pos[0] + view[1][2] * pos[1] + view[2][2] * pos[2] + view[3][2]);
+}
+
+//one scene draw per object, the shape stands in for the material until objects have their own
+static void queueSceneDraw(const float view[4][4], const drawPipeline pipeline, const uint32_t material, const float pos[3], const uint32_t first, const uint32_t end){
+	if(end > first){
+		addDraw(&sceneDraws, RECORDPASSNUM - 1, pipeline, material, viewDepth(view, pos), (drawCommand){first, end - first});
+	}
+}
+
+//the cpu meshes and quadric instances of either the visible or the occluded objects, the visible ones are queued as scene draws
+static void addObjects(const vec objects[OBJECTSHAPENUM], const bool visible, const float view[4][4]){
+	uint32_t object = 0;
+	for(uint32_t shape = 0; shape < OBJECTSHAPENUM; shape++){
+		for(int i = 0; i < objects[shape].n; i++, object++){
+			if((!occlusionCulling || occlusion.visible[object]) != visible){
+				continue;
+			}
+			obj3d obj = ((obj3d*)objects[shape].array)[i];
+			const uint32_t firstIndex = indices.n;
+			const uint32_t firstQuadric = quadrics.n;
+			if(analyticQuadrics && createObjectQuadrics[shape] != NULL){
+				createObjectQuadrics[shape](obj, &quadrics);
+			}else if(!tessellateOnGpu){
+				createObjectMeshes[shape](obj, &vertices, &indices);
+			}
+			if(sortedDraws && visible){
+				queueSceneDraw(view, DRAW_PIPELINE_MESH, shape + 1, obj.pos, firstIndex, indices.n);
+				queueSceneDraw(view, DRAW_PIPELINE_QUADRIC, shape + 1, obj.pos, firstQuadric, quadrics.n);
+			}
+		}
+	}
+}
+
+//toggled at runtime, the command buffer key picks up the change
+static void updateDepthPrepass(const sharedBuffer buffer){
+	if(buffer.depthPrepass != depthPrepass){
+		depthPrepass = buffer.depthPrepass;
+		printf("depth pre-pass: %s\n", depthPrepass ? "on" : "off");
+	}
+}
+
+//the player sphere keeps its cpu mesh, its rings are shaded individually
+static void updateTessellationJob(void *data){
+	const sharedBuffer *pBuffer = (const sharedBuffer *)data;
+	const vec none = {NULL, sizeof(obj3d), 0, 0, 0};
+	updateGpuTessellation(&tessellation, device, physicalDevice, currentFrame, pBuffer->cuboids, analyticQuadrics ? none : pBuffer->ellipsoids, analyticQuadrics ? none : pBuffer->ellipsoidCylinders);
+	if(cullOnGpu){
+		updateGpuCulling(&culling, device, physicalDevice, &tessellation, currentFrame);
+	}
+}
+
+static void updateOcclusionJob(void *data){
+	const sharedBuffer *pBuffer = (const sharedBuffer *)data;
+	float view[4][4], proj[4][4], viewProj[4][4];
+	getCameraMatrices(*pBuffer, view, proj);
+	mat4_multiply(viewProj, (const float(*)[4])view, (const float(*)[4])proj);
+	const vec objects[OBJECTSHAPENUM] = {pBuffer->cuboids, pBuffer->ellipsoids, pBuffer->ellipsoidCylinders};
+	updateOcclusionCulling(&occlusion, (const float(*)[4])viewProj, objects);
+}
+
 static void updateGeometry(const sharedBuffer buffer){
+	//the gpu object records and the occlusion culling run as jobs while this thread builds the player and the draw queue
+	jobCounter counter;
+	atomic_init(&counter.pending, 0);
+	job jobs[2];
+	uint32_t jobNum = 0;
+	if(tessellateOnGpu){
+		jobs[jobNum++] = (job){updateTessellationJob, (void *)&buffer, &counter};
+	}
+	if(occlusionCulling){
+		jobs[jobNum++] = (job){updateOcclusionJob, (void *)&buffer, &counter};
+	}
+	runJobs(scheduler, jobs, jobNum);
+
 	vertices.n = map.vertexNum;
 	indices.n = map.indexNum;
+	quadrics.n = 0;
 	createPlayerSphere(buffer.playerModel, &vertices, &indices);
-	for(int i = 0; i < buffer.cuboids.n; i++){
-		createCuboid(((obj3d*)buffer.cuboids.array)[i], &vertices, &indices);
+	float view[4][4], proj[4][4];
+	getCameraMatrices(buffer, view, proj);
+	if(sortedDraws){
+		//the arena encloses every object, its own material puts it ahead of them
+		resetDrawQueue(&sceneDraws);
+		addDraw(&sceneDraws, RECORDPASSNUM - 1, DRAW_PIPELINE_MESH, 0, cameraNear, (drawCommand){0, map.indexNum});
+		queueSceneDraw((const float(*)[4])view, DRAW_PIPELINE_MESH, OBJECTSHAPENUM + 1, buffer.playerModel.pos, map.indexNum, indices.n);
 	}
-	for(int i = 0; i < buffer.ellipsoids.n; i++){
-		createEllipsoid(((obj3d*)buffer.ellipsoids.array)[i], &vertices, &indices);
+	const vec objects[OBJECTSHAPENUM] = {buffer.cuboids, buffer.ellipsoids, buffer.ellipsoidCylinders};
+	waitForJobs(scheduler, &counter);
+	//visible objects first, so the occluded ones are only in the shadow passes
+	addObjects(objects, true, (const float(*)[4])view);
+	sceneIndexNum = indices.n;
+	sceneQuadricNum = quadrics.n;
+	if(occlusionCulling){
+		addObjects(objects, false, (const float(*)[4])view);
 	}
-	for(int i = 0; i < buffer.ellipsoidCylinders.n; i++){
-		createEllipticCylinder(((obj3d*)buffer.ellipsoidCylinders.array)[i], &vertices, &indices);
+	if(sortedDraws){
+		sortDrawQueue(&sceneDraws);
+	}
+	if(analyticQuadrics){
+		vectorCheckCapacity(&quadrics);
 	}
 	vectorCheckCapacity(&vertices);
 	vectorCheckCapacity(&indices);
 
 }
 
-void presentImage(const sharedBuffer buffer){
+static void markSwapchainDirty(){
+	cthreads_mutex_lock(&resizeMutex);
+	swapchainDirty = true;
+	cthreads_mutex_unlock(&resizeMutex);
+}
+
+static bool getSwapchainDirty(VkExtent2D *pExtent){
+	cthreads_mutex_lock(&resizeMutex);
+	bool dirty = swapchainDirty;
+	*pExtent = framebufferExtent;
+	cthreads_mutex_unlock(&resizeMutex);
+	return dirty;
+}
+
+static void clearSwapchainDirty(const VkExtent2D extent){
+	cthreads_mutex_lock(&resizeMutex);
+	//a newer resize may have arrived while recreating
+	if(framebufferExtent.width == extent.width && framebufferExtent.height == extent.height){
+		swapchainDirty = false;
+	}
+	cthreads_mutex_unlock(&resizeMutex);
+}
+
+//a frame slot's fence covers every frame submitted before it, so after frameNum more frames nothing uses the retired objects
+static void deleteRetiredSwapchains(const bool all){
+	for(int i = retiredSwapchains.n - 1; i >= 0; i--){
+		retiredSwapchain *pRetired = &((retiredSwapchain *)retiredSwapchains.array)[i];
+		if(all || frameCount >= pRetired->frame + frameNum){
+			deleteScenePassTargets(device, &pRetired->scenePass);
+			deleteSwapchainAttachment(device, &pRetired->swapchain);
+			vectorRem(&retiredSwapchains, i);
+		}
+	}
+}
+
+//the cache holds one primary per frame slot and swapchain image, a larger swapchain needs a larger cache
+static void growCommandCache(){
+	vkWaitForFences(device, frameNum, sync.fences, VK_TRUE, UINT64_MAX);
+	deleteCommandRecorder(device, &recorder);
+	deleteCommandAttachment(device, &command, frameNum * cacheImageNum);
+	cacheImageNum = swapchain.imageNum;
+	command = createCommandAttachment(device, graphicsQueueFamilyIndex, frameNum * cacheImageNum);
+	recorder = createCommandRecorder(device, graphicsQueueFamilyIndex, frameNum * cacheImageNum, scheduler, recordPass);
+}
+
+//runs on the rendering thread between frames, the old swapchain is handed to the new one and retired instead of waiting for idle
+static void recreateSwapChain(const VkExtent2D extent){
+	retiredSwapchain retired = {
+		.swapchain = swapchain,
+		.scenePass = scenePass,
+		.frame = frameCount
+	};
+	vectorAdd(&retiredSwapchains, &retired);
+
+	swapchain = createSwapchainAttachment(device, physicalDevice, surface, extent, imageArrayLayers, queue.drawingMode, retired.swapchain.swapchain, activeLatencyMode);
+	//render pass and clear values only depend on formats and are kept
+	createScenePassTargets(device, physicalDevice, &scenePass, swapchain.surfaceFormat.format, depthFormat, getRenderExtent(&governor, swapchain.extent));
+
+	pipes.scene.scissor = configureScissor(scenePass.extent);
+	pipes.scene.viewport = configureViewport(scenePass.extent);
+	//histories are swapchain sized and the descriptor sets are shared by every frame slot, so this one waits
+	if(temporal){
+		vkWaitForFences(device, frameNum, sync.fences, VK_TRUE, UINT64_MAX);
+		deleteTemporalTargets(device, &resolve);
+		createTemporalTargets(device, physicalDevice, &resolve, swapchain.extent, command.pool, queue.drawing);
+		updateTemporalDescriptors(device, &resolve, scenePass.output.view, scenePass.velocity.view);
+		pipes.temporal.scissor = configureScissor(resolve.extent);
+		pipes.temporal.viewport = configureViewport(resolve.extent);
+	}
+	if(swapchain.imageNum > cacheImageNum){
+		growCommandCache();
+	} else {
+		invalidateCommandBuffers(&command, frameNum * cacheImageNum);
+	}
+}
+
+//waits for the frames in flight like growCommandCache, the governor steps at most once per cooldown so the stall stays rare
+static void applyRenderQuality(){
+	vkWaitForFences(device, frameNum, sync.fences, VK_TRUE, UINT64_MAX);
+	const VkExtent2D extent = getRenderExtent(&governor, swapchain.extent);
+	if(governor.samples != scenePass.samples){
+		deleteScenePass(device, &scenePass);
+		scenePass = createScenePass(device, physicalDevice, swapchain.surfaceFormat.format, depthFormat, governor.samples, extent, temporal);
+		deleteScenePipe(device, &pipes.scene);
+		pipes.scene = createScenePipe(device, scenePass.renderPass, scenePass.samples, &descriptor.layout, particleNum > 0 ? &particles.setLayout : NULL, scenePass.extent, temporal, pipelineCache, &shaders);
+	}else{
+		deleteScenePassTargets(device, &scenePass);
+		createScenePassTargets(device, physicalDevice, &scenePass, swapchain.surfaceFormat.format, depthFormat, extent);
+		pipes.scene.scissor = configureScissor(scenePass.extent);
+		pipes.scene.viewport = configureViewport(scenePass.extent);
+	}
+	if(temporal){
+		updateTemporalDescriptors(device, &resolve, scenePass.output.view, scenePass.velocity.view);
+	}
+	invalidateCommandBuffers(&command, frameNum * cacheImageNum);
+}
+
+static const char *getLatencyModeName(const latencyModes mode){
+	switch(mode){
+	case LATENCY_LOWEST: return "lowest-latency";
+	case LATENCY_BALANCED: return "balanced";
+	case LATENCY_POWER_SAVING: return "power-saving";
+	}
+	return "unknown";
+}
+
+//false when no frame was submitted, while minimized or when the swapchain went out of date
+bool presentImage(const sharedBuffer buffer){
+	frameTiming timing = {.poll = buffer.pollTime, .start = timer_current()};
 
 	vkWaitForFences(device, 1, &sync.fences[currentFrame], VK_TRUE, UINT64_MAX);
-	vkResetFences(device, 1, &sync.fences[currentFrame]);
-	
-	imageIndex = acquireNextImage(device, swapchain.swapchain, UINT64_MAX, sync.semaphores.wait[currentFrame], VK_NULL_HANDLE);
+	collectGpuTimestamps(&profiler, device, currentFrame, frameCount);
+	deleteRetiredSwapchains(false);
+	if(updateRenderGovernor(&governor, profiler.frameTime, cpuFrameTime)){
+		applyRenderQuality();
+	}
 
+	//a new latency policy means a new present mode and image count
+	if(buffer.latencyMode != activeLatencyMode){
+		activeLatencyMode = buffer.latencyMode;
+		printf("latency mode: %s\n", getLatencyModeName(activeLatencyMode));
+		resetLatencyRecorder(&latency);
+		markSwapchainDirty();
+	}
+
+	VkExtent2D extent;
+	if(getSwapchainDirty(&extent)){
+		//minimized, skip rendering until the window has a size again
+		if(extent.width == 0 || extent.height == 0){
+			return false;
+		}
+		recreateSwapChain(extent);
+		clearSwapchainDirty(extent);
+	}
+
+	VkResult result = acquireNextImage(device, swapchain.swapchain, UINT64_MAX, sync.semaphores.wait[currentFrame], VK_NULL_HANDLE, &imageIndex);
+	if(result == VK_ERROR_OUT_OF_DATE_KHR){
+		//nothing was acquired, the fence is still signaled for the next attempt
+		markSwapchainDirty();
+		return false;
+	}
+	vkResetFences(device, 1, &sync.fences[currentFrame]);
+	timing.acquired = timer_current();
 
 	updateGeometry(buffer);
-	recordCommandBuffers();
+	updateDepthPrepass(buffer);
+	VkCommandBuffer commandBuffer = recordCommandBuffers();
 
 	updateOffScreenUniformBuffer();
 	updateUniformBuffers(buffer);
+	if(cullOnGpu){
+		updateCullingViews();
+	}
 
-	VkPipelineStageFlags pipelineStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	VkSubmitInfo submitInfo = createSubmitInfo(&sync.semaphores.wait[currentFrame], &command.buffers[currentFrame], &sync.semaphores.signal[currentFrame], &pipelineStage);
+	//the swapchain image is first written by the upscale blit
+	VkPipelineStageFlags pipelineStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	VkSubmitInfo submitInfo = createSubmitInfo(&sync.semaphores.wait[currentFrame], &commandBuffer, &sync.semaphores.signal[currentFrame], &pipelineStage);
 	vkQueueSubmit(queue.drawing, 1, &submitInfo, sync.fences[currentFrame]);
+	markGpuTimestampsSubmitted(&profiler, currentFrame);
+	timing.submitted = timer_current();
+	cpuFrameTime = timer_ticks_to_seconds(timing.submitted - timing.acquired) * 1000.0;
 
 	VkPresentInfoKHR presentInfo = createPresentInfoKHR(&sync.semaphores.signal[currentFrame], &swapchain.swapchain, &imageIndex);
-	vkQueuePresentKHR(queue.presenting, &presentInfo);
-	currentFrame = (currentFrame + 1) % swapchain.imageNum;
+	VkResult presentResult = vkQueuePresentKHR(queue.presenting, &presentInfo);
+	timing.presented = timer_current();
+	recordFrameTiming(&latency, timing, getLatencyModeName(activeLatencyMode));
+	if(result == VK_SUBOPTIMAL_KHR || presentResult == VK_SUBOPTIMAL_KHR || presentResult == VK_ERROR_OUT_OF_DATE_KHR){
+		markSwapchainDirty();
+	}
+	currentFrame = (currentFrame + 1) % frameNum;
+	frameCount++;
+	return true;
 }
 
-void recreateSwapChain(GLFWwindow *pWindow, int width, int height){
-    // Wait for the device to finish before recreating the swap chain
-	vkDeviceWaitIdle(device);
-	// Wait if the window is minimized
-    while (width == 0 || height == 0) {
-        glfwWaitEvents();
-		glfwGetFramebufferSize(pWindow, &width, &height);
-    }
+//pass 0-5 are the shadow cube faces, 6 is the scene pass
+gpuPassStats getGpuPassTimings(const uint32_t pass){
+	return getGpuPassStats(&profiler, pass);
+}
 
-	int old_imageNum = swapchain.imageNum;
-	deleteSwapchainAttachment(device, &swapchain);
-	swapchain = createSwapchainAttachment(device, physicalDevice, surface, pWindow, imageArrayLayers, queue.drawingMode);
+//starts the pass statistics over, frames still in flight are dropped
+void resetGpuPassTimings(){
+	vkDeviceWaitIdle(device);
+	resetGpuProfiler(&profiler);
+}
 
-	deleteScenePass(device, &scenePass, old_imageNum);
-	scenePass = createScenePass(device, physicalDevice, swapchain.surfaceFormat.format, depthFormat, msaaSamples, swapchain.extent, swapchain.imageViews, swapchain.imageNum);
-	
-	pipes.scene.scissor = configureScissor(swapchain.extent);
-	pipes.scene.viewport = configureViewport(swapchain.extent);
+void requestSwapChainRecreation(int width, int height){
+	cthreads_mutex_lock(&resizeMutex);
+	framebufferExtent = (VkExtent2D){(uint32_t)width, (uint32_t)height};
+	swapchainDirty = true;
+	cthreads_mutex_unlock(&resizeMutex);
 }
 
-void initVulkan(GLFWwindow *pWindow){
-	instance = createInstance();
+static void initDevice(void *data){
+	GLFWwindow *pWindow = data;
+	instance = createInstance(headless);
 	physicalDevice = getBestPhysicalDevice(instance);
 
 	uint32_t queueFamilyNumber = getqueueFamilyNumber(physicalDevice);
 	VkQueueFamilyProperties *queueFamilyProperties = getQueueFamilyProperties(physicalDevice, queueFamilyNumber);
 	uint32_t bestGraphicsQueueFamilyindex = getBestGraphicsQueueFamilyindex(queueFamilyProperties, queueFamilyNumber);
+	graphicsQueueFamilyIndex = bestGraphicsQueueFamilyindex;
+	timestampValidBits = queueFamilyProperties[bestGraphicsQueueFamilyindex].timestampValidBits;
 	
-	device = createDevice(physicalDevice, queueFamilyNumber, queueFamilyProperties);
+	device = createDevice(physicalDevice, queueFamilyNumber, queueFamilyProperties, headless);
 	queue = createQueueAttachment(device, queueFamilyProperties, bestGraphicsQueueFamilyindex);
-	surface = createSurface(pWindow, instance, physicalDevice, bestGraphicsQueueFamilyindex);
+	if(!headless){
+		surface = createSurface(pWindow, instance, physicalDevice, bestGraphicsQueueFamilyindex);
+	}
 
 	deleteQueueFamilyProperties(&queueFamilyProperties);
+}
 
-	swapchain = createSwapchainAttachment(device, physicalDevice, surface, pWindow, imageArrayLayers, queue.drawingMode);
-	printf("frames in flight: %d\n", swapchain.imageNum);
+//RENDER_TARGET_FPS overrides the monitor refresh rate, 0 keeps msaa and resolution fixed, so does headless rendering
+static double getFrameBudget(){
+	if(headless){
+		return 0.0;
+	}
+	double fps = 60.0;
+	GLFWmonitor *pMonitor = glfwGetPrimaryMonitor();
+	const GLFWvidmode *pMode = pMonitor != NULL ? glfwGetVideoMode(pMonitor) : NULL;
+	if(pMode != NULL && pMode->refreshRate > 0){
+		fps = pMode->refreshRate;
+	}
+	const char *targetFps = getenv("RENDER_TARGET_FPS");
+	if(targetFps != NULL){
+		fps = atof(targetFps);
+	}
+	return fps > 0.0 ? 1000.0 / fps : 0.0;
+}
+
+//headless, framebufferExtent is set by initVulkanHeadless instead of the window
+static void initSwapchain(void *data){
+	GLFWwindow *pWindow = data;
+	if(!headless){
+		int width = 0, height = 0;
+		glfwGetFramebufferSize(pWindow, &width, &height);
+		framebufferExtent = (VkExtent2D){(uint32_t)width, (uint32_t)height};
+	}
+	cthreads_mutex_init(&resizeMutex, NULL);
+	initVector(&retiredSwapchains, sizeof(retiredSwapchain), 1, 1);
+
+	if(headless){
+		target = createHeadlessTarget(device, physicalDevice, framebufferExtent, HEADLESSFORMAT, HEADLESSIMAGENUM);
+		swapchain = getHeadlessSwapchainAttachment(&target);
+	}else{
+		swapchain = createSwapchainAttachment(device, physicalDevice, surface, framebufferExtent, imageArrayLayers, queue.drawingMode, VK_NULL_HANDLE, activeLatencyMode);
+	}
+	latency = createLatencyRecorder(LATENCYREPORTINTERVAL);
+	frameNum = swapchain.imageNum;
+	cacheImageNum = swapchain.imageNum;
+	printf("frames in flight: %d\n", frameNum);
 	msaaSamples = getMaxUsableSampleCount(physicalDevice);
 	depthFormat = findDepthFormat(physicalDevice);
-	command = createCommandAttachment(device, bestGraphicsQueueFamilyindex, swapchain.imageNum);
-	scenePass = createScenePass(device, physicalDevice, swapchain.surfaceFormat.format, depthFormat, msaaSamples, swapchain.extent, swapchain.imageViews, swapchain.imageNum);
+	//the temporal resolve reconstructs edges itself, so msaa stays off there
+	governor = createRenderGovernor(getFrameBudget(), temporal ? VK_SAMPLE_COUNT_1_BIT : msaaSamples, temporal ? temporalScale : 100);
+}
+
+//startup tasks below only touch their own state once the device exists, the graph orders the rest
+static void initCommand(void *data){
+	(void)data;
+	//one cached primary and set of secondaries per frame slot and swapchain image
+	command = createCommandAttachment(device, graphicsQueueFamilyIndex, frameNum * cacheImageNum);
+}
+
+static void initRecorder(void *data){
+	(void)data;
+	recorder = createCommandRecorder(device, graphicsQueueFamilyIndex, frameNum * cacheImageNum, scheduler, recordPass);
+}
+
+static void initScenePass(void *data){
+	(void)data;
+	scenePass = createScenePass(device, physicalDevice, swapchain.surfaceFormat.format, depthFormat, governor.samples, getRenderExtent(&governor, swapchain.extent), temporal);
+}
+
+//submits on the drawing queue with the main command pool, both externally synchronized
+static void initOffScreenPass(void *data){
+	(void)data;
 	offScreenPass = createOffScreenPass(device, physicalDevice, depthFormat, swapchain.surfaceFormat.format, shadowMapResolution, command.pool, queue.drawing);
-	uniformBuffers = createSceneUniformBuffers(device, physicalDevice, swapchain.imageNum);
+}
+
+static void initUniformBuffers(void *data){
+	(void)data;
+	uniformBuffers = createSceneUniformBuffers(device, physicalDevice, frameNum);
 	uniformBufferOffscreen = createOffScreenUniformBuffer(device, physicalDevice);
+}
 
-	VkBuffer *ubos = malloc(swapchain.imageNum * sizeof(VkBuffer));
-	for(uint32_t i = 0; i < swapchain.imageNum; i++){
+static void initLightClusters(void *data){
+	(void)data;
+	clusters = createLightClusters(device, physicalDevice, frameNum, clusteredLightNum);
+}
+
+//submits like initOffScreenPass, the graph orders it between that and the staging upload
+static void initShadowAtlas(void *data){
+	(void)data;
+	atlas = createShadowAtlas(device, physicalDevice, depthFormat, frameNum, shadowCasterNum < clusteredLightNum ? shadowCasterNum : clusteredLightNum, command.pool, queue.drawing);
+}
+
+static void initShadowAtlasPipe(void *data){
+	(void)data;
+	if(atlas.casterNum > 0){
+		atlas.pipe = createShadowAtlasPipe(device, atlas.pass.renderPass, &descriptor.layout, atlas.pass.size, pipelineCache, &shaders);
+	}
+}
+
+static void initDescriptors(void *data){
+	(void)data;
+	VkBuffer *ubos = malloc(frameNum * sizeof(VkBuffer));
+	for(uint32_t i = 0; i < frameNum; i++){
 		ubos[i] = uniformBuffers[i].buffer.buffer;
 	}
-	descriptor = createDescriptors(device, swapchain.imageNum, offScreenPass.shadowMap.color.view, offScreenPass.shadowMap.sampler, uniformBufferOffscreen.buffer.buffer, ubos);
+	descriptor = createDescriptors(device, frameNum, offScreenPass.shadowMap.color.view, offScreenPass.shadowMap.sampler, uniformBufferOffscreen.buffer.buffer, ubos, &clusters, &atlas);
 	free(ubos);
+}
+
+static void initPipelineCache(void *data){
+	(void)data;
+	//kept alive until shutdown so later pipeline rebuilds hit it too
+	pipelineCachePersistent = getPipelineCachePath(pipelineCachePath, sizeof(pipelineCachePath));
+	pipelineCache = loadPipelineCache(device, physicalDevice, pipelineCachePersistent ? pipelineCachePath : NULL);
+}
+
+static void initShaders(void *data){
+	(void)data;
+	shaders = createShaderCache();
+	loadPipelineShaders(device, &shaders);
+}
+
+static void initScenePipe(void *data){
+	(void)data;
+	pipes.scene = createScenePipe(device, scenePass.renderPass, scenePass.samples, &descriptor.layout, particleNum > 0 ? &particles.setLayout : NULL, scenePass.extent, temporal, pipelineCache, &shaders);
+}
+
+//submits like initOffScreenPass, the graph runs it after the staging upload
+static void initTemporalResolve(void *data){
+	(void)data;
+	resolve = createTemporalResolve(device, physicalDevice, swapchain.extent, frameNum, command.pool, queue.drawing);
+	updateTemporalDescriptors(device, &resolve, scenePass.output.view, scenePass.velocity.view);
+	pipes.temporal = createTemporalPipe(device, resolve.renderPass, &resolve.setLayout, resolve.extent, pipelineCache, &shaders);
+}
+
+static void initGpuTessellation(void *data){
+	(void)data;
+	tessellation = createGpuTessellation(device, physicalDevice, frameNum, pipelineCache, &shaders);
+	//reads the tessellation object buffers
+	if(cullOnGpu){
+		culling = createGpuCulling(device, physicalDevice, &tessellation, pipelineCache, &shaders);
+	}
+}
+
+static void initGpuParticles(void *data){
+	(void)data;
+	particles = createGpuParticles(device, physicalDevice, frameNum, particleNum, pipelineCache, &shaders);
+}
+
+static void initOffScreenPipe(void *data){
+	(void)data;
+	pipes.offscreen = createOffScreenPipe(device, offScreenPass.renderPass, &descriptor.layout, shadowMapResolution, pipelineCache, &shaders);
+}
 
-	pipes = createPipelines(device, scenePass.renderPass, offScreenPass.renderPass, msaaSamples, &descriptor.layout, swapchain.extent, shadowMapResolution);
-	sync = createSyncObjects(device, swapchain.imageNum);
+static void initSync(void *data){
+	(void)data;
+	sync = createSyncObjects(device, frameNum);
+	//set GPU_PROFILE_CSV to also dump the periodic gpu timings to a csv file
+	profiler = createGpuProfiler(device, physicalDevice, timestampValidBits, frameNum, getenv("GPU_PROFILE_CSV"));
+}
+
+static void initGeometry(void *data){
+	(void)data;
 	map = initMap(&vertices, &indices);
-	buffers = createDynamicBuffers(device, physicalDevice, indices, vertices, queue.drawing, command.pool, swapchain.imageNum);
+	initVector(&quadrics, sizeof(quadricInstance), 64, 64);
+	if(occlusionCulling && tessellateOnGpu){
+		printf("occlusion culling tests the cpu meshes, disabled with gpu tessellation\n");
+		occlusionCulling = false;
+	}
+	if(occlusionCulling){
+		occlusion = createOcclusionCuller();
+	}
+	if(sortedDraws){
+		sceneDraws = createDrawQueue(cameraNear, cameraFar);
+	}
+}
+
+static void initDynamicBuffers(void *data){
+	(void)data;
+	buffers = createDynamicBuffers(device, physicalDevice, indices, vertices, queue.drawing, command.pool, frameNum);
+	if(analyticQuadrics){
+		quadricInstances = createQuadricBuffers(device, physicalDevice, quadrics, frameNum);
+	}
+}
+
+static void initVulkanTasks(GLFWwindow *pWindow){
+	//the rendering and main threads help while they wait, so one worker fewer than there are cpus
+	const uint32_t cpuNum = getCpuCount();
+	scheduler = createJobSystem(cpuNum - 1 < JOBWORKERMAX ? cpuNum - 1 : JOBWORKERMAX);
+	printf("job system: %u workers\n", scheduler->workerNum);
+
+	startupGraph graph;
+	initStartupGraph(&graph);
+	runStartupTaskNow(&graph, "device", initDevice, pWindow);
+	runStartupTaskNow(&graph, "swapchain", initSwapchain, pWindow);
+
+	uint32_t commandTask = addStartupTask(&graph, "command pool", initCommand, NULL, 0);
+	addStartupTask(&graph, "recorder", initRecorder, NULL, 0);
+	uint32_t shaderTask = addStartupTask(&graph, "shaders", initShaders, NULL, 0);
+	uint32_t cacheTask = addStartupTask(&graph, "pipeline cache", initPipelineCache, NULL, 0);
+	uint32_t geometryTask = addStartupTask(&graph, "geometry", initGeometry, NULL, 0);
+	uint32_t scenePassTask = addStartupTask(&graph, "scene pass", initScenePass, NULL, 0);
+	uint32_t offScreenPassTask = addStartupTask(&graph, "offscreen pass", initOffScreenPass, NULL, 1u << commandTask);
+	uint32_t uniformTask = addStartupTask(&graph, "uniform buffers", initUniformBuffers, NULL, 0);
+	uint32_t lightClusterTask = addStartupTask(&graph, "light clusters", initLightClusters, NULL, 0);
+	uint32_t shadowAtlasTask = addStartupTask(&graph, "shadow atlas", initShadowAtlas, NULL, 1u << commandTask | 1u << offScreenPassTask);
+	uint32_t descriptorTask = addStartupTask(&graph, "descriptors", initDescriptors, NULL, 1u << offScreenPassTask | 1u << uniformTask | 1u << lightClusterTask | 1u << shadowAtlasTask);
+	uint32_t pipelineDependencies = 1u << descriptorTask | 1u << shaderTask | 1u << cacheTask;
+	//the scene pipe builds the billboard pipeline against the particle set layout
+	uint32_t particleDependency = particleNum > 0 ? 1u << addStartupTask(&graph, "gpu particles", initGpuParticles, NULL, 1u << shaderTask | 1u << cacheTask) : 0;
+	addStartupTask(&graph, "scene pipeline", initScenePipe, NULL, pipelineDependencies | 1u << scenePassTask | particleDependency);
+	addStartupTask(&graph, "offscreen pipeline", initOffScreenPipe, NULL, pipelineDependencies | 1u << offScreenPassTask);
+	addStartupTask(&graph, "shadow atlas pipeline", initShadowAtlasPipe, NULL, pipelineDependencies | 1u << shadowAtlasTask);
+	addStartupTask(&graph, "sync", initSync, NULL, 0);
+	//after the offscreen pass and the shadow atlas, the staging upload shares their queue and command pool
+	uint32_t dynamicBufferTask = addStartupTask(&graph, "dynamic buffers", initDynamicBuffers, NULL, 1u << geometryTask | 1u << commandTask | 1u << offScreenPassTask | 1u << shadowAtlasTask);
+	if(tessellateOnGpu){
+		addStartupTask(&graph, "gpu tessellation", initGpuTessellation, NULL, 1u << shaderTask | 1u << cacheTask);
+	}
+	if(temporal){
+		addStartupTask(&graph, "temporal resolve", initTemporalResolve, NULL, 1u << dynamicBufferTask | 1u << scenePassTask | 1u << shaderTask | 1u << cacheTask);
+	}
+
+	runStartupGraph(&graph, STARTUPTHREADNUM);
+	printStartupTimeline(&graph);
+	deleteStartupGraph(&graph);
+}
+
+//call before initVulkan or initVulkanHeadless, scale is the starting render scale in percent
+void enableTemporalUpscaling(const uint32_t scale){
+	temporal = true;
+	temporalScale = scale;
+}
+
+//call before initVulkan or initVulkanHeadless, the tessellated meshes stay the default
+void enableAnalyticQuadrics(){
+	analyticQuadrics = true;
+}
+
+//call before initVulkan or initVulkanHeadless, analytic quadrics still take the ellipsoids and cylinders
+void enableGpuTessellation(){
+	tessellateOnGpu = true;
+}
+
+//call before initVulkan or initVulkanHeadless, the shadow passes still draw the occluded objects
+void enableOcclusionCulling(){
+	occlusionCulling = true;
+}
+
+//call before initVulkan or initVulkanHeadless, the shadow passes keep drawing everything at once
+void enableSortedDraws(){
+	sortedDraws = true;
+}
+
+//call before initVulkan or initVulkanHeadless, at most PARTICLEMAX split between dust, sparks and the player trail
+void enableGpuParticles(const uint32_t count){
+	particleNum = count < PARTICLEMAX ? count : PARTICLEMAX;
+}
+
+//call before initVulkan or initVulkanHeadless, at most CLUSTERMAXLIGHTS scattered over the arena
+void enableClusteredLights(const uint32_t lightNum){
+	clusteredLightNum = lightNum < CLUSTERMAXLIGHTS ? lightNum : CLUSTERMAXLIGHTS;
+}
+
+//call before initVulkan or initVulkanHeadless, the first casterNum of the clustered lights, at most SHADOWLIGHTMAX
+void enableShadowAtlas(const uint32_t casterNum){
+	shadowCasterNum = casterNum < SHADOWLIGHTMAX ? casterNum : SHADOWLIGHTMAX;
+}
+
+//call before initVulkan or initVulkanHeadless, culls the gpu tessellated objects so it turns that on too
+void enableGpuCulling(){
+	tessellateOnGpu = true;
+	cullOnGpu = true;
+}
+
+void initVulkan(GLFWwindow *pWindow){
+	initVulkanTasks(pWindow);
+}
+
+//no window, no surface and no swapchain, the scene pass resolves into offscreen targets
+void initVulkanHeadless(const VkExtent2D extent){
+	headless = true;
+	framebufferExtent = extent;
+	initVulkanTasks(NULL);
+}
+
+//same work as presentImage minus acquire and present, targets are used round robin with the frame slots
+void renderHeadlessFrame(const sharedBuffer buffer){
+	vkWaitForFences(device, 1, &sync.fences[currentFrame], VK_TRUE, UINT64_MAX);
+	collectGpuTimestamps(&profiler, device, currentFrame, frameCount);
+	vkResetFences(device, 1, &sync.fences[currentFrame]);
+	imageIndex = currentFrame % swapchain.imageNum;
+
+	updateGeometry(buffer);
+	updateDepthPrepass(buffer);
+	VkCommandBuffer commandBuffer = recordCommandBuffers();
+
+	updateOffScreenUniformBuffer();
+	updateUniformBuffers(buffer);
+	if(cullOnGpu){
+		updateCullingViews();
+	}
+
+	VkSubmitInfo submitInfo = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.pNext = VK_NULL_HANDLE,
+		.waitSemaphoreCount = 0,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &commandBuffer,
+		.signalSemaphoreCount = 0
+	};
+	vkQueueSubmit(queue.drawing, 1, &submitInfo, sync.fences[currentFrame]);
+	markGpuTimestampsSubmitted(&profiler, currentFrame);
+	currentFrame = (currentFrame + 1) % frameNum;
+	frameCount++;
+}
+
+//prints the gpu pass timings, then reads back the last rendered target and optionally compares it to a golden image
+bool finishHeadlessRendering(const char *readbackPath, const char *goldenPath, const double minPsnr){
+	vkDeviceWaitIdle(device);
+	for(uint32_t pass = 0; pass < RECORDPASSNUM; pass++){
+		gpuPassStats stats = getGpuPassStats(&profiler, pass);
+		printf("gpu pass %u: min %.3f avg %.3f p99 %.3f ms over %u frames\n", pass, stats.min, stats.avg, stats.p99, stats.samples);
+	}
+	if(frameCount == 0 || (readbackPath == NULL && goldenPath == NULL)){
+		return true;
+	}
+
+	uint32_t lastImage = (uint32_t)((frameCount - 1) % frameNum) % swapchain.imageNum;
+	uint8_t *rgb = readbackHeadlessImage(device, physicalDevice, command.pool, queue.drawing, &target, lastImage);
+	bool success = true;
+	if(readbackPath != NULL){
+		success = writeImagePPM(readbackPath, rgb, swapchain.extent.width, swapchain.extent.height);
+		printf("final image written to %s\n", readbackPath);
+	}
+	if(goldenPath != NULL){
+		success = compareGoldenImage(goldenPath, rgb, swapchain.extent.width, swapchain.extent.height, minPsnr) && success;
+	}
+	free(rgb);
+	return success;
 }
 	
 void deleteVulkan(){
 	vkDeviceWaitIdle(device);
+	deleteRetiredSwapchains(true);
+	deleteVector(&retiredSwapchains);
+	deleteLatencyRecorder(&latency);
+	cthreads_mutex_destroy(&resizeMutex);
 	
-	deleteSyncObjects(device, &sync, swapchain.imageNum);
+	deleteSyncObjects(device, &sync, frameNum);
+	deleteGpuProfiler(device, &profiler);
 
-	deleteCommandAttachment(device, &command, swapchain.imageNum);
+	deleteCommandRecorder(device, &recorder);
+	deleteJobSystem(&scheduler);
+	deleteCommandAttachment(device, &command, frameNum * cacheImageNum);
 	deletePipelines(device, &pipes);
+	savePipelineCache(device, pipelineCache, pipelineCachePersistent ? pipelineCachePath : NULL);
+	deletePipelineCache(device, &pipelineCache);
+	deleteShaderCache(device, &shaders);
 	deleteDescriptors(device, &descriptor);
-	deleteMappedBuffers(device, uniformBuffers, swapchain.imageNum);
+	deleteMappedBuffers(device, uniformBuffers, frameNum);
 	deleteBuffer(device, &uniformBufferOffscreen.buffer);
-	deleteDynamicBuffers(device, &buffers, swapchain.imageNum);
+	deleteLightClusters(device, &clusters);
+	if(atlas.casterNum > 0){
+		deleteShadowAtlasPipe(device, &atlas.pipe);
+	}
+	deleteShadowAtlas(device, &atlas);
+	deleteDynamicBuffers(device, &buffers, frameNum);
+	if(analyticQuadrics){
+		deleteQuadricBuffers(device, &quadricInstances, frameNum);
+	}
+	if(cullOnGpu){
+		deleteGpuCulling(device, &culling);
+	}
+	if(occlusionCulling){
+		deleteOcclusionCuller(&occlusion);
+	}
+	if(sortedDraws){
+		deleteDrawQueue(&sceneDraws);
+	}
+	if(particleNum > 0){
+		deleteGpuParticles(device, &particles);
+	}
+	if(tessellateOnGpu){
+		deleteGpuTessellation(device, &tessellation);
+	}
 	deleteOffScreenPass(device, &offScreenPass);
-	deleteScenePass(device, &scenePass, swapchain.imageNum);
-	deleteSwapchainAttachment(device, &swapchain);
-	deleteSurface(instance, &surface);
+	if(temporal){
+		deleteTemporalResolve(device, &resolve);
+	}
+	deleteScenePass(device, &scenePass);
+	if(headless){
+		deleteHeadlessTarget(device, &target);
+	}else{
+		deleteSwapchainAttachment(device, &swapchain);
+		deleteSurface(instance, &surface);
+	}
 	deleteDevice(&device);
 	deleteInstance(&instance);
 	free(vertices.array);
 	free(indices.array);
+	free(quadrics.array);
 }
\ No newline at end of file
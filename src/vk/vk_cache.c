@@ -0,0 +1,211 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L // fileno and fsync
+#endif
+#include "vk_fun.h"
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#include <io.h>
+#else
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//creates every missing level, existing ones just fail to be created again
+static void makeDirectory(const char *path){
+	char partial[PATHMAXLENGTH];
+	snprintf(partial, sizeof(partial), "%s", path);
+	for(char *p = partial + 1; ; p++){
+		const bool end = *p == '\0';
+		if(end || *p == '/' || *p == '\\'){
+			const char separator = *p;
+			*p = '\0';
+#ifdef _WIN32
+			//a drive letter like C: is not a directory to create
+			if(p[-1] != ':'){
+				_mkdir(partial);
+			}
+#else
+			mkdir(partial, 0755);
+#endif
+			*p = separator;
+		}
+		if(end){
+			break;
+		}
+	}
+}
+
+//the data has to reach the disk before the rename does, otherwise a power loss can keep the new name with missing data
+static bool syncFile(FILE *fp){
+	if(fflush(fp) != 0){
+		return false;
+	}
+#ifdef _WIN32
+	return _commit(_fileno(fp)) == 0;
+#else
+	return fsync(fileno(fp)) == 0;
+#endif
+}
+
+//per user cache directory, %LOCALAPPDATA% on windows and $XDG_CACHE_HOME or ~/.cache elsewhere
+bool getPipelineCachePath(char *path, const size_t size){
+	char directory[PATHMAXLENGTH];
+#ifdef _WIN32
+	const char *base = getenv("LOCALAPPDATA");
+	if(base == NULL){
+		return false;
+	}
+	snprintf(directory, sizeof(directory), "%s\\vulkan_game", base);
+#else
+	const char *base = getenv("XDG_CACHE_HOME");
+	if(base != NULL && base[0] != '\0'){
+		snprintf(directory, sizeof(directory), "%s/vulkan_game", base);
+	}else{
+		base = getenv("HOME");
+		if(base == NULL){
+			return false;
+		}
+		snprintf(directory, sizeof(directory), "%s/.cache/vulkan_game", base);
+	}
+#endif
+	makeDirectory(directory);
+	return snprintf(path, size, "%s/%s", directory, PIPELINECACHEFILE) < (int)size;
+}
+
+//the driver may crash or misbehave on foreign data, so only data written by this exact device and driver is accepted
+static bool validatePipelineCacheData(const VkPhysicalDevice physicalDevice, const void *data, const size_t dataSize){
+	VkPipelineCacheHeaderVersionOne header;
+	if(dataSize < sizeof(header)){
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
+	VkPhysicalDeviceProperties physicalDeviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+	return header.headerSize >= sizeof(header) && header.headerSize <= dataSize &&
+		header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+		header.vendorID == physicalDeviceProperties.vendorID &&
+		header.deviceID == physicalDeviceProperties.deviceID &&
+		memcmp(header.pipelineCacheUUID, physicalDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+static void *readPipelineCacheFile(const char *path, size_t *pDataSize){
+	*pDataSize = 0;
+	FILE *fp = fopen(path, "rb");
+	if(fp == NULL){
+		return NULL;
+	}
+	fseek(fp, 0l, SEEK_END);
+	long fileSize = ftell(fp);
+	fseek(fp, 0l, SEEK_SET);
+	if(fileSize <= 0){
+		fclose(fp);
+		return NULL;
+	}
+	void *data = malloc((size_t)fileSize);
+	if(fread(data, 1, (size_t)fileSize, fp) != (size_t)fileSize){
+		free(data);
+		fclose(fp);
+		return NULL;
+	}
+	fclose(fp);
+	*pDataSize = (size_t)fileSize;
+	return data;
+}
+
+//starts empty when the file is missing, truncated or from another device or driver version
+VkPipelineCache loadPipelineCache(const VkDevice device, const VkPhysicalDevice physicalDevice, const char *path){
+	size_t dataSize = 0;
+	void *data = path != NULL ? readPipelineCacheFile(path, &dataSize) : NULL;
+	if(data != NULL && !validatePipelineCacheData(physicalDevice, data, dataSize)){
+		printf("pipeline cache %s does not match this device, rebuilding\n", path);
+		free(data);
+		data = NULL;
+		dataSize = 0;
+	}
+
+	VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+		.pNext = VK_NULL_HANDLE,
+		.flags = 0,
+		.initialDataSize = dataSize,
+		.pInitialData = data
+	};
+
+	VkPipelineCache pipelineCache;
+	if(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, VK_NULL_HANDLE, &pipelineCache) != VK_SUCCESS){
+		//retry without initial data rather than failing startup over a bad cache
+		pipelineCacheCreateInfo.initialDataSize = 0;
+		pipelineCacheCreateInfo.pInitialData = VK_NULL_HANDLE;
+		if(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, VK_NULL_HANDLE, &pipelineCache) != VK_SUCCESS){
+			printf("failed to create pipeline cache!\n");
+			exit(EXIT_FAILURE);
+		}
+	}else if(data != NULL){
+		printf("loaded pipeline cache: %zu bytes\n", dataSize);
+	}
+	free(data);
+	return pipelineCache;
+}
+
+//written and synced to a temporary file first and renamed over the old one, so a crash or power loss leaves either the old or the new cache
+void savePipelineCache(const VkDevice device, const VkPipelineCache pipelineCache, const char *path){
+	if(path == NULL){
+		return;
+	}
+	size_t dataSize = 0;
+	if(vkGetPipelineCacheData(device, pipelineCache, &dataSize, VK_NULL_HANDLE) != VK_SUCCESS || dataSize == 0){
+		return;
+	}
+	void *data = malloc(dataSize);
+	if(vkGetPipelineCacheData(device, pipelineCache, &dataSize, data) != VK_SUCCESS){
+		free(data);
+		return;
+	}
+
+	char tempPath[PATHMAXLENGTH];
+	snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+	FILE *fp = fopen(tempPath, "wb");
+	if(fp == NULL){
+		printf("failed to write pipeline cache %s\n", tempPath);
+		free(data);
+		return;
+	}
+	bool written = fwrite(data, 1, dataSize, fp) == dataSize && syncFile(fp);
+	fclose(fp);
+	free(data);
+	if(!written){
+		printf("failed to write pipeline cache %s\n", tempPath);
+		remove(tempPath);
+		return;
+	}
+#ifdef _WIN32
+	bool renamed = MoveFileExA(tempPath, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	bool renamed = rename(tempPath, path) == 0;
+#endif
+	if(!renamed){
+		printf("failed to replace pipeline cache %s\n", path);
+		remove(tempPath);
+		return;
+	}
+#ifndef _WIN32
+	//the rename itself lives in the directory entry
+	char directory[PATHMAXLENGTH];
+	snprintf(directory, sizeof(directory), "%s", path);
+	char *separator = strrchr(directory, '/');
+	if(separator != NULL){
+		*separator = '\0';
+		int fd = open(directory, O_RDONLY);
+		if(fd >= 0){
+			fsync(fd);
+			close(fd);
+		}
+	}
+#endif
+}
+
+void deletePipelineCache(const VkDevice device, VkPipelineCache *pPipelineCache){
+	vkDestroyPipelineCache(device, *pPipelineCache, VK_NULL_HANDLE);
+}
@@ -0,0 +1,223 @@
+#include "vk_fun.h"
+
+#define LIGHTORBIT 1.0f // radius the stress lights circle their resting position on
+#define LIGHTFRAMERATE 60.0f // the animation advances per frame so headless runs stay reproducible
+
+static mappedBuffer createStorageBuffer(const VkDevice device, const VkPhysicalDevice physicalDevice, const VkDeviceSize size){
+	mappedBuffer buffer;
+	buffer.buffer = createBuffer(device, physicalDevice, (uint32_t)size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	vkMapMemory(device, buffer.buffer.memory, 0, size, 0, &buffer.pMappedData);
+	return buffer;
+}
+
+//saturated color around the hue wheel
+static void hueColor(const float hue, float color[3]){
+	for(uint32_t channel = 0; channel < 3; channel++){
+		float h = fmodf(hue + channel / 3.0f, 1.0f) * 6.0f;
+		float c = h < 1.0f ? h : h < 3.0f ? 1.0f : h < 4.0f ? 4.0f - h : 0.0f;
+		color[channel] = c;
+	}
+}
+
+//scattered over the arena floor and up to the height of the pillars, same scene every run
+static pointLight *createStressLights(const uint32_t lightNum){
+	pointLight *lights = malloc(lightNum * sizeof(pointLight));
+	uint32_t seed = 12345u;
+	for(uint32_t i = 0; i < lightNum; i++){
+		float r[4];
+		for(uint32_t j = 0; j < 4; j++){
+			seed = seed * 1664525u + 1013904223u;
+			r[j] = (seed >> 8) / (float)(1u << 24);
+		}
+		lights[i] = (pointLight){
+			.pos = {-9.0f + 18.0f * r[0], -9.0f + 18.0f * r[1], 0.5f + 5.5f * r[2]},
+			.radius = 1.5f + 2.0f * r[3],
+			.intensity = 0.6f
+		};
+		hueColor(i * 0.618034f, lights[i].color);
+	}
+	return lights;
+}
+
+lightClusters createLightClusters(const VkDevice device, const VkPhysicalDevice physicalDevice, const uint32_t frameNum, const uint32_t lightNum){
+	lightClusters clusters = {
+		.sources = lightNum > 0 ? createStressLights(lightNum) : NULL,
+		.lightNum = lightNum,
+		.lights = malloc(frameNum * sizeof(mappedBuffer)),
+		.grid = malloc(frameNum * sizeof(mappedBuffer)),
+		.indices = malloc(frameNum * sizeof(mappedBuffer)),
+		.counts = malloc(CLUSTERNUM * sizeof(uint32_t)),
+		.cells = malloc(CLUSTERNUM * 2 * sizeof(uint32_t)),
+		.current = malloc((lightNum > 0 ? lightNum : 1) * sizeof(pointLight)),
+		.ranges = malloc((lightNum > 0 ? lightNum : 1) * sizeof(uint8_t[6])),
+		.frameNum = frameNum
+	};
+	for(uint32_t i = 0; i < frameNum; i++){
+		//the shaders bind them whether or not there are lights, an empty grid loops over nothing
+		clusters.lights[i] = createStorageBuffer(device, physicalDevice, (lightNum > 0 ? lightNum : 1) * sizeof(pointLight));
+		clusters.grid[i] = createStorageBuffer(device, physicalDevice, CLUSTERNUM * 2 * sizeof(uint32_t));
+		clusters.indices[i] = createStorageBuffer(device, physicalDevice, CLUSTERMAXINDICES * sizeof(uint32_t));
+		memset(clusters.grid[i].pMappedData, 0, CLUSTERNUM * 2 * sizeof(uint32_t));
+	}
+	if(lightNum > 0){
+		printf("clustered lights: %u point lights, %ux%ux%u clusters\n", lightNum, CLUSTERX, CLUSTERY, CLUSTERZ);
+	}
+	return clusters;
+}
+
+void deleteLightClusters(const VkDevice device, lightClusters *pClusters){
+	deleteMappedBuffers(device, pClusters->lights, pClusters->frameNum);
+	deleteMappedBuffers(device, pClusters->grid, pClusters->frameNum);
+	deleteMappedBuffers(device, pClusters->indices, pClusters->frameNum);
+	free(pClusters->sources);
+	free(pClusters->counts);
+	free(pClusters->cells);
+	free(pClusters->current);
+	free(pClusters->ranges);
+}
+
+//the shaders find their cluster from gl_FragCoord and the log of the view depth
+void getClusterParams(const VkExtent2D extent, const float near, const float far, float params[4]){
+	float logRange = logf(far / near);
+	params[0] = CLUSTERX / (float)extent.width;
+	params[1] = CLUSTERY / (float)extent.height;
+	params[2] = CLUSTERZ / logRange;
+	params[3] = -CLUSTERZ * logf(near) / logRange;
+}
+
+static uint8_t clampCluster(const float c, const uint32_t n){
+	return c <= 0.0f ? 0 : c >= n - 1 ? (uint8_t)(n - 1) : (uint8_t)c;
+}
+
+//clusters the sphere touches, false if it is outside the view frustum
+static bool lightRange(const pointLight *pLight, const float view[4][4], const float proj[4][4], const float params[4], uint8_t range[6]){
+	float v[3];
+	for(uint32_t row = 0; row < 3; row++){
+		v[row] = view[0][row] * pLight->pos[0] + view[1][row] * pLight->pos[1] + view[2][row] * pLight->pos[2] + view[3][row];
+	}
+	float depth = -v[2];
+	float near = expf(-params[3] / params[2]);
+	if(depth + pLight->radius <= near || logf(depth - pLight->radius > near ? depth - pLight->radius : near) * params[2] + params[3] >= CLUSTERZ){
+		return false;
+	}
+	range[4] = depth - pLight->radius > near ? clampCluster(logf(depth - pLight->radius) * params[2] + params[3], CLUSTERZ) : 0;
+	range[5] = clampCluster(logf(depth + pLight->radius) * params[2] + params[3], CLUSTERZ);
+
+	//a sphere through the camera plane can cover any pixel
+	if(depth - pLight->radius <= near){
+		range[0] = 0; range[1] = CLUSTERX - 1;
+		range[2] = 0; range[3] = CLUSTERY - 1;
+		return true;
+	}
+	//the projected corners of the box around the sphere hold its projection
+	float minNdc[2] = {1e30f, 1e30f}, maxNdc[2] = {-1e30f, -1e30f};
+	for(uint32_t corner = 0; corner < 8; corner++){
+		float c[3] = {
+			v[0] + (corner & 1 ? pLight->radius : -pLight->radius),
+			v[1] + (corner & 2 ? pLight->radius : -pLight->radius),
+			v[2] + (corner & 4 ? pLight->radius : -pLight->radius)
+		};
+		float clip[4];
+		for(uint32_t row = 0; row < 4; row++){
+			clip[row] = proj[0][row] * c[0] + proj[1][row] * c[1] + proj[2][row] * c[2] + proj[3][row];
+		}
+		for(uint32_t axis = 0; axis < 2; axis++){
+			float ndc = clip[axis] / clip[3];
+			minNdc[axis] = ndc < minNdc[axis] ? ndc : minNdc[axis];
+			maxNdc[axis] = ndc > maxNdc[axis] ? ndc : maxNdc[axis];
+		}
+	}
+	if(maxNdc[0] < -1.0f || minNdc[0] > 1.0f || maxNdc[1] < -1.0f || minNdc[1] > 1.0f){
+		return false;
+	}
+	range[0] = clampCluster((minNdc[0] + 1.0f) * 0.5f * CLUSTERX, CLUSTERX);
+	range[1] = clampCluster((maxNdc[0] + 1.0f) * 0.5f * CLUSTERX, CLUSTERX);
+	range[2] = clampCluster((minNdc[1] + 1.0f) * 0.5f * CLUSTERY, CLUSTERY);
+	range[3] = clampCluster((maxNdc[1] + 1.0f) * 0.5f * CLUSTERY, CLUSTERY);
+	return true;
+}
+
+static void reportLightClusters(lightClusters *pClusters){
+	if(++pClusters->framesSinceReport < CLUSTERREPORTINTERVAL){
+		return;
+	}
+	printf("light clusters over %u frames: %.1f of %u lights visible, %.1f indices, at most %u lights in a cluster, %.3f ms binning, %u frames over the index budget\n",
+		CLUSTERREPORTINTERVAL, pClusters->visibleSum / (double)CLUSTERREPORTINTERVAL, pClusters->lightNum, pClusters->indexSum / (double)CLUSTERREPORTINTERVAL,
+		pClusters->indexMax, pClusters->binningTime / CLUSTERREPORTINTERVAL, pClusters->overflows);
+	pClusters->visibleSum = 0;
+	pClusters->indexSum = 0;
+	pClusters->indexMax = 0;
+	pClusters->overflows = 0;
+	pClusters->binningTime = 0.0;
+	pClusters->framesSinceReport = 0;
+}
+
+//animates the lights and bins the visible ones, counted first so every cluster's list is contiguous
+void updateLightClusters(lightClusters *pClusters, const uint32_t frame, const uint64_t frameIndex, const float view[4][4], const float proj[4][4], const float params[4]){
+	if(pClusters->lightNum == 0){
+		return;
+	}
+	tick_t start = timer_current();
+	pointLight *lights = pClusters->lights[frame].pMappedData;
+	uint32_t visibleNum = 0;
+	memset(pClusters->counts, 0, CLUSTERNUM * sizeof(uint32_t));
+	for(uint32_t i = 0; i < pClusters->lightNum; i++){
+		pointLight light = pClusters->sources[i];
+		float angle = frameIndex / LIGHTFRAMERATE * (0.5f + (i % 7) * 0.15f) + i * 2.39996f;
+		light.pos[0] += LIGHTORBIT * cosf(angle);
+		light.pos[1] += LIGHTORBIT * sinf(angle);
+		lights[i] = light;
+		pClusters->current[i] = light;
+
+		uint8_t *range = pClusters->ranges[i];
+		if(!lightRange(&light, view, proj, params, range)){
+			range[4] = 1; range[5] = 0; // empty, skipped when filling
+			continue;
+		}
+		visibleNum++;
+		for(uint32_t z = range[4]; z <= range[5]; z++){
+			for(uint32_t y = range[2]; y <= range[3]; y++){
+				for(uint32_t x = range[0]; x <= range[1]; x++){
+					pClusters->counts[(z * CLUSTERY + y) * CLUSTERX + x]++;
+				}
+			}
+		}
+	}
+
+	uint32_t offset = 0;
+	bool overflow = false;
+	for(uint32_t cluster = 0; cluster < CLUSTERNUM; cluster++){
+		uint32_t count = pClusters->counts[cluster];
+		if(offset + count > CLUSTERMAXINDICES){
+			count = CLUSTERMAXINDICES - offset;
+			overflow = true;
+		}
+		pClusters->cells[cluster * 2] = offset;
+		pClusters->cells[cluster * 2 + 1] = count;
+		pClusters->indexMax = count > pClusters->indexMax ? count : pClusters->indexMax;
+		pClusters->counts[cluster] = 0;
+		offset += count;
+	}
+
+	uint32_t *indices = pClusters->indices[frame].pMappedData;
+	for(uint32_t i = 0; i < pClusters->lightNum; i++){
+		const uint8_t *range = pClusters->ranges[i];
+		for(uint32_t z = range[4]; z <= range[5]; z++){
+			for(uint32_t y = range[2]; y <= range[3]; y++){
+				for(uint32_t x = range[0]; x <= range[1]; x++){
+					uint32_t cluster = (z * CLUSTERY + y) * CLUSTERX + x;
+					if(pClusters->counts[cluster] < pClusters->cells[cluster * 2 + 1]){
+						indices[pClusters->cells[cluster * 2] + pClusters->counts[cluster]++] = i;
+					}
+				}
+			}
+		}
+	}
+	memcpy(pClusters->grid[frame].pMappedData, pClusters->cells, CLUSTERNUM * 2 * sizeof(uint32_t));
+
+	pClusters->visibleSum += visibleNum;
+	pClusters->indexSum += offset;
+	pClusters->overflows += overflow;
+	pClusters->binningTime += timer_ticks_to_seconds(timer_current() - start) * 1000.0;
+	reportLightClusters(pClusters);
+}
@@ -1,10 +1,10 @@
 #include "vk_fun.h"
 
-static VkCommandPool createCommandPool(const VkDevice device, const uint32_t queueFamilyIndex){
+VkCommandPool createCommandPool(const VkDevice device, const uint32_t queueFamilyIndex, const VkCommandPoolCreateFlags flags){
 	VkCommandPoolCreateInfo commandPoolCreateInfo = {
 		VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
 		VK_NULL_HANDLE,
-		VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+		flags,
 		queueFamilyIndex
 	};
 
@@ -13,15 +13,15 @@ static VkCommandPool createCommandPool(const VkDevice device, const uint32_t que
 	return commandPool;
 }
 
-static void deleteCommandPool(const VkDevice device, VkCommandPool *pCommandPool){
+void deleteCommandPool(const VkDevice device, VkCommandPool *pCommandPool){
 	vkDestroyCommandPool(device, *pCommandPool, VK_NULL_HANDLE);
 }
 
-static VkCommandBuffer *createCommandBuffers(const VkDevice device, const VkCommandPool commandPool, const uint32_t commandBufferNumber){
+VkCommandBuffer *createCommandBuffers(const VkDevice device, const VkCommandPool commandPool, const VkCommandBufferLevel level, const uint32_t commandBufferNumber){
 	VkCommandBufferAllocateInfo commandBufferAllocateInfo = {
 		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
 		.commandPool = commandPool,
-		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.level = level,
 		.commandBufferCount = commandBufferNumber,
 		.pNext = VK_NULL_HANDLE
 	};
@@ -31,7 +31,7 @@ static VkCommandBuffer *createCommandBuffers(const VkDevice device, const VkComm
 	return commandBuffers;
 }
 
-static void deleteCommandBuffers(const VkDevice device, VkCommandBuffer *commandBuffers, const VkCommandPool commandPool, const uint32_t commandBufferNumber){
+void deleteCommandBuffers(const VkDevice device, VkCommandBuffer *commandBuffers, const VkCommandPool commandPool, const uint32_t commandBufferNumber){
 	vkFreeCommandBuffers(device, commandPool, commandBufferNumber, commandBuffers);
 	free(commandBuffers);
 }
@@ -46,6 +46,24 @@ static VkCommandBufferBeginInfo configureCommandBufferBeginInfo(){
 	return commandBufferBeginInfo;
 }
 
+void beginSecondaryCommandBuffer(const VkCommandBuffer commandBuffer, const VkRenderPass renderPass, const VkFramebuffer framebuffer){
+	VkCommandBufferInheritanceInfo inheritanceInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+		.renderPass = renderPass,
+		.subpass = 0,
+		.framebuffer = framebuffer
+	};
+
+	VkCommandBufferBeginInfo beginInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		//no ONE_TIME_SUBMIT, recorded buffers are resubmitted while the draw list is unchanged
+		.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+		.pInheritanceInfo = &inheritanceInfo
+	};
+
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+}
+
 VkCommandBuffer beginSingleTimeCommands(const VkDevice device, const VkCommandPool commandPool) {
     VkCommandBufferAllocateInfo allocInfo = {
 		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
@@ -85,13 +103,20 @@ void endSingleTimeCommands(const VkDevice device, VkCommandBuffer *pCommandBuffe
 
 commandAttachment createCommandAttachment(const VkDevice device, const uint32_t queueFamilyIndex, const uint32_t commandBufferNumber){
 	commandAttachment command;
-	command.pool = createCommandPool(device, queueFamilyIndex);
-	command.buffers = createCommandBuffers(device, command.pool, commandBufferNumber);
+	command.pool = createCommandPool(device, queueFamilyIndex, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	command.buffers = createCommandBuffers(device, command.pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, commandBufferNumber);
+	command.keys = malloc(commandBufferNumber * sizeof(uint64_t));
+	invalidateCommandBuffers(&command, commandBufferNumber);
 	command.beginInfo = configureCommandBufferBeginInfo();
 	return command;
 }
 
 void deleteCommandAttachment(const VkDevice device, commandAttachment *pCommand, const uint32_t commandBufferNumber){
 	deleteCommandBuffers(device, pCommand->buffers, pCommand->pool, commandBufferNumber);
+	free(pCommand->keys);
 	deleteCommandPool(device, &pCommand->pool);
+}
+
+void invalidateCommandBuffers(commandAttachment *pCommand, const uint32_t commandBufferNumber){
+	memset(pCommand->keys, 0, commandBufferNumber * sizeof(uint64_t));
 }
\ No newline at end of file
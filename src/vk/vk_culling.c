@@ -0,0 +1,230 @@
+#include "vk_fun.h"
+
+static VkDescriptorSetLayout createCullingSetLayout(const VkDevice device){
+	const VkDescriptorType types[] = {
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+	};
+	VkDescriptorSetLayoutBinding bindings[4];
+	for(uint32_t i = 0; i < 4; i++){
+		bindings[i] = (VkDescriptorSetLayoutBinding){
+			.binding = i,
+			.descriptorType = types[i],
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+			.pImmutableSamplers = VK_NULL_HANDLE
+		};
+	}
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = sizeof(bindings) / sizeof(bindings[0]),
+		.pBindings = bindings
+	};
+	VkDescriptorSetLayout setLayout;
+	if(vkCreateDescriptorSetLayout(device, &layoutInfo, VK_NULL_HANDLE, &setLayout) != VK_SUCCESS){
+		fprintf(stderr, "Failed to create descriptor set layout\n");
+		exit(EXIT_FAILURE);
+	}
+	return setLayout;
+}
+
+static VkDescriptorPool createCullingDescriptorPool(const VkDevice device, const uint32_t frameNum){
+	VkDescriptorPoolSize poolSizes[] = {
+		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * frameNum},
+		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frameNum}
+	};
+	VkDescriptorPoolCreateInfo poolInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.poolSizeCount = 2,
+		.pPoolSizes = poolSizes,
+		.maxSets = frameNum
+	};
+	VkDescriptorPool pool;
+	if(vkCreateDescriptorPool(device, &poolInfo, VK_NULL_HANDLE, &pool) != VK_SUCCESS){
+		fprintf(stderr, "Failed to create descriptor pool\n");
+		exit(EXIT_FAILURE);
+	}
+	return pool;
+}
+
+//only for a frame slot whose fence was waited on, the cached command buffers key on the generation
+static void writeCullingDescriptors(const VkDevice device, gpuCulling *pCulling, const gpuTessellation *pTessellation, const uint32_t frame){
+	pCulling->tessellationGeneration[frame] = pTessellation->generation;
+	pCulling->generation++;
+	VkDescriptorBufferInfo bufferInfos[] = {
+		{pTessellation->objects[frame].buffer.buffer, 0, VK_WHOLE_SIZE},
+		{pCulling->frusta[frame].buffer.buffer, 0, VK_WHOLE_SIZE},
+		{pCulling->commands[frame].buffer, 0, VK_WHOLE_SIZE},
+		{pCulling->drawCounts[frame].buffer, 0, VK_WHOLE_SIZE}
+	};
+	VkWriteDescriptorSet descriptorWrites[4];
+	for(uint32_t binding = 0; binding < 4; binding++){
+		descriptorWrites[binding] = (VkWriteDescriptorSet){
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = pCulling->sets[frame],
+			.dstBinding = binding,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = binding == 1 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &bufferInfos[binding]
+		};
+	}
+	vkUpdateDescriptorSets(device, 4, descriptorWrites, 0, VK_NULL_HANDLE);
+}
+
+//one run of commands per view, sized like the tessellation object buffer
+static void createCommandBuffer(const VkDevice device, const VkPhysicalDevice physicalDevice, gpuCulling *pCulling, const uint32_t frame, const uint32_t capacity){
+	pCulling->capacity[frame] = capacity;
+	pCulling->commands[frame] = createBuffer(device, physicalDevice, CULLVIEWNUM * capacity * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+gpuCulling createGpuCulling(const VkDevice device, const VkPhysicalDevice physicalDevice, const gpuTessellation *pTessellation, const VkPipelineCache pipelineCache, shaderCache *pShaderCache){
+	gpuCulling culling;
+	const uint32_t frameNum = pTessellation->frameNum;
+	VkPhysicalDeviceFeatures features;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+	culling.frameNum = frameNum;
+	culling.drawIndirectCount = supportsDrawIndirectCount(physicalDevice);
+	culling.multiDrawIndirect = features.multiDrawIndirect == VK_TRUE;
+	printf("gpu culling: %s\n", culling.drawIndirectCount ? "draw indirect count" : culling.multiDrawIndirect ? "multi draw indirect" : "single draw indirect");
+	culling.setLayout = createCullingSetLayout(device);
+	culling.pool = createCullingDescriptorPool(device, frameNum);
+	culling.pipe = createCullingPipe(device, &culling.setLayout, culling.drawIndirectCount, pipelineCache, pShaderCache);
+	culling.sets = malloc(frameNum * sizeof(VkDescriptorSet));
+	culling.frusta = malloc(frameNum * sizeof(mappedBuffer));
+	culling.commands = malloc(frameNum * sizeof(VkBufferandMemory));
+	culling.drawCounts = malloc(frameNum * sizeof(VkBufferandMemory));
+	culling.capacity = malloc(frameNum * sizeof(uint32_t));
+	culling.tessellationGeneration = malloc(frameNum * sizeof(uint64_t));
+	culling.generation = 0;
+	culling.objectNum = calloc(frameNum, sizeof(uint32_t));
+	for(uint32_t i = 0; i < frameNum; i++){
+		VkDescriptorSetAllocateInfo allocInfo = {
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.descriptorPool = culling.pool,
+			.descriptorSetCount = 1,
+			.pSetLayouts = &culling.setLayout
+		};
+		if(vkAllocateDescriptorSets(device, &allocInfo, &culling.sets[i]) != VK_SUCCESS){fprintf(stderr, "Failed to allocate descriptor sets\n");exit(EXIT_FAILURE);}
+		culling.frusta[i].buffer = createBuffer(device, physicalDevice, CULLVIEWNUM * 6 * 4 * sizeof(float), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		vkMapMemory(device, culling.frusta[i].buffer.memory, 0, CULLVIEWNUM * 6 * 4 * sizeof(float), 0, &culling.frusta[i].pMappedData);
+		culling.drawCounts[i] = createBuffer(device, physicalDevice, CULLVIEWNUM * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		createCommandBuffer(device, physicalDevice, &culling, i, pTessellation->objectCapacity[i]);
+		writeCullingDescriptors(device, &culling, pTessellation, i);
+	}
+	return culling;
+}
+
+void deleteGpuCulling(const VkDevice device, gpuCulling *pCulling){
+	for(uint32_t i = 0; i < pCulling->frameNum; i++){
+		vkUnmapMemory(device, pCulling->frusta[i].buffer.memory);
+		deleteBuffer(device, &pCulling->frusta[i].buffer);
+		deleteBuffer(device, &pCulling->commands[i]);
+		deleteBuffer(device, &pCulling->drawCounts[i]);
+	}
+	deleteComputePipe(device, &pCulling->pipe);
+	//destroying the pool frees the sets
+	vkDestroyDescriptorPool(device, pCulling->pool, VK_NULL_HANDLE);
+	vkDestroyDescriptorSetLayout(device, pCulling->setLayout, VK_NULL_HANDLE);
+	free(pCulling->sets);
+	free(pCulling->frusta);
+	free(pCulling->commands);
+	free(pCulling->drawCounts);
+	free(pCulling->capacity);
+	free(pCulling->tessellationGeneration);
+	free(pCulling->objectNum);
+}
+
+//call after updateGpuTessellation, follows its object buffer when that one grows
+void updateGpuCulling(gpuCulling *pCulling, const VkDevice device, const VkPhysicalDevice physicalDevice, const gpuTessellation *pTessellation, const uint32_t frame){
+	const tessellationCounts counts = pTessellation->counts[frame];
+	pCulling->objectNum[frame] = counts.cuboidNum + counts.ellipsoidNum + counts.cylinderNum;
+	bool reallocated = false;
+	if(pTessellation->objectCapacity[frame] != pCulling->capacity[frame]){
+		deleteBuffer(device, &pCulling->commands[frame]);
+		createCommandBuffer(device, physicalDevice, pCulling, frame, pTessellation->objectCapacity[frame]);
+		reallocated = true;
+	}
+	if(reallocated || pTessellation->generation != pCulling->tessellationGeneration[frame]){
+		writeCullingDescriptors(device, pCulling, pTessellation, frame);
+	}
+}
+
+//rows of the view projection give the planes, normalized so the shader compares against the bounding radius
+static void extractFrustumPlanes(const float viewProj[4][4], float planes[6][4]){
+	for(uint32_t i = 0; i < 4; i++){
+		const float x = viewProj[i][0], y = viewProj[i][1], z = viewProj[i][2], w = viewProj[i][3];
+		planes[0][i] = w + x;
+		planes[1][i] = w - x;
+		planes[2][i] = w + y;
+		planes[3][i] = w - y;
+		planes[4][i] = z; // vulkan clips depth at zero
+		planes[5][i] = w - z;
+	}
+	for(uint32_t plane = 0; plane < 6; plane++){
+		const float length = sqrtf(planes[plane][0] * planes[plane][0] + planes[plane][1] * planes[plane][1] + planes[plane][2] * planes[plane][2]);
+		for(uint32_t i = 0; i < 4; i++){
+			planes[plane][i] /= length;
+		}
+	}
+}
+
+//viewProj takes model space to clip space for every pass, written before the frame is submitted
+void updateCullingFrusta(gpuCulling *pCulling, const uint32_t frame, const float viewProj[CULLVIEWNUM][4][4]){
+	float (*planes)[4] = pCulling->frusta[frame].pMappedData;
+	for(uint32_t view = 0; view < CULLVIEWNUM; view++){
+		extractFrustumPlanes(viewProj[view], &planes[view * 6]);
+	}
+}
+
+//after the tessellation dispatch in the same primary buffer, both only read the object records
+void recordGpuCulling(const VkCommandBuffer commandBuffer, const gpuCulling *pCulling, const gpuTessellation *pTessellation, const uint32_t frame){
+	const cullingConstants constants = {pTessellation->counts[frame], pCulling->capacity[frame]};
+	if(pCulling->objectNum[frame] == 0){
+		return;
+	}
+	if(pCulling->drawIndirectCount){
+		vkCmdFillBuffer(commandBuffer, pCulling->drawCounts[frame].buffer, 0, VK_WHOLE_SIZE, 0);
+		VkMemoryBarrier clearBarrier = {
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.pNext = VK_NULL_HANDLE,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+		};
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+	}
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pCulling->pipe.pipe);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pCulling->pipe.layout, 0, 1, &pCulling->sets[frame], 0, VK_NULL_HANDLE);
+	vkCmdPushConstants(commandBuffer, pCulling->pipe.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+	vkCmdDispatch(commandBuffer, (pCulling->objectNum[frame] + 63) / 64, 1, 1);
+
+	VkMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.pNext = VK_NULL_HANDLE,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT
+	};
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &barrier, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+}
+
+//the tessellated vertex and index buffers must be bound, view is the pass index
+void drawCulledObjects(const VkCommandBuffer commandBuffer, const gpuCulling *pCulling, const uint32_t frame, const uint32_t view){
+	const uint32_t objectNum = pCulling->objectNum[frame];
+	const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+	const VkDeviceSize offset = (VkDeviceSize)view * pCulling->capacity[frame] * stride;
+	if(objectNum == 0){
+		return;
+	}
+	if(pCulling->drawIndirectCount){
+		vkCmdDrawIndexedIndirectCount(commandBuffer, pCulling->commands[frame].buffer, offset, pCulling->drawCounts[frame].buffer, view * sizeof(uint32_t), objectNum, stride);
+	}else if(pCulling->multiDrawIndirect){
+		vkCmdDrawIndexedIndirect(commandBuffer, pCulling->commands[frame].buffer, offset, objectNum, stride);
+	}else{
+		//without multiDrawIndirect every call is limited to a single command
+		for(uint32_t i = 0; i < objectNum; i++){
+			vkCmdDrawIndexedIndirect(commandBuffer, pCulling->commands[frame].buffer, offset + (VkDeviceSize)i * stride, 1, stride);
+		}
+	}
+}
@@ -5,7 +5,7 @@ static VkDescriptorSetLayout createDescriptorSetLayout(const VkDevice device) {
         .binding = 0,
         .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
         .descriptorCount = 1,
-        .stageFlags =  VK_SHADER_STAGE_VERTEX_BIT,
+        .stageFlags =  VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, // ray cast quadrics project their hit points
         .pImmutableSamplers = VK_NULL_HANDLE
     };
 
@@ -17,7 +17,44 @@ static VkDescriptorSetLayout createDescriptorSetLayout(const VkDevice device) {
         .pImmutableSamplers = VK_NULL_HANDLE
     };
 
-    VkDescriptorSetLayoutBinding bindings[] = {uboLayoutBinding, shadowCubeMapLayoutBinding};
+    //clustered point lights, the light records, the offset and count per cluster and the light index lists
+    VkDescriptorSetLayoutBinding lightLayoutBindings[3];
+    for (uint32_t i = 0; i < 3; i++) {
+        lightLayoutBindings[i] = (VkDescriptorSetLayoutBinding){
+            .binding = 2 + i,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .pImmutableSamplers = VK_NULL_HANDLE
+        };
+    }
+
+    //shadow atlas of the casting point lights, its records and the faces the atlas pass renders this frame
+    VkDescriptorSetLayoutBinding shadowAtlasLayoutBindings[] = {
+        {
+            .binding = 5,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .pImmutableSamplers = VK_NULL_HANDLE
+        },
+        {
+            .binding = 6,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+            .pImmutableSamplers = VK_NULL_HANDLE
+        },
+        {
+            .binding = 7,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            .pImmutableSamplers = VK_NULL_HANDLE
+        }
+    };
+
+    VkDescriptorSetLayoutBinding bindings[] = {uboLayoutBinding, shadowCubeMapLayoutBinding, lightLayoutBindings[0], lightLayoutBindings[1], lightLayoutBindings[2], shadowAtlasLayoutBindings[0], shadowAtlasLayoutBindings[1], shadowAtlasLayoutBindings[2]};
 
     VkDescriptorSetLayoutCreateInfo layoutInfo = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
@@ -47,7 +84,11 @@ static VkDescriptorPool createDescriptorPool(const VkDevice device, const uint32
         },
         {
             .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .descriptorCount = maxSets
+            .descriptorCount = maxSets + maxFrames
+        },
+        {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 5 * maxFrames // the offscreen set leaves the light and shadow atlas bindings empty
         }
     };
 
@@ -71,7 +112,7 @@ static void deleteDescriptorPool(const VkDevice device, VkDescriptorPool *pDescr
     vkDestroyDescriptorPool(device, *pDescriptorPool, VK_NULL_HANDLE);
 }
 
-static descriptorSets createDescriptorSets(const VkDevice device, const uint32_t maxFrames, const VkDescriptorSetLayout *pDescriptorSetLayout, const VkDescriptorPool descriptorPool, const VkImageView shadowMapImageView, const VkSampler shadowMapSampler, const VkBuffer OffscreenBuffer, const VkBuffer *uniformBuffers) {
+static descriptorSets createDescriptorSets(const VkDevice device, const uint32_t maxFrames, const VkDescriptorSetLayout *pDescriptorSetLayout, const VkDescriptorPool descriptorPool, const VkImageView shadowMapImageView, const VkSampler shadowMapSampler, const VkBuffer OffscreenBuffer, const VkBuffer *uniformBuffers, const lightClusters *pClusters, const shadowAtlas *pAtlas) {
     descriptorSets sets = {
         .sceneSets = malloc((maxFrames) * sizeof(VkDescriptorSet)),
         .offscreen = VK_NULL_HANDLE
@@ -105,6 +146,11 @@ static descriptorSets createDescriptorSets(const VkDevice device, const uint32_t
         .imageView = shadowMapImageView,
         .sampler = shadowMapSampler,
     };
+    VkDescriptorImageInfo shadowAtlasInfo = {
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .imageView = pAtlas->pass.color.view,
+        .sampler = pAtlas->pass.sampler,
+    };
     for (size_t i = 0; i < maxFrames; i++) {
         if(vkAllocateDescriptorSets(device, &allocInfo, &sets.sceneSets[i]) != VK_SUCCESS){fprintf(stderr, "Failed to allocate descriptor sets\n");exit(EXIT_FAILURE);}
         VkDescriptorBufferInfo bufferInfo = {
@@ -112,6 +158,15 @@ static descriptorSets createDescriptorSets(const VkDevice device, const uint32_t
             .offset = 0,
             .range = sizeof(uniformDataScene)
         };
+        VkDescriptorBufferInfo lightInfos[] = {
+            {.buffer = pClusters->lights[i].buffer.buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+            {.buffer = pClusters->grid[i].buffer.buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+            {.buffer = pClusters->indices[i].buffer.buffer, .offset = 0, .range = VK_WHOLE_SIZE}
+        };
+        VkDescriptorBufferInfo shadowInfos[] = {
+            {.buffer = pAtlas->shadows[i].buffer.buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+            {.buffer = pAtlas->slots[i].buffer.buffer, .offset = 0, .range = VK_WHOLE_SIZE}
+        };
         VkWriteDescriptorSet descriptorWrite[] = {
             {
                 .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
@@ -130,6 +185,42 @@ static descriptorSets createDescriptorSets(const VkDevice device, const uint32_t
                 .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                 .descriptorCount = 1,
                 .pImageInfo = &shadowMapInfo
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = sets.sceneSets[i],
+                .dstBinding = 2,
+                .dstArrayElement = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 3, // consecutive bindings
+                .pBufferInfo = lightInfos
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = sets.sceneSets[i],
+                .dstBinding = 5,
+                .dstArrayElement = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .descriptorCount = 1,
+                .pImageInfo = &shadowAtlasInfo
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = sets.sceneSets[i],
+                .dstBinding = 6,
+                .dstArrayElement = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .pBufferInfo = &shadowInfos[0]
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = sets.sceneSets[i],
+                .dstBinding = 7,
+                .dstArrayElement = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .pBufferInfo = &shadowInfos[1]
             }
         };
         vkUpdateDescriptorSets(device, sizeof(descriptorWrite) / sizeof(descriptorWrite[0]), descriptorWrite, 0, VK_NULL_HANDLE);
@@ -142,11 +233,11 @@ static void deleteDescriptorSets(descriptorSets *pDescriptorSets) {
     free(pDescriptorSets->sceneSets);
 }
 
-descriptors createDescriptors(const VkDevice device, const uint32_t maxFrames, const VkImageView shadowMapImageView, const VkSampler shadowMapSampler, const VkBuffer OffscreenBuffer, const VkBuffer *uniformBuffers){
+descriptors createDescriptors(const VkDevice device, const uint32_t maxFrames, const VkImageView shadowMapImageView, const VkSampler shadowMapSampler, const VkBuffer OffscreenBuffer, const VkBuffer *uniformBuffers, const lightClusters *pClusters, const shadowAtlas *pAtlas){
     descriptors descs;
     descs.layout = createDescriptorSetLayout(device);
     descs.pool = createDescriptorPool(device, maxFrames);
-    descs.sets = createDescriptorSets(device, maxFrames, &descs.layout, descs.pool, shadowMapImageView, shadowMapSampler, OffscreenBuffer, uniformBuffers);
+    descs.sets = createDescriptorSets(device, maxFrames, &descs.layout, descs.pool, shadowMapImageView, shadowMapSampler, OffscreenBuffer, uniformBuffers, pClusters, pAtlas);
     return descs;
 }
 
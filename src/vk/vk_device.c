@@ -1,6 +1,25 @@
 #include "vk_fun.h"
 
-VkDevice createDevice(const VkPhysicalDevice physicalDevice, const uint32_t queueFamilyNumber, const VkQueueFamilyProperties *queueFamilyProperties){
+//core since vulkan 1.2 but still an optional feature
+bool supportsDrawIndirectCount(const VkPhysicalDevice physicalDevice){
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	if(properties.apiVersion < VK_API_VERSION_1_2){
+		return false;
+	}
+	VkPhysicalDeviceVulkan12Features features12 = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+		.pNext = VK_NULL_HANDLE
+	};
+	VkPhysicalDeviceFeatures2 features = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+		.pNext = &features12
+	};
+	vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+	return features12.drawIndirectCount == VK_TRUE;
+}
+
+VkDevice createDevice(const VkPhysicalDevice physicalDevice, const uint32_t queueFamilyNumber, const VkQueueFamilyProperties *queueFamilyProperties, const bool headless){
 	VkDeviceQueueCreateInfo *deviceQueueCreateInfo = (VkDeviceQueueCreateInfo *)malloc(queueFamilyNumber * sizeof(VkDeviceQueueCreateInfo));
 	float **queuePriorities = (float **)malloc(queueFamilyNumber * sizeof(float *));
 
@@ -26,16 +45,23 @@ VkDevice createDevice(const VkPhysicalDevice physicalDevice, const uint32_t queu
 	VkPhysicalDeviceFeatures physicalDeviceFeatures;
 	vkGetPhysicalDeviceFeatures(physicalDevice, &physicalDeviceFeatures);
 	physicalDeviceFeatures.samplerAnisotropy = VK_TRUE;
+	//the gpu culling draws with vkCmdDrawIndexedIndirectCount when it can
+	const bool drawIndirectCount = supportsDrawIndirectCount(physicalDevice);
+	VkPhysicalDeviceVulkan12Features features12 = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+		.pNext = VK_NULL_HANDLE,
+		.drawIndirectCount = VK_TRUE
+	};
 	
 	VkDeviceCreateInfo deviceCreateInfo = {
 		VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-		VK_NULL_HANDLE,
+		drawIndirectCount ? &features12 : VK_NULL_HANDLE,
 		0,
 		queueFamilyNumber,
 		deviceQueueCreateInfo,
 		0,
 		VK_NULL_HANDLE,
-		sizeof(deviceExtensions) / sizeof(deviceExtensions[0]),			// extension number
+		headless ? 0 : sizeof(deviceExtensions) / sizeof(deviceExtensions[0]),			// extension number, nothing is presented headless
 		deviceExtensions,	// extension names
 		&physicalDeviceFeatures
 	};
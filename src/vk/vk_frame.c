@@ -1,17 +1,22 @@
 #include "vk_fun.h"
 
-static VkRenderPass createSceneRenderPass(const VkDevice device, const VkFormat format, const VkFormat depthFormat, const VkSampleCountFlagBits numSamples){
+//the scene resolves into an image at the render extent, which is blitted to the swapchain image afterwards
+//temporal passes are single sampled and write motion vectors next to the color, both are sampled by the temporal resolve
+static VkRenderPass createSceneRenderPass(const VkDevice device, const VkFormat format, const VkFormat depthFormat, const VkSampleCountFlagBits numSamples, const bool temporal){
+	//without multisampling the color attachment is the output image itself and there is nothing to resolve
+	const bool multisampled = numSamples != VK_SAMPLE_COUNT_1_BIT;
+	const VkImageLayout outputLayout = temporal ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
 	VkAttachmentDescription attachmentDescriptions[] = {
-		{	// color attachment
+		{	// color attachment, only the resolve is kept
 			.flags = 0,
 			.format = format,
 			.samples = numSamples,
 			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+			.storeOp = multisampled ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE,
 			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
 			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
 			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-			.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+			.finalLayout = multisampled ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : outputLayout
 		},
 		{	// depth attachment
 			.flags = 0,
@@ -33,14 +38,19 @@ static VkRenderPass createSceneRenderPass(const VkDevice device, const VkFormat
 			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
 			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
 			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-			.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+			.finalLayout = outputLayout
 		}
 	};
+	//the velocity attachment takes the resolve slot, temporal passes never resolve
+	if(temporal){
+		attachmentDescriptions[2].format = TEMPORALVELOCITYFORMAT;
+		attachmentDescriptions[2].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	}
 
 
-	VkAttachmentReference colorAttachmentReference = {
-		0,
-		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+	VkAttachmentReference colorAttachmentReferences[] = {
+		{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+		{2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL} // velocity
 	};
 
 	VkAttachmentReference depthAttachmentReference = {
@@ -58,33 +68,44 @@ static VkRenderPass createSceneRenderPass(const VkDevice device, const VkFormat
 	    .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
 	    .inputAttachmentCount = 0,
 	    .pInputAttachments = NULL,
-	    .colorAttachmentCount = 1,
-	    .pColorAttachments = &colorAttachmentReference,
-	    .pResolveAttachments = &colorAttachmentResolveReference,
+	    .colorAttachmentCount = temporal ? 2 : 1,
+	    .pColorAttachments = colorAttachmentReferences,
+	    .pResolveAttachments = multisampled ? &colorAttachmentResolveReference : NULL,
 	    .pDepthStencilAttachment = &depthAttachmentReference,
 	    .preserveAttachmentCount = 0,
 		.pPreserveAttachments = NULL
 	};
 
-    VkSubpassDependency dependency = {
-		.srcSubpass = VK_SUBPASS_EXTERNAL,
-		.dstSubpass = 0,
-		.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
-		.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-		.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-		.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+	//the previous frame's blit or temporal resolve reads the output image, this frame's waits for the resolve
+    VkSubpassDependency dependencies[] = {
+		{
+			.srcSubpass = VK_SUBPASS_EXTERNAL,
+			.dstSubpass = 0,
+			.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+			.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+		},
+		{
+			.srcSubpass = 0,
+			.dstSubpass = VK_SUBPASS_EXTERNAL,
+			.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_SHADER_READ_BIT
+		}
 	};
 
 	VkRenderPassCreateInfo renderPassCreateInfo = {
 		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
 		.pNext = VK_NULL_HANDLE,
 		.flags = 0,
-		.attachmentCount = sizeof(attachmentDescriptions) / sizeof(attachmentDescriptions[0]), 
+		.attachmentCount = multisampled || temporal ? 3 : 2,
 		.pAttachments = attachmentDescriptions,
 		.subpassCount = 1,
 		.pSubpasses = &subpassDescription,
-		.dependencyCount = 1,
-		.pDependencies = &dependency
+		.dependencyCount = sizeof(dependencies) / sizeof(dependencies[0]),
+		.pDependencies = dependencies
 	};
 
 	VkRenderPass renderPass;
@@ -96,10 +117,12 @@ static void deleteRenderPass(const VkDevice device, VkRenderPass *pRenderPass){
 	vkDestroyRenderPass(device, *pRenderPass, VK_NULL_HANDLE);
 }
 
+//the third value clears the velocity attachment of temporal scene passes, other passes ignore it
 static VkClearValue *configureClearValues(const VkClearColorValue color, const VkClearDepthStencilValue depth){
-	VkClearValue *clearValues = malloc(2 * sizeof(VkClearValue));
+	VkClearValue *clearValues = malloc(3 * sizeof(VkClearValue));
 	clearValues[0].color = color;
 	clearValues[1].depthStencil = depth;
+	clearValues[2].color = (VkClearColorValue){{0.0f, 0.0f, 0.0f, 0.0f}};
 	return clearValues;
 }
 
@@ -126,58 +149,83 @@ static void deleteRenderPassBeginInfos(VkRenderPassBeginInfo *infos){
 	free(infos);
 }
 
-static VkFramebuffer *createFramebuffers(const VkDevice device, const VkRenderPass renderPass, const VkExtent2D extent, const VkImageView *imageViews, const uint32_t imageViewNumber, const VkImageView depthImageView, const VkImageView colorImageView){
-	VkFramebufferCreateInfo *framebufferCreateInfo = (VkFramebufferCreateInfo *)malloc(imageViewNumber * sizeof(VkFramebufferCreateInfo));
-	VkFramebuffer *framebuffers = (VkFramebuffer *)malloc(imageViewNumber * sizeof(VkFramebuffer));
+static VkFramebuffer createFramebuffer(const VkDevice device, const VkRenderPass renderPass, const VkExtent2D extent, const VkImageView *attachments, const uint32_t attachmentNumber){
+	VkFramebufferCreateInfo framebufferCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+		.pNext = VK_NULL_HANDLE,
+		.flags = 0,
+		.renderPass = renderPass,
+		.attachmentCount = attachmentNumber,
+		.pAttachments = attachments,
+		.width = extent.width,
+		.height = extent.height,
+		.layers = 1
+	};
+
+	VkFramebuffer framebuffer;
+	if(vkCreateFramebuffer(device, &framebufferCreateInfo, VK_NULL_HANDLE, &framebuffer) != VK_SUCCESS){fprintf(stderr, "Failed to create frame buffer\n");exit(EXIT_FAILURE);}
+	return framebuffer;
+}
 
-	for(uint32_t i = 0; i < imageViewNumber; i++){
-		VkImageView attachments[] = {
-			colorImageView,
-			depthImageView,
-			imageViews[i]
-		};
-		framebufferCreateInfo[i].sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		framebufferCreateInfo[i].pNext = VK_NULL_HANDLE;
-		framebufferCreateInfo[i].flags = 0;
-		framebufferCreateInfo[i].renderPass = renderPass;
-		framebufferCreateInfo[i].attachmentCount = sizeof(attachments) / sizeof(attachments[0]);
-		framebufferCreateInfo[i].pAttachments = attachments;
-		framebufferCreateInfo[i].width = extent.width;
-		framebufferCreateInfo[i].height = extent.height;
-		framebufferCreateInfo[i].layers = 1;
-
-		vkCreateFramebuffer(device, &framebufferCreateInfo[i], VK_NULL_HANDLE, &framebuffers[i]);
+//only the attachments, framebuffer and begin info depend on the render extent
+void createScenePassTargets(const VkDevice device, const VkPhysicalDevice physicalDevice, sceneRenderPassAttachment *pPass, const VkFormat surfaceFormat, const VkFormat depthFormat, const VkExtent2D extent){
+	pPass->extent = extent;
+	const VkImageUsageFlags outputUsage = pPass->temporal ? VK_IMAGE_USAGE_SAMPLED_BIT : VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	pPass->output = createFrameBufferAttachment(device, physicalDevice, extent.width, extent.height, surfaceFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | outputUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_ASPECT_COLOR_BIT, 1, 0, VK_IMAGE_VIEW_TYPE_2D);
+	//multisampled color and depth never leave the render pass, so tilers can keep them in tile memory
+	pPass->depth = createFrameBufferAttachment(device, physicalDevice, extent.width, extent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, TRANSIENTMEMORYPROPERTIES, pPass->samples, VK_IMAGE_ASPECT_DEPTH_BIT, 1, 0, VK_IMAGE_VIEW_TYPE_2D);
+	if(pPass->samples != VK_SAMPLE_COUNT_1_BIT){
+		pPass->color = createFrameBufferAttachment(device, physicalDevice, extent.width, extent.height, surfaceFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, TRANSIENTMEMORYPROPERTIES, pPass->samples, VK_IMAGE_ASPECT_COLOR_BIT, 1, 0, VK_IMAGE_VIEW_TYPE_2D);
+		VkImageView attachments[] = {pPass->color.view, pPass->depth.view, pPass->output.view};
+		pPass->frameBuffer = createFramebuffer(device, pPass->renderPass, extent, attachments, 3);
+	}else if(pPass->temporal){
+		pPass->color = (frameBufferAttachment){{VK_NULL_HANDLE, VK_NULL_HANDLE}, VK_NULL_HANDLE};
+		pPass->velocity = createFrameBufferAttachment(device, physicalDevice, extent.width, extent.height, TEMPORALVELOCITYFORMAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_ASPECT_COLOR_BIT, 1, 0, VK_IMAGE_VIEW_TYPE_2D);
+		VkImageView attachments[] = {pPass->output.view, pPass->depth.view, pPass->velocity.view};
+		pPass->frameBuffer = createFramebuffer(device, pPass->renderPass, extent, attachments, 3);
+	}else{
+		pPass->color = (frameBufferAttachment){{VK_NULL_HANDLE, VK_NULL_HANDLE}, VK_NULL_HANDLE};
+		VkImageView attachments[] = {pPass->output.view, pPass->depth.view};
+		pPass->frameBuffer = createFramebuffer(device, pPass->renderPass, extent, attachments, 2);
 	}
-
-	free(framebufferCreateInfo);
-	return framebuffers;
+	pPass->beginInfo = configureRenderPassBeginInfo(pPass->renderPass, &pPass->frameBuffer, 1, extent, pPass->clearValues, 3);
 }
 
-static void deleteFramebuffers(const VkDevice device, VkFramebuffer *framebuffers, const uint32_t framebufferNumber){
-	for(uint32_t i = 0; i < framebufferNumber; i++){
-		vkDestroyFramebuffer(device, framebuffers[i], VK_NULL_HANDLE);
+void deleteScenePassTargets(const VkDevice device, sceneRenderPassAttachment *pPass){
+	if(pPass->color.image.image != VK_NULL_HANDLE){
+		deleteFrameBufferAttachment(device, &pPass->color);
 	}
-	free(framebuffers);
+	deleteFrameBufferAttachment(device, &pPass->depth);
+	deleteFrameBufferAttachment(device, &pPass->output);
+	if(pPass->temporal){
+		deleteFrameBufferAttachment(device, &pPass->velocity);
+	}
+	vkDestroyFramebuffer(device, pPass->frameBuffer, VK_NULL_HANDLE);
+	deleteRenderPassBeginInfos(pPass->beginInfo);
 }
 
-sceneRenderPassAttachment createScenePass(const VkDevice device, const VkPhysicalDevice physicalDevice, const VkFormat surfaceFormat, const VkFormat depthFormat, const VkSampleCountFlagBits numSamples, const VkExtent2D extent, const VkImageView *swapchainImageViews, const uint32_t imageViewNumber){
+//the sample count is baked into the render pass, changing it means a new pass and new targets
+//temporal passes need a single sample
+sceneRenderPassAttachment createScenePass(const VkDevice device, const VkPhysicalDevice physicalDevice, const VkFormat surfaceFormat, const VkFormat depthFormat, const VkSampleCountFlagBits numSamples, const VkExtent2D extent, const bool temporal){
 	sceneRenderPassAttachment pass;
-	pass.renderPass = createSceneRenderPass(device, surfaceFormat, depthFormat, numSamples);
-	pass.color = createFrameBufferAttachment(device, physicalDevice, extent.width, extent.height, surfaceFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, numSamples, VK_IMAGE_ASPECT_COLOR_BIT, 1, 0, VK_IMAGE_VIEW_TYPE_2D);
-	pass.depth = createFrameBufferAttachment(device, physicalDevice, extent.width, extent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, numSamples, VK_IMAGE_ASPECT_DEPTH_BIT, 1, 0, VK_IMAGE_VIEW_TYPE_2D);
-	pass.frameBuffers = createFramebuffers(device, pass.renderPass, extent, swapchainImageViews, imageViewNumber, pass.depth.view, pass.color.view);
+	pass.samples = numSamples;
+	pass.temporal = temporal;
+	pass.renderPass = createSceneRenderPass(device, surfaceFormat, depthFormat, numSamples, temporal);
 	pass.clearValues = configureClearValues((VkClearColorValue){{0.0f, 0.0f, 0.0f, 1.0f}}, (VkClearDepthStencilValue){1.0f, 0});
-	pass.beginInfos = configureRenderPassBeginInfo(pass.renderPass, pass.frameBuffers, imageViewNumber, extent, pass.clearValues, 2);
+	pass.upscaleFilter = formatIsFilterable(physicalDevice, surfaceFormat, VK_IMAGE_TILING_OPTIMAL) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+	createScenePassTargets(device, physicalDevice, &pass, surfaceFormat, depthFormat, extent);
 	return pass;
 }
 
-void deleteScenePass(const VkDevice device, sceneRenderPassAttachment *pPass, const uint32_t imageViewNumber){
+void deleteScenePass(const VkDevice device, sceneRenderPassAttachment *pPass){
 	deleteRenderPass(device, &pPass->renderPass);
-	deleteFrameBufferAttachment(device, &pPass->color);
-	deleteFrameBufferAttachment(device, &pPass->depth);
-	deleteFramebuffers(device, pPass->frameBuffers, imageViewNumber);
+	deleteScenePassTargets(device, pPass);
 	deleteClearValues(pPass->clearValues);
-	deleteRenderPassBeginInfos(pPass->beginInfos);
+}
+
+//recorded after the scene pass, scales the render extent output to the target and leaves the target in finalLayout
+void recordSceneUpscale(const VkCommandBuffer commandBuffer, const sceneRenderPassAttachment *pPass, const VkImage target, const VkExtent2D targetExtent, const VkImageLayout finalLayout){
+	recordImageBlit(commandBuffer, pPass->output.image.image, pPass->extent, pPass->upscaleFilter, target, targetExtent, finalLayout);
 }
 
 static VkRenderPass createOffScreenRenderPass(const VkDevice device, const VkFormat depthFormat, const VkFormat colorFormat){
@@ -193,15 +241,15 @@ static VkRenderPass createOffScreenRenderPass(const VkDevice device, const VkFor
 			.initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 			.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
 		},
-		{
+		{	//depth is only used for testing, the distances go to the color cube map
 			.flags = 0,
 			.format = depthFormat,
 			.samples = VK_SAMPLE_COUNT_1_BIT,
 			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+			.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
 			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
 			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-			.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
 			.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
 		}
 	};
@@ -297,8 +345,8 @@ offScreenRenderPassAttachment createOffScreenPass(const VkDevice device, const V
 	if (depthFormat >= VK_FORMAT_D16_UNORM_S8_UINT) {
 		aspectFlags |= VK_IMAGE_ASPECT_STENCIL_BIT;
 	}
-	pass.depth = createFrameBufferAttachment(device, physicalDevice, shadowMapResolution, shadowMapResolution, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SAMPLE_COUNT_1_BIT, aspectFlags, 1, 0, VK_IMAGE_VIEW_TYPE_2D);
-	transferImageLayout(device, commandPool, drawingQueue, pass.depth.image.image, 1, 0, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, aspectFlags);
+	//cleared on load and discarded on store every face, the render pass starts it from UNDEFINED
+	pass.depth = createFrameBufferAttachment(device, physicalDevice, shadowMapResolution, shadowMapResolution, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, TRANSIENTMEMORYPROPERTIES, VK_SAMPLE_COUNT_1_BIT, aspectFlags, 1, 0, VK_IMAGE_VIEW_TYPE_2D);
 	pass.frameBuffers = createOffScreenFrameBuffers(device, pass.renderPass, pass.depth.view, pass.shadowMap.ImageViews, shadowMapResolution);
 	pass.clearValues = configureClearValues((VkClearColorValue){{0.0f, 0.0f, 0.0f, 1.0f}}, (VkClearDepthStencilValue){1.0f, 0});
 	pass.beginInfos = configureRenderPassBeginInfo(pass.renderPass, pass.frameBuffers, 6, (VkExtent2D){shadowMapResolution, shadowMapResolution}, pass.clearValues, 2);
@@ -316,4 +364,121 @@ void deleteOffScreenPass(const VkDevice device, offScreenRenderPassAttachment *p
 	deleteClearValues(pPass->clearValues);
 }
 
+//the color tiles are loaded, faces not updated this frame keep what earlier frames rendered
+static VkRenderPass createShadowAtlasRenderPass(const VkDevice device, const VkFormat depthFormat){
+	VkAttachmentDescription attachmentDescriptions[2] = {
+		{
+			.flags = 0,
+			.format = SHADOWATLASFORMAT,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD,
+			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+			.initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+		},
+		{	//the tiles do not overlap, so one clear serves every face of the frame
+			.flags = 0,
+			.format = depthFormat,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+			.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+			.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+		}
+	};
+
+	VkAttachmentReference colorAttachmentReference = {
+		.attachment = 0,
+		.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+	};
+
+	VkAttachmentReference depthAttachmentReference = {
+		.attachment = 1,
+		.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+	};
+
+	VkSubpassDescription subpassDescription = {
+	    .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+	    .colorAttachmentCount = 1,
+		.pColorAttachments = &colorAttachmentReference,
+	    .pDepthStencilAttachment = &depthAttachmentReference,
+		.inputAttachmentCount = 0,
+		.pInputAttachments = NULL,
+		.pResolveAttachments = NULL,
+		.preserveAttachmentCount = 0,
+		.pPreserveAttachments = NULL
+	};
+
+	//a tile may be handed to another light while the previous frame's scene pass still samples it
+	VkSubpassDependency dependencies[2] = {
+		{
+			.srcSubpass = VK_SUBPASS_EXTERNAL,
+			.dstSubpass = 0,
+			.srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			.srcAccessMask = VK_ACCESS_SHADER_READ_BIT,
+			.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			.dependencyFlags = 0
+		},
+		{
+			.srcSubpass = 0,
+			.dstSubpass = VK_SUBPASS_EXTERNAL,
+			.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+			.dependencyFlags = 0
+		}
+	};
+
+	VkRenderPassCreateInfo renderPassCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+		.attachmentCount = sizeof(attachmentDescriptions) / sizeof(attachmentDescriptions[0]),
+		.pAttachments = attachmentDescriptions,
+		.subpassCount = 1,
+		.pSubpasses = &subpassDescription,
+		.dependencyCount = sizeof(dependencies) / sizeof(dependencies[0]),
+		.pDependencies = dependencies,
+		.flags = 0
+	};
+	VkRenderPass renderPass;
+	if(vkCreateRenderPass(device, &renderPassCreateInfo, VK_NULL_HANDLE, &renderPass) != VK_SUCCESS){fprintf(stderr, "Failed to create render pass\n");exit(EXIT_FAILURE);}
+	return renderPass;
+}
+
+shadowAtlasPass createShadowAtlasPass(const VkDevice device, const VkPhysicalDevice physicalDevice, const VkFormat depthFormat, const uint32_t size, const VkCommandPool commandPool, const VkQueue drawingQueue){
+	shadowAtlasPass pass;
+	pass.size = size;
+	pass.color = createFrameBufferAttachment(device, physicalDevice, size, size, SHADOWATLASFORMAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_ASPECT_COLOR_BIT, 1, 0, VK_IMAGE_VIEW_TYPE_2D);
+	transferImageLayout(device, commandPool, drawingQueue, pass.color.image.image, 1, VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+	//tiles are sampled by their own rects, the shaders keep half a texel away from the edges
+	pass.sampler = createSampler(device, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_COMPARE_OP_NEVER);
+
+	pass.renderPass = createShadowAtlasRenderPass(device, depthFormat);
+	VkImageAspectFlagBits aspectFlags = VK_IMAGE_ASPECT_DEPTH_BIT;
+	if (depthFormat >= VK_FORMAT_D16_UNORM_S8_UINT) {
+		aspectFlags |= VK_IMAGE_ASPECT_STENCIL_BIT;
+	}
+	pass.depth = createFrameBufferAttachment(device, physicalDevice, size, size, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, TRANSIENTMEMORYPROPERTIES, VK_SAMPLE_COUNT_1_BIT, aspectFlags, 1, 0, VK_IMAGE_VIEW_TYPE_2D);
+	VkImageView attachments[] = {pass.color.view, pass.depth.view};
+	pass.frameBuffer = createFramebuffer(device, pass.renderPass, (VkExtent2D){size, size}, attachments, 2);
+	pass.clearValues = configureClearValues((VkClearColorValue){{1.0f, 0.0f, 0.0f, 0.0f}}, (VkClearDepthStencilValue){1.0f, 0});
+	pass.beginInfo = configureRenderPassBeginInfo(pass.renderPass, &pass.frameBuffer, 1, (VkExtent2D){size, size}, pass.clearValues, 2);
+	return pass;
+}
+
+void deleteShadowAtlasPass(const VkDevice device, shadowAtlasPass *pPass){
+	deleteFrameBufferAttachment(device, &pPass->color);
+	deleteFrameBufferAttachment(device, &pPass->depth);
+	deleteRenderPass(device, &pPass->renderPass);
+	vkDestroyFramebuffer(device, pPass->frameBuffer, VK_NULL_HANDLE);
+	deleteSampler(device, &pPass->sampler);
+	deleteRenderPassBeginInfos(pPass->beginInfo);
+	deleteClearValues(pPass->clearValues);
+}
+
 
@@ -13,6 +13,79 @@
 #define IndicesPerCube 36
 #define VerticesPerEllipticCylinder 2 + 4 * ELLIPSOIDDETAIL
 #define IndicesPerEllipticCylinder 12 * ELLIPSOIDDETAIL
+#define GpuVerticesPerEllipsoid ((ELLIPSOIDDETAIL + 1) * (2 * ELLIPSOIDDETAIL + 1)) // meshes of tessellate.comp, cuboids match the cpu ones
+#define GpuIndicesPerEllipsoid (12 * ELLIPSOIDDETAIL * ELLIPSOIDDETAIL)
+#define GpuVerticesPerEllipticCylinder (2 + 8 * ELLIPSOIDDETAIL)
+#define GpuIndicesPerEllipticCylinder (24 * ELLIPSOIDDETAIL)
+#define TESSELLATIONMINOBJECTS 64 // objects the gpu tessellation buffers start out sized for
+#define VerticesPerQuadric 36 // bounding box of a ray cast quadric, generated in the vertex shader
+#define RECORDPASSNUM 7 // six shadow cube faces + scene pass
+#define CULLVIEWNUM RECORDPASSNUM // the gpu culling tests one view per pass, in pass order
+#define HIZWIDTH 256 // cpu depth pyramid over the whole viewport, powers of two
+#define HIZHEIGHT 128
+#define HIZLEVELNUM 9 // down to a single texel
+#define OCCLUDERMINSIZE 1.0f // longest edge of the box inside an object before it is rasterized as an occluder
+#define OCCLUSIONREPORTINTERVAL 600 // frames per occlusion culling report
+#define CLUSTERX 16 // light clusters across the render extent
+#define CLUSTERY 9
+#define CLUSTERZ 24 // exponential view depth slices between the camera planes
+#define CLUSTERNUM (CLUSTERX * CLUSTERY * CLUSTERZ)
+#define CLUSTERMAXLIGHTS 1024
+#define CLUSTERMAXINDICES (CLUSTERNUM * 32) // light indices per frame, lists past it are cut short
+#define CLUSTERREPORTINTERVAL 600 // frames per light cluster report
+#define SHADOWATLASSIZE 2048 // texels per side, the atlas memory is the same whatever the light count
+#define SHADOWATLASFORMAT VK_FORMAT_R32_SFLOAT
+#define SHADOWTILEMAX 256 // cube face tiles are powers of two between these
+#define SHADOWTILEMIN 64
+#define SHADOWLEVELNUM 6 // quadtree levels from the whole atlas down to SHADOWTILEMIN
+#define SHADOWLIGHTMAX 64 // the first clustered lights cast atlas shadows
+#define SHADOWFACEBUDGET 12 // cube faces rendered into the atlas per frame
+#define SHADOWREPORTINTERVAL 600 // frames per shadow atlas report
+#define DRAWKEYINDEXBITS 20 // draw key fields from the low bits up, the draw index only breaks ties
+#define DRAWKEYDEPTHBITS 20 // view depth between the camera planes, smaller is nearer
+#define DRAWKEYMATERIALBITS 14
+#define DRAWKEYPIPELINEBITS 6
+#define DRAWKEYPASSBITS 4
+#define DRAWQUEUEMAX (1u << DRAWKEYINDEXBITS)
+#define DRAWSORTDIGITBITS 11 // radix digits over the bits above the draw index
+#define DRAWSORTDIGITNUM 4
+#define DRAWSORTBENCHMARKRUNS 10 // sorts per key count, the average is reported
+#define PARTICLEMAX (1u << 18) // particles in the pool, split between the emitters
+#define PARTICLEGROUPSIZE 256 // local_size_x of particles.comp
+#define PARTICLEEMITTERMAX 8
+#define PARTICLEMAXSTEP 0.05f // longest simulated step in seconds, a stalled frame does not fling particles through the walls
+#define JOBQUEUESIZE 4096 // jobs per worker deque, a power of two, jobs pushed to a full one run in place
+#define JOBWORKERMAX 64
+#define JOBSPINNUM 64 // failed searches for work before a worker sleeps
+#define JOBBENCHMARKPARENTS 64 // parent jobs that each spawn and wait for children, like a frame of nested work
+#define JOBBENCHMARKCHILDREN 256
+#define JOBBENCHMARKWORK 256 // iterations per child job
+#define JOBBENCHMARKRUNS 5 // runs per thread count, the average is reported
+#define LATENCYREPORTINTERVAL 600 // frames per latency report
+#define STARTUPTASKMAX 32 // tasks per startup graph, dependencies are a bitmask
+#define STARTUPTHREADNUM 4 // threads running startup tasks, including the calling one
+#define PIPELINECACHEFILE "pipeline_cache.bin"
+#define PATHMAXLENGTH 1024
+#define PROFILERWINDOW 256 // frames kept for gpu pass statistics
+#define PROFILERREPORTINTERVAL 600 // frames per gpu timing report
+#define FRAMESTARTQUERY (RECORDPASSNUM * 2) // query written before the copies and dispatches, after the pass queries
+#define PROFILERQUERYNUM (FRAMESTARTQUERY + 1)
+#define GOVERNORMINSCALE 50 // lowest render scale in percent of the swapchain extent
+#define GOVERNORSCALESTEP 10
+#define GOVERNORCOOLDOWN 60 // frames between quality steps
+#define GOVERNORMAXUPDELAY 1920 // frames, upper bound for the backoff after failed steps up
+#define GOVERNORSMOOTHING 0.1 // weight of the newest frame in the moving averages
+#define GOVERNOROVERLOAD 0.95 // share of the budget above which quality goes down
+#define GOVERNORHEADROOM 0.7 // share of the budget below which quality goes up
+#define TEMPORALHISTORYFORMAT VK_FORMAT_R16G16B16A16_SFLOAT
+#define TEMPORALVELOCITYFORMAT VK_FORMAT_R16G16_SFLOAT
+#define TEMPORALJITTERPHASES 8 // length of the halton jitter sequence
+#define TEMPORALFEEDBACK 0.9f // history weight for a still pixel
+#define TRANSIENTMEMORYPROPERTIES (VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) // falls back to device local without lazy memory
+#define HEADLESSIMAGENUM 2 // offscreen targets standing in for swapchain images
+#define HEADLESSFORMAT VK_FORMAT_R8G8B8A8_SRGB
+#define HEADLESSCHANNELTOLERANCE 8 // per channel difference still counted as a golden match
+#define HEADLESSMISMATCHRATIO 0.001 // share of channels allowed beyond the tolerance
 
 typedef struct MapSize {
     uint32_t vertexNum;
@@ -25,6 +98,28 @@ typedef struct Vertex {
     float normal[3];
 } vertex_t;
 
+typedef enum QuadricType {
+    QUADRIC_ELLIPSOID = 0,
+    QUADRIC_ELLIPTIC_CYLINDER = 1
+} quadricType;
+
+//the order the object vectors are tessellated and culled in
+typedef enum ObjectShape {
+    OBJECT_CUBOID = 0,
+    OBJECT_ELLIPSOID = 1,
+    OBJECT_ELLIPTIC_CYLINDER = 2,
+    OBJECTSHAPENUM = 3
+} objectShape;
+
+//one instance per ray cast ellipsoid or elliptic cylinder, constant size whatever the detail
+typedef struct QuadricInstance {
+    float center[3];
+    float type; // quadricType
+    float radii[4]; // semi axes, for cylinders the z one is the half height
+    float axes[3][4]; // object x, y and z axis in world space
+    float color[4];
+} quadricInstance;
+
 typedef struct UniformDataOffscrene {
     float proj[4][4];
     float view[4][4];
@@ -37,8 +132,17 @@ typedef struct UniformDataScene {
     float view[4][4];
     float model[4][4];
     float lightPos[4];
+    float currViewProj[4][4]; // without jitter, for motion vectors
+    float prevViewProj[4][4];
+    float clusterParams[4]; // clusters per pixel in x and y, scale and bias of the log depth slice
 } uniformDataScene;
 
+typedef struct UniformDataTemporal {
+    float jitter[2]; // in texture coordinates
+    float historyValid;
+    float feedback;
+} uniformDataTemporal;
+
 typedef struct VkBufferandMemory {
     VkBuffer buffer;
     VkDeviceMemory memory;
@@ -66,8 +170,191 @@ typedef struct StagingBufferAttachment{
 typedef struct DynamicBuffers{
     vertexAndIndexBuffers *buffers;
     stagingBufferAttachment *staging;
+    uint64_t generation; // bumped whenever a buffer is recreated, freed handles can come back with the same value
 } dynamicBuffers;
 
+typedef struct ComputePipe {
+    VkPipeline pipe;
+    VkPipelineLayout layout;
+} computePipe;
+
+//push constants of tessellate.comp, the records are stored in this order
+typedef struct TessellationCounts {
+    uint32_t cuboidNum;
+    uint32_t ellipsoidNum;
+    uint32_t cylinderNum;
+} tessellationCounts;
+
+//obj3d records in, vertices and indices out, everything per frame slot
+typedef struct GpuTessellation {
+    computePipe pipe;
+    VkDescriptorSetLayout setLayout;
+    VkDescriptorPool pool;
+    VkDescriptorSet *sets;
+    mappedBuffer *objects;
+    VkBufferandMemory *vertices; // storage buffer for the compute pass, vertex buffer for the draws
+    VkBufferandMemory *indices; // 32 bit indices into vertices
+    uint32_t *objectCapacity;
+    uint32_t *vertexCapacity;
+    uint32_t *indexCapacity;
+    tessellationCounts *counts;
+    uint32_t *indexNum;
+    uint32_t frameNum;
+    uint64_t generation; // bumped whenever a buffer is recreated and its set rewritten
+} gpuTessellation;
+
+//nearest is zero, texels keep the farthest depth below them
+typedef struct DepthPyramid {
+    float viewProj[4][4];
+    float *depth; // all levels, level 0 first
+    uint32_t offsets[HIZLEVELNUM];
+    bool valid;
+} depthPyramid;
+
+typedef struct OcclusionStats {
+    uint64_t tested;
+    uint64_t culled;
+    uint64_t falseNegatives; // hidden behind last frame's occluders but visible behind this frame's
+} occlusionStats;
+
+//two phase occlusion culling of the cpu meshes, last frame's pyramid first, then this frame's for what it hid
+typedef struct OcclusionCuller {
+    depthPyramid current;
+    depthPyramid history;
+    float *coverage; // level 0 sized, one occluder's nearest depth at the texel centers, infinity where uncovered
+    bool *visible; // one flag per object, cuboids, then ellipsoids, then elliptic cylinders
+    uint32_t capacity;
+    occlusionStats stats;
+    uint32_t framesSinceReport;
+} occlusionCuller;
+
+//push constants of cull.comp
+typedef struct CullingConstants {
+    tessellationCounts counts;
+    uint32_t capacity; // commands per view
+} cullingConstants;
+
+//bounds of the gpu tessellated objects against every view, indirect draws out, everything per frame slot
+typedef struct GpuCulling {
+    computePipe pipe;
+    VkDescriptorSetLayout setLayout;
+    VkDescriptorPool pool;
+    VkDescriptorSet *sets;
+    mappedBuffer *frusta; // six normalized planes per view
+    VkBufferandMemory *commands; // CULLVIEWNUM runs of capacity VkDrawIndexedIndirectCommand
+    VkBufferandMemory *drawCounts; // one per view, only filled when the commands are compacted
+    uint32_t *capacity;
+    uint64_t *tessellationGeneration; // tessellation generation the set was written against
+    uint32_t *objectNum;
+    uint32_t frameNum;
+    uint64_t generation; // bumped whenever a buffer is recreated or a set rewritten
+    bool drawIndirectCount; // compacted commands drawn with vkCmdDrawIndexedIndirectCount
+    bool multiDrawIndirect; // otherwise one indirect call per view with culled commands at zero instances
+} gpuCulling;
+
+//std430 layout of the light storage buffer
+typedef struct PointLight {
+    float pos[3];
+    float radius; // no light past it
+    float color[3];
+    float intensity;
+} pointLight;
+
+//point lights binned into view space froxels on the cpu, the scene shaders only loop over their cluster's list
+typedef struct LightClusters {
+    pointLight *sources; // resting positions, animated each frame
+    uint32_t lightNum;
+    mappedBuffer *lights; // per frame, the animated lights
+    mappedBuffer *grid; // per frame, offset and count into the index list per cluster
+    mappedBuffer *indices; // per frame, light indices grouped by cluster
+    uint32_t *counts; // binning scratch, lights per cluster, then the fill cursor
+    uint32_t *cells; // binning scratch, the grid before it is copied out
+    pointLight *current; // this frame's lights, also read by the shadow atlas
+    uint8_t (*ranges)[6]; // binning scratch, first and last cluster in x, y and z per light
+    uint32_t frameNum;
+    uint32_t visibleSum; // statistics since the last report
+    uint32_t indexSum;
+    uint32_t indexMax;
+    uint32_t overflows;
+    double binningTime;
+    uint32_t framesSinceReport;
+} lightClusters;
+
+//which draws of a pass are grouped, in the order the pass binds their pipelines
+typedef enum DrawPipeline {
+    DRAW_PIPELINE_MESH = 0,
+    DRAW_PIPELINE_QUADRIC = 1
+} drawPipeline;
+
+//an index range of the cpu meshes or a range of quadric instances
+typedef struct DrawCommand {
+    uint32_t first;
+    uint32_t count;
+} drawCommand;
+
+//a frame's draws as 64 bit keys of pass, pipeline, material and view depth, sorted to draw front to back per material
+typedef struct DrawQueue {
+    uint64_t *keys;
+    uint64_t *scratch; // the radix sort alternates between the two
+    drawCommand *commands; // indexed by the low bits of the keys
+    uint32_t drawNum;
+    uint32_t capacity;
+    float near; // the view depths the keys quantize
+    float far;
+    uint64_t orderHash; // the sorted commands, the command buffer key picks up a new order
+} drawQueue;
+
+//std430 layout of one particle in the state buffer
+typedef struct Particle {
+    float posLife[4]; // position, remaining life in seconds, dead at or below zero
+    float velocity[4]; // velocity, index of the emitter it came from
+} particle;
+
+//std430 layout of a particle emitter, the pool slots in its range respawn at it when they die
+typedef struct ParticleEmitter {
+    float posLife[4]; // spawn center, longest life in seconds
+    float velocity[4]; // mean start velocity, random speed on top of it
+    float color[4]; // rgb, billboard half size
+    float physics[4]; // gravity, drag, restitution at the arena bounds, spawn radius
+    uint32_t first; // pool slots
+    uint32_t count;
+    float rate; // particles per second
+    float pad;
+} particleEmitter;
+
+//std430 layout of the per frame particle parameters, all the cpu uploads
+typedef struct ParticleParams {
+    uint32_t parity; // half of the state buffer the simulation reads, it writes and the scene pass draws the other
+    uint32_t emitterNum;
+    uint32_t capacity;
+    uint32_t seed;
+    float dt;
+    uint32_t reset; // the state buffer is uninitialized before the first frame
+    uint32_t pad[2];
+    float arenaMin[4]; // the walls, floor and ceiling the player collides with, from shared_buffer.h
+    float arenaMax[4];
+    particleEmitter emitters[PARTICLEEMITTERMAX];
+} particleParams;
+
+//particles emitted, integrated and collided in a compute pass, the state buffer halves swap roles every frame
+typedef struct GpuParticles {
+    computePipe pipe;
+    VkDescriptorSetLayout setLayout;
+    VkDescriptorPool pool;
+    VkDescriptorSet *sets; // per frame, its parameters and the shared state buffer
+    mappedBuffer *params;
+    VkBufferandMemory state; // two halves of capacity particles
+    uint32_t capacity;
+    uint32_t frameNum;
+} gpuParticles;
+
+typedef struct QuadricBuffers{
+    VkBufferandMemory *buffers; // per frame instance buffers
+    mappedBuffer *staging;
+    uint32_t *bufferSizes; // shared by the staging and instance buffer of a frame
+    uint64_t generation; // bumped whenever the buffers of a frame are recreated
+} quadricBuffers;
+
 typedef struct VkImageandMemory {
     VkImage image;
     VkDeviceMemory memory;
@@ -93,15 +380,50 @@ typedef struct OffScreenRenderPassAttachment {
     VkClearValue *clearValues;
 } offScreenRenderPassAttachment;
 
-typedef struct SceneRenderPassAttachment {
-    VkFramebuffer *frameBuffers;
+//a single pass over the whole atlas, tiles rendered in earlier frames are loaded and kept
+typedef struct ShadowAtlasPass {
     frameBufferAttachment color;
     frameBufferAttachment depth;
     VkRenderPass renderPass;
-    VkRenderPassBeginInfo *beginInfos;
+    VkFramebuffer frameBuffer;
+    VkRenderPassBeginInfo *beginInfo;
+    VkClearValue *clearValues;
+    VkSampler sampler;
+    uint32_t size;
+} shadowAtlasPass;
+
+typedef struct SceneRenderPassAttachment {
+    VkFramebuffer frameBuffer;
+    frameBufferAttachment color; // multisampled, unused at one sample
+    frameBufferAttachment depth;
+    frameBufferAttachment output; // render extent image blitted to the swapchain image
+    frameBufferAttachment velocity; // motion vectors, temporal upscaling only
+    VkRenderPass renderPass;
+    VkRenderPassBeginInfo *beginInfo;
     VkClearValue *clearValues;
+    VkSampleCountFlagBits samples;
+    VkExtent2D extent; // render extent, the swapchain extent scaled by the governor
+    VkFilter upscaleFilter;
+    bool temporal; // output and velocity are sampled by the temporal resolve instead of blitted
 } sceneRenderPassAttachment;
 
+//reconstructs the swapchain resolution from jittered low resolution frames, each frame slot owns one history image
+typedef struct TemporalResolve {
+    VkRenderPass renderPass;
+    frameBufferAttachment *history; // written by its frame slot, read by the next one
+    VkFramebuffer *frameBuffers;
+    VkRenderPassBeginInfo *beginInfos;
+    VkSampler sampler;
+    VkDescriptorSetLayout setLayout;
+    VkDescriptorPool pool;
+    VkDescriptorSet *sets;
+    mappedBuffer *uniforms;
+    uint32_t frameNum;
+    VkExtent2D extent; // swapchain extent
+    uint32_t jitterIndex;
+    uint32_t historyFrames; // frames resolved since the history was last recreated
+} temporalResolve;
+
 typedef struct SwapchainAttachment {
     VkImage *images;
     VkImageView *imageViews;
@@ -109,8 +431,25 @@ typedef struct SwapchainAttachment {
     VkSwapchainKHR swapchain;
     VkExtent2D extent;
     VkSurfaceFormatKHR surfaceFormat;
+    VkPresentModeKHR presentMode;
 } swapchainAttachment;
 
+typedef struct HeadlessTarget {
+    frameBufferAttachment *attachments;
+    VkImage *images;
+    VkImageView *views;
+    uint32_t imageNum;
+    VkExtent2D extent;
+    VkFormat format;
+} headlessTarget;
+
+//old swapchain objects kept alive until the frames that used them have finished
+typedef struct RetiredSwapchain {
+    swapchainAttachment swapchain;
+    sceneRenderPassAttachment scenePass;
+    uint64_t frame;
+} retiredSwapchain;
+
 typedef struct DescriptorSets {
     VkDescriptorSet offscreen;
     VkDescriptorSet *sceneSets;
@@ -136,30 +475,250 @@ typedef struct DepthBias{
 
 typedef struct ScenePipe {
     VkPipeline pipe;
+    VkPipeline depthPrepass; // depth only, followed by depthEqual instead of pipe
+    VkPipeline depthEqual;
+    VkPipeline quadrics; // ray casts quadric instances, same layout
+    VkPipeline particles; // instanced billboards, VK_NULL_HANDLE without gpu particles
     VkPipelineLayout layout;
+    VkPipelineLayout particleLayout; // the scene set, then the particle set
     VkRect2D scissor;
     VkViewport viewport;
 } scenePipe;
 
 typedef struct OffScreenPipe {
     VkPipeline pipe;
+    VkPipeline quadrics;
     VkPipelineLayout layout;
     VkRect2D scissor;
     VkViewport viewport;
     depthBias bias;
 } offScreenPipe;
 
+typedef struct TemporalPipe {
+    VkPipeline pipe;
+    VkPipelineLayout layout;
+    VkRect2D scissor;
+    VkViewport viewport;
+} temporalPipe;
+
+//the atlas faces are placed by the vertex shader, so the viewport covers the whole atlas
+typedef struct ShadowAtlasPipe {
+    VkPipeline pipe;
+    VkPipeline clear; // a tile sized triangle at the far plane, drawn before the meshes of every face
+    VkPipelineLayout layout;
+    VkRect2D scissor;
+    VkViewport viewport;
+} shadowAtlasPipe;
+
+//std430 layout of the shadow storage buffer, one cube face of a shadow casting light
+typedef struct ShadowFace {
+    float viewProj[4][4];
+    float rect[4]; // atlas uv offset, uv size, nonzero once the tile holds this face
+} shadowFace;
+
+typedef struct ShadowRecord {
+    shadowFace faces[6];
+    float posFar[4]; // the light position the faces were rendered from and their far plane
+} shadowRecord;
+
+typedef struct ShadowTile {
+    uint16_t x;
+    uint16_t y;
+} shadowTile;
+
+typedef struct ShadowCaster {
+    shadowTile tiles[6];
+    uint32_t level; // quadtree level of the tiles, SHADOWLEVELNUM without tiles
+    uint32_t age; // frames since the faces were rendered
+    float influence; // screen radius of the light in pixels this frame
+} shadowCaster;
+
+//cube faces of several point lights packed into one 2d atlas, a few faces re-rendered per frame
+typedef struct ShadowAtlas {
+    shadowAtlasPass pass;
+    shadowAtlasPipe pipe;
+    shadowCaster *casters;
+    shadowRecord *records; // kept across frames, only the updated lights change
+    uint32_t casterNum;
+    shadowTile *freeTiles[SHADOWLEVELNUM]; // quadtree free lists, siblings are merged back on release
+    uint32_t freeNum[SHADOWLEVELNUM];
+    mappedBuffer *shadows; // per frame, caster count, atlas size and the records
+    mappedBuffer *slots; // per frame, the record face each of the SHADOWFACEBUDGET draws renders, ~0 when unused
+    uint32_t frameNum;
+    uint32_t faceSum; // statistics since the last report
+    uint32_t evictions;
+    uint32_t unshadowedMax;
+    uint32_t framesSinceReport;
+} shadowAtlas;
+
 typedef struct Pipelines {
     scenePipe scene;
     offScreenPipe offscreen;
+    temporalPipe temporal; // null handles unless temporal upscaling is enabled
 } pipelines;
 
+typedef struct EmbeddedShader {
+    const char *name;
+    const uint32_t *code;
+    size_t size;
+} embeddedShader;
+
+typedef struct ShaderBlob {
+    const uint32_t *code;
+    size_t size;
+    void *view; // mapped file view, NULL for embedded code
+    void *mapping; // file mapping handle on windows
+} shaderBlob;
+
+typedef struct CachedShader {
+    uint64_t hash;
+    size_t size;
+    VkShaderModule module;
+} cachedShader;
+
+typedef struct ShaderCache {
+    vec shaders;
+    struct cthreads_mutex mutex; // pipelines may be built on several startup threads
+} shaderCache;
+
 typedef struct CommandAttachment {
     VkCommandBuffer *buffers;
+    uint64_t *keys; // draw list key each buffer was last recorded with, 0 if invalid
     VkCommandPool pool;
     VkCommandBufferBeginInfo beginInfo;
 } commandAttachment;
 
+typedef void (*recordPassFunction)(const VkCommandBuffer commandBuffer, const uint32_t pass);
+
+typedef void (*jobFunction)(void *data);
+
+typedef struct JobCounter {
+    atomic_uint pending; // jobs submitted against it that have not finished
+} jobCounter;
+
+typedef struct Job {
+    jobFunction run;
+    void *data;
+    jobCounter *pCounter;
+} job;
+
+typedef struct JobWorker {
+    struct cthreads_thread thread;
+    struct cthreads_args args;
+    struct JobSystem *pSystem;
+    job *deque; // JOBQUEUESIZE slots, the owner pushes and pops at the bottom, thieves take from the top
+    atomic_int_fast64_t top;
+    char padding[64]; // keeps thieves and the owner off each other's cache line
+    atomic_int_fast64_t bottom;
+    uint32_t index;
+} jobWorker;
+
+typedef struct JobSystem {
+    jobWorker *workers;
+    uint32_t workerNum;
+    vec injected; // jobs submitted from threads outside the pool, behind the mutex
+    uint32_t injectedFirst;
+    atomic_uint injectedNum;
+    atomic_uint sleeping; // workers and waiters blocked on wake
+    atomic_bool running;
+    struct cthreads_mutex mutex;
+    struct cthreads_cond wake;
+} jobSystem;
+
+typedef struct CommandRecorder {
+    VkDevice device;
+    VkCommandPool *pools; // one per pass per slot, whichever thread records the pass
+    VkCommandBuffer *buffers; // RECORDPASSNUM secondary buffers per slot
+    struct RecordJob *jobs; // one per pass
+    jobSystem *pJobs;
+    uint32_t slotNum;
+    recordPassFunction record;
+} commandRecorder;
+
+typedef struct RecordJob {
+    commandRecorder *pRecorder;
+    uint32_t pass;
+    uint32_t slot;
+} recordJob;
+
+typedef void (*startupFunction)(void *data);
+
+typedef struct StartupTask {
+    const char *name;
+    startupFunction run;
+    void *data;
+    uint32_t dependencies; // bit i set means task i has to finish first
+    bool started;
+    bool finished;
+    uint32_t thread;
+    tick_t start;
+    tick_t end;
+} startupTask;
+
+typedef struct StartupWorker {
+    struct cthreads_thread thread;
+    struct cthreads_args args;
+    struct StartupGraph *pGraph;
+    uint32_t index;
+} startupWorker;
+
+typedef struct StartupGraph {
+    startupTask tasks[STARTUPTASKMAX];
+    uint32_t taskNum;
+    uint32_t finishedNum;
+    tick_t origin;
+    struct cthreads_mutex mutex;
+    struct cthreads_cond changed;
+} startupGraph;
+
+typedef struct FrameTiming {
+    tick_t poll; // before glfwPollEvents on the main thread
+    tick_t start; // rendering thread picked up the frame
+    tick_t acquired; // swapchain image acquired
+    tick_t submitted; // vkQueueSubmit returned
+    tick_t presented; // vkQueuePresentKHR returned
+} frameTiming;
+
+typedef struct LatencyRecorder {
+    frameTiming *frames;
+    uint32_t frameNum;
+    uint32_t reportInterval;
+} latencyRecorder;
+
+typedef struct GpuPassStats {
+    double min;
+    double avg;
+    double p99;
+    uint32_t samples;
+} gpuPassStats;
+
+typedef struct GpuProfiler {
+    VkQueryPool *pools; // one per frame slot, begin and end timestamp per pass plus the frame start
+    bool *pending; // slot was submitted with queries that have not been read back
+    uint32_t frameNum;
+    bool supported;
+    float timestampPeriod; // nanoseconds per tick
+    uint64_t timestampMask;
+    double *samples; // ring of PROFILERWINDOW frames, RECORDPASSNUM durations each
+    uint32_t sampleNum;
+    uint32_t nextSample;
+    uint32_t framesSinceReport;
+    double frameTime; // frame start to the end of the scene pass of the newest collected frame, in milliseconds
+    FILE *csv;
+} gpuProfiler;
+
+typedef struct RenderGovernor {
+    double budget; // milliseconds per frame, 0 disables the governor
+    double gpuTime; // moving averages in milliseconds
+    double cpuTime;
+    VkSampleCountFlagBits maxSamples;
+    VkSampleCountFlagBits samples;
+    uint32_t scale; // percent of the swapchain extent
+    uint32_t framesSinceStep;
+    uint32_t upDelay; // frames a level has to hold before stepping up
+    bool steppedUp; // last step went up
+} renderGovernor;
+
 typedef struct SemaphoresAttachment {
     VkSemaphore *signal;
     VkSemaphore *wait;
@@ -170,13 +729,14 @@ typedef struct SyncObjects {
     VkFence *fences;
 } syncObjects;
 
-VkInstance createInstance();
+VkInstance createInstance(const bool headless);
 void deleteInstance(VkInstance *pInstance);
 
 VkPhysicalDevice getBestPhysicalDevice(const VkInstance instance);
 VkSampleCountFlagBits getMaxUsableSampleCount(const VkPhysicalDevice physicalDevice);
 
-VkDevice createDevice(const VkPhysicalDevice physicalDevice, const uint32_t queueFamilyNumber, const VkQueueFamilyProperties *queueFamilyProperties);
+bool supportsDrawIndirectCount(const VkPhysicalDevice physicalDevice);
+VkDevice createDevice(const VkPhysicalDevice physicalDevice, const uint32_t queueFamilyNumber, const VkQueueFamilyProperties *queueFamilyProperties, const bool headless);
 void deleteDevice(VkDevice *pDevice);
 
 uint32_t getqueueFamilyNumber(const VkPhysicalDevice physicalDevice);
@@ -190,9 +750,9 @@ VkSubmitInfo createSubmitInfo(const VkSemaphore *pWaitSemaphores, const VkComman
 VkSurfaceKHR createSurface(GLFWwindow *pWindow, const VkInstance instance, const VkPhysicalDevice physicalDevice, const uint32_t graphicsQueueFamilyindex);
 void deleteSurface(const VkInstance instance, VkSurfaceKHR *pSurface);
 
-swapchainAttachment createSwapchainAttachment(const VkDevice device, const VkPhysicalDevice physicalDevice, const VkSurfaceKHR surface, GLFWwindow *pWindow, const uint32_t imageArrayLayers, const uint32_t graphicsQueueMode);
+swapchainAttachment createSwapchainAttachment(const VkDevice device, const VkPhysicalDevice physicalDevice, const VkSurfaceKHR surface, const VkExtent2D framebufferExtent, const uint32_t imageArrayLayers, const uint32_t graphicsQueueMode, const VkSwapchainKHR oldSwapchain, const latencyModes latencyMode);
 void deleteSwapchainAttachment(const VkDevice device, swapchainAttachment *pAttachment);
-uint32_t acquireNextImage(const VkDevice device, const VkSwapchainKHR swapchain, const uint64_t timeout, const VkSemaphore semaphore, const VkFence fence);
+VkResult acquireNextImage(const VkDevice device, const VkSwapchainKHR swapchain, const uint64_t timeout, const VkSemaphore semaphore, const VkFence fence, uint32_t *pImageIndex);
 
 VkImageView createImageView(const VkDevice device, const VkImage image, const VkFormat format, const VkImageAspectFlags aspectFlags, const VkImageViewType viewType, const uint32_t layerCount, const uint32_t baseArrayLayer);
 void transferImageLayout(const VkDevice device, const VkCommandPool commandPool, const VkQueue drawingQueue, const VkImage image, const uint32_t layerCount, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkImageLayout oldLayout, VkImageLayout newLayout, VkPipelineStageFlags sourceStage, VkPipelineStageFlags destinationStage, VkImageAspectFlags aspectMask);
@@ -203,47 +763,154 @@ void deleteSampler(const VkDevice device, VkSampler *pSampler);
 VkImageView *createShadowCubeMapFaceImageViews(const VkDevice device, const VkImage image, const VkFormat format);
 void deleteShadowCubeMapFaceImageViews(const VkDevice device, VkImageView *pImageViews);
 
-sceneRenderPassAttachment createScenePass(const VkDevice device, const VkPhysicalDevice physicalDevice, const VkFormat surfaceFormat, const VkFormat depthFormat, const VkSampleCountFlagBits numSamples, const VkExtent2D extent, const VkImageView *swapchainImageViews, const uint32_t imageViewNumber);
-void deleteScenePass(const VkDevice device, sceneRenderPassAttachment *pPass, const uint32_t imageViewNumber);
+sceneRenderPassAttachment createScenePass(const VkDevice device, const VkPhysicalDevice physicalDevice, const VkFormat surfaceFormat, const VkFormat depthFormat, const VkSampleCountFlagBits numSamples, const VkExtent2D extent, const bool temporal);
+void deleteScenePass(const VkDevice device, sceneRenderPassAttachment *pPass);
+void createScenePassTargets(const VkDevice device, const VkPhysicalDevice physicalDevice, sceneRenderPassAttachment *pPass, const VkFormat surfaceFormat, const VkFormat depthFormat, const VkExtent2D extent);
+void deleteScenePassTargets(const VkDevice device, sceneRenderPassAttachment *pPass);
+void recordImageBlit(const VkCommandBuffer commandBuffer, const VkImage source, const VkExtent2D sourceExtent, const VkFilter filter, const VkImage target, const VkExtent2D targetExtent, const VkImageLayout finalLayout);
+void recordSceneUpscale(const VkCommandBuffer commandBuffer, const sceneRenderPassAttachment *pPass, const VkImage target, const VkExtent2D targetExtent, const VkImageLayout finalLayout);
 offScreenRenderPassAttachment createOffScreenPass(const VkDevice device, const VkPhysicalDevice physicalDevice, const VkFormat depthFormat, const VkFormat colorFormat, const uint32_t shadowMapResolution, const VkCommandPool commandPool, const VkQueue drawingQueue);
 void deleteOffScreenPass(const VkDevice device, offScreenRenderPassAttachment *pPass);
+shadowAtlasPass createShadowAtlasPass(const VkDevice device, const VkPhysicalDevice physicalDevice, const VkFormat depthFormat, const uint32_t size, const VkCommandPool commandPool, const VkQueue drawingQueue);
+void deleteShadowAtlasPass(const VkDevice device, shadowAtlasPass *pPass);
 
-VkShaderModule getShader(const VkDevice device, const char *fileName);
-void deleteShader(const VkDevice device, VkShaderModule *pShaderModule);
+shaderCache createShaderCache();
+void deleteShaderCache(const VkDevice device, shaderCache *pCache);
+VkShaderModule getShader(const VkDevice device, shaderCache *pCache, const char *fileName);
 
-descriptors createDescriptors(const VkDevice device, const uint32_t maxFrames, const VkImageView shadowMapImageView, const VkSampler shadowMapSampler, const VkBuffer OffscreenBuffer, const VkBuffer *uniformBuffers);
+descriptors createDescriptors(const VkDevice device, const uint32_t maxFrames, const VkImageView shadowMapImageView, const VkSampler shadowMapSampler, const VkBuffer OffscreenBuffer, const VkBuffer *uniformBuffers, const lightClusters *pClusters, const shadowAtlas *pAtlas);
 void deleteDescriptors(const VkDevice device, descriptors *pDescriptors);
 
-pipelines createPipelines(const VkDevice device, const VkRenderPass sceneRenderPass, const VkRenderPass offscreenRenderPass, const VkSampleCountFlagBits numSamples, const VkDescriptorSetLayout *pDescriptorSetLayout, const VkExtent2D sceneExtent, const uint32_t shadowMapResolution);    void deletePipelines(const VkDevice device, pipelines *pPipelines);
+void loadPipelineShaders(const VkDevice device, shaderCache *pShaderCache);
+scenePipe createScenePipe(const VkDevice device, const VkRenderPass sceneRenderPass, const VkSampleCountFlagBits numSamples, const VkDescriptorSetLayout *pDescriptorSetLayout, const VkDescriptorSetLayout *pParticleSetLayout, const VkExtent2D sceneExtent, const bool temporal, const VkPipelineCache pipelineCache, shaderCache *pShaderCache);
+void deleteScenePipe(const VkDevice device, scenePipe *pPipe);
+computePipe createTessellationPipe(const VkDevice device, const VkDescriptorSetLayout *pDescriptorSetLayout, const VkPipelineCache pipelineCache, shaderCache *pShaderCache);
+computePipe createCullingPipe(const VkDevice device, const VkDescriptorSetLayout *pDescriptorSetLayout, const bool compact, const VkPipelineCache pipelineCache, shaderCache *pShaderCache);
+computePipe createParticlePipe(const VkDevice device, const VkDescriptorSetLayout *pDescriptorSetLayout, const VkPipelineCache pipelineCache, shaderCache *pShaderCache);
+void deleteComputePipe(const VkDevice device, computePipe *pPipe);
+shadowAtlasPipe createShadowAtlasPipe(const VkDevice device, const VkRenderPass atlasRenderPass, const VkDescriptorSetLayout *pDescriptorSetLayout, const uint32_t atlasSize, const VkPipelineCache pipelineCache, shaderCache *pShaderCache);
+void deleteShadowAtlasPipe(const VkDevice device, shadowAtlasPipe *pPipe);
+temporalPipe createTemporalPipe(const VkDevice device, const VkRenderPass temporalRenderPass, const VkDescriptorSetLayout *pDescriptorSetLayout, const VkExtent2D extent, const VkPipelineCache pipelineCache, shaderCache *pShaderCache);
+offScreenPipe createOffScreenPipe(const VkDevice device, const VkRenderPass offscreenRenderPass, const VkDescriptorSetLayout *pDescriptorSetLayout, const uint32_t shadowMapResolution, const VkPipelineCache pipelineCache, shaderCache *pShaderCache);
+void deletePipelines(const VkDevice device, pipelines *pPipelines);
 VkViewport configureViewport(const VkExtent2D extent);
 VkRect2D configureScissor(const VkExtent2D extent);
 
+VkCommandPool createCommandPool(const VkDevice device, const uint32_t queueFamilyIndex, const VkCommandPoolCreateFlags flags);
+void deleteCommandPool(const VkDevice device, VkCommandPool *pCommandPool);
+VkCommandBuffer *createCommandBuffers(const VkDevice device, const VkCommandPool commandPool, const VkCommandBufferLevel level, const uint32_t commandBufferNumber);
+void deleteCommandBuffers(const VkDevice device, VkCommandBuffer *commandBuffers, const VkCommandPool commandPool, const uint32_t commandBufferNumber);
+void beginSecondaryCommandBuffer(const VkCommandBuffer commandBuffer, const VkRenderPass renderPass, const VkFramebuffer framebuffer);
 VkCommandBuffer beginSingleTimeCommands(const VkDevice device, const VkCommandPool commandPool);
 void endSingleTimeCommands(const VkDevice device, VkCommandBuffer *pCommandBuffer, const VkCommandPool commandPool, const VkQueue drawingQueue);
 commandAttachment createCommandAttachment(const VkDevice device, const uint32_t queueFamilyIndex, const uint32_t commandBufferNumber);
 void deleteCommandAttachment(const VkDevice device, commandAttachment *pCommand, const uint32_t commandBufferNumber);
+void invalidateCommandBuffers(commandAttachment *pCommand, const uint32_t commandBufferNumber);
+
+jobSystem *createJobSystem(const uint32_t workerNum);
+void deleteJobSystem(jobSystem **ppSystem);
+void runJobs(jobSystem *pSystem, const job *jobs, const uint32_t jobNum);
+void waitForJobs(jobSystem *pSystem, jobCounter *pCounter);
+uint32_t getCpuCount();
+void benchmarkJobSystem();
+
+commandRecorder *createCommandRecorder(const VkDevice device, const uint32_t queueFamilyIndex, const uint32_t slotNum, jobSystem *pJobs, const recordPassFunction record);
+void deleteCommandRecorder(const VkDevice device, commandRecorder **ppRecorder);
+const VkCommandBuffer *recordSecondaryCommandBuffers(commandRecorder *pRecorder, const uint32_t slot);
+
+void initStartupGraph(startupGraph *pGraph);
+uint32_t addStartupTask(startupGraph *pGraph, const char *name, const startupFunction run, void *data, const uint32_t dependencies);
+void runStartupTaskNow(startupGraph *pGraph, const char *name, const startupFunction run, void *data);
+void runStartupGraph(startupGraph *pGraph, const uint32_t threadNum);
+void printStartupTimeline(const startupGraph *pGraph);
+void deleteStartupGraph(startupGraph *pGraph);
+
+latencyRecorder createLatencyRecorder(const uint32_t reportInterval);
+void deleteLatencyRecorder(latencyRecorder *pRecorder);
+void recordFrameTiming(latencyRecorder *pRecorder, const frameTiming timing, const char *label);
+void resetLatencyRecorder(latencyRecorder *pRecorder);
+
+bool getPipelineCachePath(char *path, const size_t size);
+VkPipelineCache loadPipelineCache(const VkDevice device, const VkPhysicalDevice physicalDevice, const char *path);
+void savePipelineCache(const VkDevice device, const VkPipelineCache pipelineCache, const char *path);
+void deletePipelineCache(const VkDevice device, VkPipelineCache *pPipelineCache);
+
+gpuProfiler createGpuProfiler(const VkDevice device, const VkPhysicalDevice physicalDevice, const uint32_t timestampValidBits, const uint32_t frameNum, const char *csvPath);
+void deleteGpuProfiler(const VkDevice device, gpuProfiler *pProfiler);
+void resetGpuTimestamps(const gpuProfiler *pProfiler, const VkCommandBuffer commandBuffer, const uint32_t frame);
+void writeGpuTimestamp(const gpuProfiler *pProfiler, const VkCommandBuffer commandBuffer, const uint32_t frame, const uint32_t pass, const bool end);
+void writeGpuFrameStart(const gpuProfiler *pProfiler, const VkCommandBuffer commandBuffer, const uint32_t frame);
+void markGpuTimestampsSubmitted(gpuProfiler *pProfiler, const uint32_t frame);
+void collectGpuTimestamps(gpuProfiler *pProfiler, const VkDevice device, const uint32_t frame, const uint64_t frameCount);
+gpuPassStats getGpuPassStats(const gpuProfiler *pProfiler, const uint32_t pass);
+void resetGpuProfiler(gpuProfiler *pProfiler);
+
+renderGovernor createRenderGovernor(const double budget, const VkSampleCountFlagBits maxSamples, const uint32_t scale);
+bool updateRenderGovernor(renderGovernor *pGovernor, const double gpuTime, const double cpuTime);
+VkExtent2D getRenderExtent(const renderGovernor *pGovernor, const VkExtent2D outputExtent);
+
+temporalResolve createTemporalResolve(const VkDevice device, const VkPhysicalDevice physicalDevice, const VkExtent2D extent, const uint32_t frameNum, const VkCommandPool commandPool, const VkQueue queue);
+void deleteTemporalResolve(const VkDevice device, temporalResolve *pResolve);
+void createTemporalTargets(const VkDevice device, const VkPhysicalDevice physicalDevice, temporalResolve *pResolve, const VkExtent2D extent, const VkCommandPool commandPool, const VkQueue queue);
+void deleteTemporalTargets(const VkDevice device, temporalResolve *pResolve);
+void updateTemporalDescriptors(const VkDevice device, const temporalResolve *pResolve, const VkImageView colorView, const VkImageView velocityView);
+void nextTemporalJitter(temporalResolve *pResolve, const VkExtent2D renderExtent, float jitter[2]);
+void updateTemporalUniforms(temporalResolve *pResolve, const uint32_t frame, const float jitter[2]);
+void recordTemporalResolve(const VkCommandBuffer commandBuffer, const temporalResolve *pResolve, const temporalPipe *pPipe, const uint32_t frame, const VkImage target, const VkExtent2D targetExtent, const VkImageLayout finalLayout);
+
+headlessTarget createHeadlessTarget(const VkDevice device, const VkPhysicalDevice physicalDevice, const VkExtent2D extent, const VkFormat format, const uint32_t imageNum);
+void deleteHeadlessTarget(const VkDevice device, headlessTarget *pTarget);
+swapchainAttachment getHeadlessSwapchainAttachment(const headlessTarget *pTarget);
+uint8_t *readbackHeadlessImage(const VkDevice device, const VkPhysicalDevice physicalDevice, const VkCommandPool commandPool, const VkQueue queue, const headlessTarget *pTarget, const uint32_t imageIndex);
+bool writeImagePPM(const char *path, const uint8_t *rgb, const uint32_t width, const uint32_t height);
+bool compareGoldenImage(const char *path, const uint8_t *rgb, const uint32_t width, const uint32_t height, const double minPsnr);
+void printHeadlessReport(const double *frameTimes, const uint32_t frameNumber);
 
 syncObjects createSyncObjects(const VkDevice device, const uint32_t maxFrames);
 void deleteSyncObjects(const VkDevice device, syncObjects *pSyncObjects, const uint32_t maxFrames);
 
 //share vulkan file scope variables
     //main thread
+    void enableTemporalUpscaling(const uint32_t scale);
+    void enableAnalyticQuadrics();
+    void enableGpuTessellation();
+    void enableGpuCulling();
+    void enableOcclusionCulling();
+    void enableClusteredLights(const uint32_t lightNum);
+    void enableShadowAtlas(const uint32_t casterNum);
+    void enableSortedDraws();
+    void enableGpuParticles(const uint32_t count);
     void initVulkan(GLFWwindow *pWindow);
-    void recreateSwapChain(GLFWwindow *pWindow, int width, int height);
+    void requestSwapChainRecreation(int width, int height);
     void deleteVulkan();
     //rendering thread
-    void presentImage(const sharedBuffer buffer);
+    bool presentImage(const sharedBuffer buffer);
+    gpuPassStats getGpuPassTimings(const uint32_t pass);
+    void resetGpuPassTimings();
+    //headless, everything on the calling thread
+    void initVulkanHeadless(const VkExtent2D extent);
+    void renderHeadlessFrame(const sharedBuffer buffer);
+    bool finishHeadlessRendering(const char *readbackPath, const char *goldenPath, const double minPsnr);
 
 void testLoop(GLFWwindow *window);
 
+bool findMemoryTypeIndex(const uint32_t typeFilter, const VkMemoryPropertyFlags properties, const VkPhysicalDevice physicalDevice, uint32_t *pIndex);
 uint32_t findMemoryType(const uint32_t typeFilter, const VkMemoryPropertyFlags properties, const VkPhysicalDevice physicalDevice);
+VkBufferandMemory createBuffer(const VkDevice device, const VkPhysicalDevice physicalDevice, const uint32_t bufferSize, const VkBufferUsageFlags usage, const VkMemoryPropertyFlags properties);
 void deleteBuffer(const VkDevice device, VkBufferandMemory *pBufferandMemory);
 mappedBuffer *createSceneUniformBuffers(const VkDevice device, const VkPhysicalDevice physicalDevice, const uint32_t maxFrames);
 mappedBuffer createOffScreenUniformBuffer(const VkDevice device, const VkPhysicalDevice physicalDevice);
+mappedBuffer *createTemporalUniformBuffers(const VkDevice device, const VkPhysicalDevice physicalDevice, const uint32_t maxFrames);
+mappedBuffer createReadbackBuffer(const VkDevice device, const VkPhysicalDevice physicalDevice, const VkDeviceSize size);
 void deleteMappedBuffers(const VkDevice device, mappedBuffer *buffers, const uint32_t bufferNum);
 dynamicBuffers createDynamicBuffers(const VkDevice device, const VkPhysicalDevice physicalDevice, const vec indices, const vec vertices, const VkQueue graphicsQueue, const VkCommandPool commandPool, const uint32_t frameNum);
 void deleteDynamicBuffers(const VkDevice device, dynamicBuffers *pBuffers, const uint32_t frameNum);
-void updateDynamicBuffers(dynamicBuffers *pBuffers, const vec indices, const vec vertices, const VkCommandBuffer commandBuffer, const VkDevice device, const VkPhysicalDevice physicalDevice, const uint32_t currentFrame);
+void updateDynamicBuffers(dynamicBuffers *pBuffers, const vec indices, const vec vertices, const VkDevice device, const VkPhysicalDevice physicalDevice, const uint32_t currentFrame);
+void copyDynamicBuffers(const dynamicBuffers *pBuffers, const vec indices, const vec vertices, const VkCommandBuffer commandBuffer, const uint32_t currentFrame);
+quadricBuffers createQuadricBuffers(const VkDevice device, const VkPhysicalDevice physicalDevice, const vec quadrics, const uint32_t frameNum);
+void deleteQuadricBuffers(const VkDevice device, quadricBuffers *pBuffers, const uint32_t frameNum);
+void updateQuadricBuffers(quadricBuffers *pBuffers, const vec quadrics, const VkDevice device, const VkPhysicalDevice physicalDevice, const uint32_t currentFrame);
+void copyQuadricBuffers(const quadricBuffers *pBuffers, const vec quadrics, const VkCommandBuffer commandBuffer, const uint32_t currentFrame);
 
 VkFormat findDepthFormat(const VkPhysicalDevice physicalDevice);
 VkBool32 formatIsFilterable(const VkPhysicalDevice physicalDevice, const VkFormat format, const VkImageTiling tiling);
@@ -253,4 +920,45 @@ void createEllipsoid(obj3d obj, vec *pVertices, vec *pIndices);
 void createCuboid(obj3d obj, vec *pVertices, vec *pIndices);
 void createEllipticCylinder(obj3d obj, vec *pVertices, vec *pIndices);
 void createPlayerSphere(obj3d obj, vec *pVertices, vec *pIndices);
+void createEllipsoidQuadric(obj3d obj, vec *pQuadrics);
+void createEllipticCylinderQuadric(obj3d obj, vec *pQuadrics);
+
+gpuTessellation createGpuTessellation(const VkDevice device, const VkPhysicalDevice physicalDevice, const uint32_t frameNum, const VkPipelineCache pipelineCache, shaderCache *pShaderCache);
+void deleteGpuTessellation(const VkDevice device, gpuTessellation *pTessellation);
+void updateGpuTessellation(gpuTessellation *pTessellation, const VkDevice device, const VkPhysicalDevice physicalDevice, const uint32_t frame, const vec cuboids, const vec ellipsoids, const vec cylinders);
+void recordGpuTessellation(const VkCommandBuffer commandBuffer, const gpuTessellation *pTessellation, const uint32_t frame);
+
+occlusionCuller createOcclusionCuller();
+void deleteOcclusionCuller(occlusionCuller *pCuller);
+void updateOcclusionCulling(occlusionCuller *pCuller, const float viewProj[4][4], const vec objects[OBJECTSHAPENUM]);
+
+gpuCulling createGpuCulling(const VkDevice device, const VkPhysicalDevice physicalDevice, const gpuTessellation *pTessellation, const VkPipelineCache pipelineCache, shaderCache *pShaderCache);
+void deleteGpuCulling(const VkDevice device, gpuCulling *pCulling);
+void updateGpuCulling(gpuCulling *pCulling, const VkDevice device, const VkPhysicalDevice physicalDevice, const gpuTessellation *pTessellation, const uint32_t frame);
+void updateCullingFrusta(gpuCulling *pCulling, const uint32_t frame, const float viewProj[CULLVIEWNUM][4][4]);
+void recordGpuCulling(const VkCommandBuffer commandBuffer, const gpuCulling *pCulling, const gpuTessellation *pTessellation, const uint32_t frame);
+void drawCulledObjects(const VkCommandBuffer commandBuffer, const gpuCulling *pCulling, const uint32_t frame, const uint32_t view);
+
+lightClusters createLightClusters(const VkDevice device, const VkPhysicalDevice physicalDevice, const uint32_t frameNum, const uint32_t lightNum);
+void deleteLightClusters(const VkDevice device, lightClusters *pClusters);
+void getClusterParams(const VkExtent2D extent, const float near, const float far, float params[4]);
+shadowAtlas createShadowAtlas(const VkDevice device, const VkPhysicalDevice physicalDevice, const VkFormat depthFormat, const uint32_t frameNum, const uint32_t casterNum, const VkCommandPool commandPool, const VkQueue drawingQueue);
+void deleteShadowAtlas(const VkDevice device, shadowAtlas *pAtlas);
+void updateShadowAtlas(shadowAtlas *pAtlas, const uint32_t frame, const pointLight *lights, const float view[4][4], const float proj[4][4], const VkExtent2D extent);
+void updateLightClusters(lightClusters *pClusters, const uint32_t frame, const uint64_t frameIndex, const float view[4][4], const float proj[4][4], const float params[4]);
+
+drawQueue createDrawQueue(const float near, const float far);
+void deleteDrawQueue(drawQueue *pQueue);
+void resetDrawQueue(drawQueue *pQueue);
+void addDraw(drawQueue *pQueue, const uint32_t pass, const drawPipeline pipeline, const uint32_t material, const float depth, const drawCommand command);
+uint64_t *sortDrawKeys(uint64_t *keys, uint64_t *scratch, const uint32_t keyNum);
+void sortDrawQueue(drawQueue *pQueue);
+drawPipeline getDrawKeyPipeline(const uint64_t key);
+drawCommand getSortedDraw(const drawQueue *pQueue, const uint32_t draw);
+void benchmarkDrawSort();
+
+gpuParticles createGpuParticles(const VkDevice device, const VkPhysicalDevice physicalDevice, const uint32_t frameNum, const uint32_t capacity, const VkPipelineCache pipelineCache, shaderCache *pShaderCache);
+void deleteGpuParticles(const VkDevice device, gpuParticles *pParticles);
+void updateGpuParticles(gpuParticles *pParticles, const uint32_t frame, const uint64_t frameIndex, const float dt, const float playerPos[3]);
+void recordGpuParticles(const VkCommandBuffer commandBuffer, const gpuParticles *pParticles, const uint32_t frame);
 #endif
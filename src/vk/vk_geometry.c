@@ -425,3 +425,33 @@ void createPlayerSphere(obj3d obj, vec *pVertices, vec *pIndices){
         }
     }
 }
+
+//rotates the object axes the same way applyRotation turns the tessellated vertices
+static void addQuadric(obj3d obj, const quadricType type, const float radii[3], vec *pQuadrics){
+    quadricInstance quadric = {
+        .center = {obj.pos[0], obj.pos[1], obj.pos[2]},
+        .type = (float)type,
+        .radii = {radii[0], radii[1], radii[2], 0.0f},
+        .color = {obj.color[0], obj.color[1], obj.color[2], 1.0f}
+    };
+    float origin[3] = {0.0f, 0.0f, 0.0f};
+    for(int i = 0; i < 3; i++){
+        float axis[3] = {i == 0, i == 1, i == 2};
+        float unused[3] = {0.0f, 0.0f, 0.0f};
+        applyRotation(axis, unused, obj.rotation, origin);
+        memcpy(quadric.axes[i], axis, sizeof(axis));
+        quadric.axes[i][3] = 0.0f;
+    }
+    vectorAdd(pQuadrics, &quadric);
+}
+
+void createEllipsoidQuadric(obj3d obj, vec *pQuadrics){
+    float radii[3] = {obj.dimension[0] / 2.0f, obj.dimension[1] / 2.0f, obj.dimension[2] / 2.0f};
+    addQuadric(obj, QUADRIC_ELLIPSOID, radii, pQuadrics);
+}
+
+//the cylinder axis is z, like createEllipticCylinder
+void createEllipticCylinderQuadric(obj3d obj, vec *pQuadrics){
+    float radii[3] = {obj.dimension[0] / 2.0f, obj.dimension[1] / 2.0f, obj.dimension[2] / 2.0f};
+    addQuadric(obj, QUADRIC_ELLIPTIC_CYLINDER, radii, pQuadrics);
+}
@@ -0,0 +1,100 @@
+#include "vk_fun.h"
+
+//quality ladder from the top: halve msaa down to 2x, then lower the scale to the minimum, then drop msaa entirely
+static bool stepRenderQualityDown(renderGovernor *pGovernor){
+	if(pGovernor->samples > VK_SAMPLE_COUNT_2_BIT){
+		pGovernor->samples >>= 1;
+	}else if(pGovernor->scale > GOVERNORMINSCALE){
+		pGovernor->scale = pGovernor->scale > GOVERNORMINSCALE + GOVERNORSCALESTEP ? pGovernor->scale - GOVERNORSCALESTEP : GOVERNORMINSCALE;
+	}else if(pGovernor->samples > VK_SAMPLE_COUNT_1_BIT){
+		pGovernor->samples = VK_SAMPLE_COUNT_1_BIT;
+	}else{
+		return false;
+	}
+	return true;
+}
+
+//the exact reverse of stepping down, so every level is reachable from both directions
+static bool stepRenderQualityUp(renderGovernor *pGovernor){
+	if(pGovernor->samples == VK_SAMPLE_COUNT_1_BIT && pGovernor->maxSamples > VK_SAMPLE_COUNT_1_BIT){
+		pGovernor->samples = VK_SAMPLE_COUNT_2_BIT;
+	}else if(pGovernor->scale < 100){
+		pGovernor->scale = pGovernor->scale + GOVERNORSCALESTEP < 100 ? pGovernor->scale + GOVERNORSCALESTEP : 100;
+	}else if(pGovernor->samples < pGovernor->maxSamples){
+		pGovernor->samples <<= 1;
+	}else{
+		return false;
+	}
+	return true;
+}
+
+//budget in milliseconds per frame, 0 keeps maxSamples at the starting scale
+renderGovernor createRenderGovernor(const double budget, const VkSampleCountFlagBits maxSamples, const uint32_t scale){
+	renderGovernor governor = {
+		.budget = budget,
+		.gpuTime = 0.0,
+		.cpuTime = 0.0,
+		.maxSamples = maxSamples,
+		.samples = maxSamples,
+		.scale = scale,
+		.framesSinceStep = 0,
+		.upDelay = GOVERNORCOOLDOWN,
+		.steppedUp = false
+	};
+	if(budget > 0.0){
+		printf("render governor: %.2f ms budget, up to %ux msaa\n", budget, (uint32_t)maxSamples);
+	}
+	return governor;
+}
+
+//call once per frame with the newest gpu frame time and the cpu time spent building the frame, true means the quality changed
+bool updateRenderGovernor(renderGovernor *pGovernor, const double gpuTime, const double cpuTime){
+	if(pGovernor->budget <= 0.0 || gpuTime <= 0.0){
+		return false;
+	}
+	//averages restart after every step so the new level is judged on its own frames
+	if(pGovernor->framesSinceStep == 0){
+		pGovernor->gpuTime = gpuTime;
+		pGovernor->cpuTime = cpuTime;
+	}else{
+		pGovernor->gpuTime += (gpuTime - pGovernor->gpuTime) * GOVERNORSMOOTHING;
+		pGovernor->cpuTime += (cpuTime - pGovernor->cpuTime) * GOVERNORSMOOTHING;
+	}
+	pGovernor->framesSinceStep++;
+	if(pGovernor->framesSinceStep < GOVERNORCOOLDOWN){
+		return false;
+	}
+
+	//lowering gpu work does not help once the cpu is the slower side
+	if(pGovernor->gpuTime > pGovernor->budget * GOVERNOROVERLOAD && pGovernor->gpuTime >= pGovernor->cpuTime){
+		if(!stepRenderQualityDown(pGovernor)){
+			return false;
+		}
+		//a step up that did not fit the budget makes the next attempt wait longer
+		if(pGovernor->steppedUp && pGovernor->upDelay < GOVERNORMAXUPDELAY){
+			pGovernor->upDelay *= 2;
+		}
+		pGovernor->steppedUp = false;
+	}else if(pGovernor->gpuTime < pGovernor->budget * GOVERNORHEADROOM && pGovernor->framesSinceStep >= pGovernor->upDelay){
+		if(!stepRenderQualityUp(pGovernor)){
+			return false;
+		}
+		pGovernor->steppedUp = true;
+	}else{
+		return false;
+	}
+
+	printf("render quality: %ux msaa, %u%% scale (gpu %.2f ms, cpu %.2f ms, budget %.2f ms)\n", (uint32_t)pGovernor->samples, pGovernor->scale, pGovernor->gpuTime, pGovernor->cpuTime, pGovernor->budget);
+	pGovernor->framesSinceStep = 0;
+	return true;
+}
+
+VkExtent2D getRenderExtent(const renderGovernor *pGovernor, const VkExtent2D outputExtent){
+	VkExtent2D extent = {
+		outputExtent.width * pGovernor->scale / 100,
+		outputExtent.height * pGovernor->scale / 100
+	};
+	extent.width = extent.width > 0 ? extent.width : 1;
+	extent.height = extent.height > 0 ? extent.height : 1;
+	return extent;
+}
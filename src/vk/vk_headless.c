@@ -0,0 +1,178 @@
+#include "vk_fun.h"
+
+//offscreen images standing in for the swapchain, the scene is blitted into them like into swapchain images
+headlessTarget createHeadlessTarget(const VkDevice device, const VkPhysicalDevice physicalDevice, const VkExtent2D extent, const VkFormat format, const uint32_t imageNum){
+	headlessTarget target;
+	target.extent = extent;
+	target.format = format;
+	target.imageNum = imageNum;
+	target.attachments = malloc(imageNum * sizeof(frameBufferAttachment));
+	target.images = malloc(imageNum * sizeof(VkImage));
+	target.views = malloc(imageNum * sizeof(VkImageView));
+	for(uint32_t i = 0; i < imageNum; i++){
+		target.attachments[i] = createFrameBufferAttachment(device, physicalDevice, extent.width, extent.height, format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_ASPECT_COLOR_BIT, 1, 0, VK_IMAGE_VIEW_TYPE_2D);
+		target.images[i] = target.attachments[i].image.image;
+		target.views[i] = target.attachments[i].view;
+	}
+	return target;
+}
+
+void deleteHeadlessTarget(const VkDevice device, headlessTarget *pTarget){
+	for(uint32_t i = 0; i < pTarget->imageNum; i++){
+		deleteFrameBufferAttachment(device, &pTarget->attachments[i]);
+	}
+	free(pTarget->attachments);
+	free(pTarget->images);
+	free(pTarget->views);
+}
+
+//the arrays stay owned by the target, delete the target instead of the attachment
+swapchainAttachment getHeadlessSwapchainAttachment(const headlessTarget *pTarget){
+	swapchainAttachment attachment = {
+		.images = pTarget->images,
+		.imageViews = pTarget->views,
+		.imageNum = pTarget->imageNum,
+		.swapchain = VK_NULL_HANDLE,
+		.extent = pTarget->extent,
+		.surfaceFormat = {pTarget->format, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR},
+		.presentMode = VK_PRESENT_MODE_FIFO_KHR
+	};
+	return attachment;
+}
+
+//the image has to be in TRANSFER_SRC_OPTIMAL, which is where the upscale blit leaves it
+uint8_t *readbackHeadlessImage(const VkDevice device, const VkPhysicalDevice physicalDevice, const VkCommandPool commandPool, const VkQueue queue, const headlessTarget *pTarget, const uint32_t imageIndex){
+	const uint32_t width = pTarget->extent.width, height = pTarget->extent.height;
+	const VkDeviceSize size = (VkDeviceSize)width * height * 4;
+	mappedBuffer readback = createReadbackBuffer(device, physicalDevice, size);
+
+	VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
+	VkImageMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.pNext = VK_NULL_HANDLE,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+		.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = pTarget->images[imageIndex],
+		.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}
+	};
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 1, &barrier);
+	VkBufferImageCopy region = {
+		.bufferOffset = 0,
+		.bufferRowLength = 0,
+		.bufferImageHeight = 0,
+		.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+		.imageOffset = {0, 0, 0},
+		.imageExtent = {width, height, 1}
+	};
+	vkCmdCopyImageToBuffer(commandBuffer, pTarget->images[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer.buffer, 1, &region);
+	endSingleTimeCommands(device, &commandBuffer, commandPool, queue);
+
+	//tightly packed rgb, ready to be written as a binary ppm
+	uint8_t *rgb = malloc((size_t)width * height * 3);
+	const uint8_t *rgba = readback.pMappedData;
+	for(size_t i = 0; i < (size_t)width * height; i++){
+		rgb[i * 3 + 0] = rgba[i * 4 + 0];
+		rgb[i * 3 + 1] = rgba[i * 4 + 1];
+		rgb[i * 3 + 2] = rgba[i * 4 + 2];
+	}
+	vkUnmapMemory(device, readback.buffer.memory);
+	deleteBuffer(device, &readback.buffer);
+	return rgb;
+}
+
+bool writeImagePPM(const char *path, const uint8_t *rgb, const uint32_t width, const uint32_t height){
+	FILE *fp = fopen(path, "wb");
+	if(fp == NULL){
+		printf("failed to open %s for writing\n", path);
+		return false;
+	}
+	fprintf(fp, "P6\n%u %u\n255\n", width, height);
+	bool written = fwrite(rgb, 3, (size_t)width * height, fp) == (size_t)width * height;
+	fclose(fp);
+	return written;
+}
+
+static uint8_t *readImagePPM(const char *path, uint32_t *pWidth, uint32_t *pHeight){
+	FILE *fp = fopen(path, "rb");
+	if(fp == NULL){
+		return NULL;
+	}
+	unsigned int width = 0, height = 0, maxValue = 0;
+	if(fscanf(fp, "P6 %u %u %u", &width, &height, &maxValue) != 3 || maxValue != 255 || fgetc(fp) == EOF){
+		fclose(fp);
+		return NULL;
+	}
+	uint8_t *rgb = malloc((size_t)width * height * 3);
+	if(fread(rgb, 3, (size_t)width * height, fp) != (size_t)width * height){
+		free(rgb);
+		fclose(fp);
+		return NULL;
+	}
+	fclose(fp);
+	*pWidth = width;
+	*pHeight = height;
+	return rgb;
+}
+
+//drivers round differently, so a few channels may be off by more than the per channel tolerance
+//a positive minPsnr judges by peak signal to noise ratio instead, for images that only approximate the golden one
+bool compareGoldenImage(const char *path, const uint8_t *rgb, const uint32_t width, const uint32_t height, const double minPsnr){
+	uint32_t goldenWidth = 0, goldenHeight = 0;
+	uint8_t *golden = readImagePPM(path, &goldenWidth, &goldenHeight);
+	if(golden == NULL){
+		printf("failed to read golden image %s\n", path);
+		return false;
+	}
+	if(goldenWidth != width || goldenHeight != height){
+		printf("golden image is %ux%u, rendered %ux%u\n", goldenWidth, goldenHeight, width, height);
+		free(golden);
+		return false;
+	}
+	const size_t channelNum = (size_t)width * height * 3;
+	size_t mismatches = 0;
+	int maxDifference = 0;
+	double squaredError = 0.0;
+	for(size_t i = 0; i < channelNum; i++){
+		int difference = abs((int)rgb[i] - (int)golden[i]);
+		squaredError += (double)difference * difference;
+		if(difference > HEADLESSCHANNELTOLERANCE){
+			mismatches++;
+		}
+		if(difference > maxDifference){
+			maxDifference = difference;
+		}
+	}
+	free(golden);
+	double mismatchRatio = (double)mismatches / channelNum;
+	//identical images are reported as 99 dB
+	double meanSquaredError = squaredError / channelNum;
+	double psnr = meanSquaredError > 0.0 ? 10.0 * log10(255.0 * 255.0 / meanSquaredError) : 99.0;
+	bool match = minPsnr > 0.0 ? psnr >= minPsnr : mismatchRatio <= HEADLESSMISMATCHRATIO;
+	printf("golden comparison: %s, %.4f%% channels off by more than %d, max difference %d, psnr %.2f dB\n", match ? "match" : "MISMATCH", mismatchRatio * 100.0, HEADLESSCHANNELTOLERANCE, maxDifference, psnr);
+	return match;
+}
+
+static int compareDoubles(const void *a, const void *b){
+	const double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+void printHeadlessReport(const double *frameTimes, const uint32_t frameNumber){
+	if(frameNumber == 0){
+		return;
+	}
+	double *sorted = malloc(frameNumber * sizeof(double));
+	double sum = 0.0;
+	for(uint32_t i = 0; i < frameNumber; i++){
+		sorted[i] = frameTimes[i];
+		sum += frameTimes[i];
+	}
+	qsort(sorted, frameNumber, sizeof(double), compareDoubles);
+	double avg = sum / frameNumber;
+	printf("headless: %u frames, frame time min %.3f avg %.3f p99 %.3f max %.3f ms, %.1f fps\n", frameNumber, sorted[0], avg, sorted[(uint32_t)(0.99 * (frameNumber - 1))], sorted[frameNumber - 1], avg > 0.0 ? 1000.0 / avg : 0.0);
+	free(sorted);
+}
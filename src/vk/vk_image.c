@@ -67,10 +67,15 @@ static VkImageandMemory createImage(const VkDevice device, const VkPhysicalDevic
     VkMemoryRequirements memRequirements;
     vkGetImageMemoryRequirements(device, imageandMemory.image, &memRequirements);
 
+    //lazily allocated memory only exists on tile based gpus, elsewhere transient attachments get regular device memory
+    uint32_t memoryTypeIndex;
+    if(!findMemoryTypeIndex(memRequirements.memoryTypeBits, properties, physicalDevice, &memoryTypeIndex)){
+        memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties & ~VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, physicalDevice);
+    }
     VkMemoryAllocateInfo allocInfo = {
         .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
         .allocationSize = memRequirements.size,
-        .memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties, physicalDevice)
+        .memoryTypeIndex = memoryTypeIndex
     };
 
     result = vkAllocateMemory(device, &allocInfo, VK_NULL_HANDLE, &imageandMemory.memory);
@@ -311,4 +316,34 @@ bool hasStencilComponent(VkFormat format) {
 //    return imageandMemory;
 //}
 
+//source has to be in TRANSFER_SRC_OPTIMAL, the target's old contents are discarded and it ends in finalLayout
+void recordImageBlit(const VkCommandBuffer commandBuffer, const VkImage source, const VkExtent2D sourceExtent, const VkFilter filter, const VkImage target, const VkExtent2D targetExtent, const VkImageLayout finalLayout){
+	VkImageMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.pNext = VK_NULL_HANDLE,
+		.srcAccessMask = 0,
+		.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+		.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = target,
+		.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}
+	};
+	//the acquire semaphore is waited on at the transfer stage
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 1, &barrier);
+
+	VkImageBlit region = {
+		.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+		.srcOffsets = {{0, 0, 0}, {(int32_t)sourceExtent.width, (int32_t)sourceExtent.height, 1}},
+		.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+		.dstOffsets = {{0, 0, 0}, {(int32_t)targetExtent.width, (int32_t)targetExtent.height, 1}}
+	};
+	vkCmdBlitImage(commandBuffer, source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, filter);
 
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = 0;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = finalLayout;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 1, &barrier);
+}
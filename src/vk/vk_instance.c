@@ -1,6 +1,22 @@
 #include "vk_fun.h"
 
-VkInstance createInstance(){
+static bool isLayerAvailable(const char *layerName){
+	uint32_t layerNumber = 0;
+	vkEnumerateInstanceLayerProperties(&layerNumber, VK_NULL_HANDLE);
+	VkLayerProperties *layerProperties = malloc(layerNumber * sizeof(VkLayerProperties));
+	vkEnumerateInstanceLayerProperties(&layerNumber, layerProperties);
+	bool available = false;
+	for(uint32_t i = 0; i < layerNumber; i++){
+		if(strcmp(layerProperties[i].layerName, layerName) == 0){
+			available = true;
+		}
+	}
+	free(layerProperties);
+	return available;
+}
+
+//headless instances have no surface, so neither glfw nor the surface extensions are needed
+VkInstance createInstance(const bool headless){
 	VkApplicationInfo applicationInfo = {
 		VK_STRUCTURE_TYPE_APPLICATION_INFO,
 		VK_NULL_HANDLE,
@@ -18,10 +34,11 @@ VkInstance createInstance(){
 		layerList[0]
 	};
 
-    uint32_t layerCount = sizeof(layers) / sizeof(layers[0]);
+    //render nodes and ci boxes often come without the sdk layers
+    uint32_t layerCount = isLayerAvailable(layers[0]) ? sizeof(layers) / sizeof(layers[0]) : 0;
 
     uint32_t glfwExtensionCount = 0;
-    const char **glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    const char **glfwExtensions = headless ? VK_NULL_HANDLE : glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
     // Additional extensions you want to enable
     const char *additionalExtensions[] = {
@@ -29,7 +46,7 @@ VkInstance createInstance(){
 		VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME,
 		VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME
     };
-    uint32_t additionalExtensionCount = sizeof(additionalExtensions) / sizeof(additionalExtensions[0]);
+    uint32_t additionalExtensionCount = headless ? 0 : sizeof(additionalExtensions) / sizeof(additionalExtensions[0]);
 
     // Combine GLFW extensions and additional extensions
     uint32_t totalExtensionCount = glfwExtensionCount + additionalExtensionCount;
@@ -0,0 +1,333 @@
+#include "vk_fun.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+static _Thread_local jobWorker *pCurrentWorker = NULL; // the pool worker running on this thread, if any
+static _Thread_local uint32_t stealSeed = 2463534242u; // xorshift state picking the first victim
+
+uint32_t getCpuCount(){
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (uint32_t)info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (uint32_t)count : 1;
+#endif
+}
+
+//owner only, false when the deque is full
+static bool pushJob(jobWorker *pWorker, const job work){
+	const int64_t bottom = atomic_load_explicit(&pWorker->bottom, memory_order_relaxed);
+	const int64_t top = atomic_load_explicit(&pWorker->top, memory_order_acquire);
+	if(bottom - top >= JOBQUEUESIZE){
+		return false;
+	}
+	pWorker->deque[bottom & (JOBQUEUESIZE - 1)] = work;
+	atomic_store_explicit(&pWorker->bottom, bottom + 1, memory_order_release);
+	return true;
+}
+
+//owner only, newest job first so nested work stays in the cache
+static bool popJob(jobWorker *pWorker, job *pJob){
+	const int64_t bottom = atomic_load_explicit(&pWorker->bottom, memory_order_relaxed) - 1;
+	atomic_store_explicit(&pWorker->bottom, bottom, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+	int64_t top = atomic_load_explicit(&pWorker->top, memory_order_relaxed);
+	if(top > bottom){
+		atomic_store_explicit(&pWorker->bottom, bottom + 1, memory_order_relaxed);
+		return false;
+	}
+	*pJob = pWorker->deque[bottom & (JOBQUEUESIZE - 1)];
+	if(top == bottom){
+		//the last job, a thief may be taking it at the same time
+		const bool won = atomic_compare_exchange_strong_explicit(&pWorker->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed);
+		atomic_store_explicit(&pWorker->bottom, bottom + 1, memory_order_relaxed);
+		return won;
+	}
+	return true;
+}
+
+//any thread, oldest job first, the compare and swap on top is the only synchronization with the owner
+static bool stealJob(jobWorker *pVictim, job *pJob){
+	int64_t top = atomic_load_explicit(&pVictim->top, memory_order_acquire);
+	atomic_thread_fence(memory_order_seq_cst);
+	const int64_t bottom = atomic_load_explicit(&pVictim->bottom, memory_order_acquire);
+	if(top >= bottom){
+		return false;
+	}
+	const job work = pVictim->deque[top & (JOBQUEUESIZE - 1)];
+	if(!atomic_compare_exchange_strong_explicit(&pVictim->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed)){
+		return false;
+	}
+	*pJob = work;
+	return true;
+}
+
+static bool takeInjectedJob(jobSystem *pSystem, job *pJob){
+	if(atomic_load(&pSystem->injectedNum) == 0){
+		return false;
+	}
+	bool taken = false;
+	cthreads_mutex_lock(&pSystem->mutex);
+	if(pSystem->injectedFirst < (uint32_t)pSystem->injected.n){
+		*pJob = ((job *)pSystem->injected.array)[pSystem->injectedFirst++];
+		if(pSystem->injectedFirst == (uint32_t)pSystem->injected.n){
+			pSystem->injectedFirst = 0;
+			pSystem->injected.n = 0;
+		}
+		atomic_fetch_sub(&pSystem->injectedNum, 1);
+		taken = true;
+	}
+	cthreads_mutex_unlock(&pSystem->mutex);
+	return taken;
+}
+
+//own deque, then jobs from outside the pool, then every other deque starting at a random one
+static bool findJob(jobSystem *pSystem, jobWorker *pSelf, job *pJob){
+	if(pSelf != NULL && popJob(pSelf, pJob)){
+		return true;
+	}
+	if(takeInjectedJob(pSystem, pJob)){
+		return true;
+	}
+	if(pSystem->workerNum == 0){
+		return false;
+	}
+	stealSeed ^= stealSeed << 13;
+	stealSeed ^= stealSeed >> 17;
+	stealSeed ^= stealSeed << 5;
+	for(uint32_t i = 0; i < pSystem->workerNum; i++){
+		jobWorker *pVictim = &pSystem->workers[(stealSeed + i) % pSystem->workerNum];
+		if(pVictim != pSelf && stealJob(pVictim, pJob)){
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool hasWork(jobSystem *pSystem){
+	if(atomic_load(&pSystem->injectedNum) > 0){
+		return true;
+	}
+	for(uint32_t i = 0; i < pSystem->workerNum; i++){
+		if(atomic_load(&pSystem->workers[i].bottom) > atomic_load(&pSystem->workers[i].top)){
+			return true;
+		}
+	}
+	return false;
+}
+
+//sleepers count themselves under the mutex before checking for work, so a waker that reads zero raced with nobody
+static void wakeSleepers(jobSystem *pSystem){
+	atomic_thread_fence(memory_order_seq_cst);
+	if(atomic_load(&pSystem->sleeping) > 0){
+		cthreads_mutex_lock(&pSystem->mutex);
+		cthreads_cond_broadcast(&pSystem->wake);
+		cthreads_mutex_unlock(&pSystem->mutex);
+	}
+}
+
+//until there is work, the counter is done or the pool stops
+static void sleepForWork(jobSystem *pSystem, jobCounter *pCounter){
+	cthreads_mutex_lock(&pSystem->mutex);
+	atomic_fetch_add(&pSystem->sleeping, 1);
+	while(atomic_load(&pSystem->running) && !hasWork(pSystem) && (pCounter == NULL || atomic_load(&pCounter->pending) > 0)){
+		cthreads_cond_wait(&pSystem->wake, &pSystem->mutex);
+	}
+	atomic_fetch_sub(&pSystem->sleeping, 1);
+	cthreads_mutex_unlock(&pSystem->mutex);
+}
+
+static void runJob(jobSystem *pSystem, const job work){
+	work.run(work.data);
+	if(work.pCounter != NULL && atomic_fetch_sub(&work.pCounter->pending, 1) == 1){
+		wakeSleepers(pSystem);
+	}
+}
+
+static void *jobWorkerThread(void *arg){
+	jobWorker *pWorker = (jobWorker *)arg;
+	jobSystem *pSystem = pWorker->pSystem;
+	pCurrentWorker = pWorker;
+	stealSeed += pWorker->index * 2654435761u;
+	uint32_t spins = 0;
+	while(atomic_load(&pSystem->running)){
+		job work;
+		if(findJob(pSystem, pWorker, &work)){
+			runJob(pSystem, work);
+			spins = 0;
+		}else if(++spins >= JOBSPINNUM){
+			sleepForWork(pSystem, NULL);
+			spins = 0;
+		}
+	}
+	return NULL;
+}
+
+//zero workers is valid, the jobs then run on the threads waiting for them
+jobSystem *createJobSystem(const uint32_t workerNum){
+	if(workerNum > JOBWORKERMAX){
+		printf("invalid number of job workers: %u\n", workerNum);
+		exit(EXIT_FAILURE);
+	}
+	jobSystem *pSystem = malloc(sizeof(jobSystem));
+	pSystem->workerNum = workerNum;
+	pSystem->injectedFirst = 0;
+	initVector(&pSystem->injected, sizeof(job), 64, 64);
+	atomic_init(&pSystem->injectedNum, 0);
+	atomic_init(&pSystem->sleeping, 0);
+	atomic_init(&pSystem->running, true);
+	cthreads_mutex_init(&pSystem->mutex, NULL);
+	cthreads_cond_init(&pSystem->wake, NULL);
+
+	pSystem->workers = malloc((workerNum > 0 ? workerNum : 1) * sizeof(jobWorker));
+	for(uint32_t i = 0; i < workerNum; i++){
+		jobWorker *pWorker = &pSystem->workers[i];
+		pWorker->pSystem = pSystem;
+		pWorker->deque = malloc(JOBQUEUESIZE * sizeof(job));
+		atomic_init(&pWorker->top, 0);
+		atomic_init(&pWorker->bottom, 0);
+		pWorker->index = i;
+	}
+	//every deque exists before any thread can steal from it
+	for(uint32_t i = 0; i < workerNum; i++){
+		jobWorker *pWorker = &pSystem->workers[i];
+		if(cthreads_thread_create(&pWorker->thread, NULL, jobWorkerThread, pWorker, &pWorker->args) != 0){
+			printf("failed to create job worker %u\n", i);
+			exit(EXIT_FAILURE);
+		}
+	}
+	return pSystem;
+}
+
+//jobs still queued are dropped, wait for their counters first
+void deleteJobSystem(jobSystem **ppSystem){
+	jobSystem *pSystem = *ppSystem;
+	cthreads_mutex_lock(&pSystem->mutex);
+	atomic_store(&pSystem->running, false);
+	cthreads_cond_broadcast(&pSystem->wake);
+	cthreads_mutex_unlock(&pSystem->mutex);
+	for(uint32_t i = 0; i < pSystem->workerNum; i++){
+		cthreads_thread_join(pSystem->workers[i].thread, NULL);
+		free(pSystem->workers[i].deque);
+	}
+	free(pSystem->workers);
+	deleteVector(&pSystem->injected);
+	cthreads_mutex_destroy(&pSystem->mutex);
+	cthreads_cond_destroy(&pSystem->wake);
+	free(pSystem);
+	*ppSystem = NULL;
+}
+
+//workers push to their own deque, any other thread hands the jobs to the pool through the mutex
+void runJobs(jobSystem *pSystem, const job *jobs, const uint32_t jobNum){
+	for(uint32_t i = 0; i < jobNum; i++){
+		if(jobs[i].pCounter != NULL){
+			atomic_fetch_add(&jobs[i].pCounter->pending, 1);
+		}
+	}
+	jobWorker *pSelf = pCurrentWorker != NULL && pCurrentWorker->pSystem == pSystem ? pCurrentWorker : NULL;
+	if(pSelf != NULL){
+		for(uint32_t i = 0; i < jobNum; i++){
+			if(!pushJob(pSelf, jobs[i])){
+				runJob(pSystem, jobs[i]);
+			}
+		}
+	}else{
+		cthreads_mutex_lock(&pSystem->mutex);
+		for(uint32_t i = 0; i < jobNum; i++){
+			vectorAdd(&pSystem->injected, (void *)&jobs[i]);
+		}
+		atomic_fetch_add(&pSystem->injectedNum, jobNum);
+		cthreads_mutex_unlock(&pSystem->mutex);
+	}
+	wakeSleepers(pSystem);
+}
+
+//runs queued jobs, any of them, until the counter's jobs are done, so waiting inside a job never idles a worker
+void waitForJobs(jobSystem *pSystem, jobCounter *pCounter){
+	jobWorker *pSelf = pCurrentWorker != NULL && pCurrentWorker->pSystem == pSystem ? pCurrentWorker : NULL;
+	while(atomic_load(&pCounter->pending) > 0){
+		job work;
+		if(findJob(pSystem, pSelf, &work)){
+			runJob(pSystem, work);
+		}else{
+			sleepForWork(pSystem, pCounter);
+		}
+	}
+}
+
+typedef struct BenchmarkParent {
+	jobSystem *pSystem;
+	float *results; // JOBBENCHMARKCHILDREN seeds in, results out
+} benchmarkParent;
+
+static void benchmarkChild(void *data){
+	float *pValue = (float *)data;
+	float x = *pValue;
+	for(uint32_t i = 0; i < JOBBENCHMARKWORK; i++){
+		x = x * 0.999f + sinf(x) * 0.01f;
+	}
+	*pValue = x;
+}
+
+//spawns its children from inside a job and waits for them, which is what makes the workers steal
+static void benchmarkParentJob(void *data){
+	benchmarkParent *pParent = (benchmarkParent *)data;
+	jobCounter counter;
+	atomic_init(&counter.pending, 0);
+	job children[JOBBENCHMARKCHILDREN];
+	for(uint32_t i = 0; i < JOBBENCHMARKCHILDREN; i++){
+		children[i] = (job){benchmarkChild, &pParent->results[i], &counter};
+	}
+	runJobs(pParent->pSystem, children, JOBBENCHMARKCHILDREN);
+	waitForJobs(pParent->pSystem, &counter);
+}
+
+static double runJobBenchmark(jobSystem *pSystem, float *results){
+	benchmarkParent parents[JOBBENCHMARKPARENTS];
+	job jobs[JOBBENCHMARKPARENTS];
+	jobCounter counter;
+	atomic_init(&counter.pending, 0);
+	for(uint32_t i = 0; i < JOBBENCHMARKPARENTS * JOBBENCHMARKCHILDREN; i++){
+		results[i] = (float)(i % 97) * 0.01f;
+	}
+	for(uint32_t i = 0; i < JOBBENCHMARKPARENTS; i++){
+		parents[i] = (benchmarkParent){pSystem, &results[i * JOBBENCHMARKCHILDREN]};
+		jobs[i] = (job){benchmarkParentJob, &parents[i], &counter};
+	}
+	tick_t start = timer_current();
+	runJobs(pSystem, jobs, JOBBENCHMARKPARENTS);
+	waitForJobs(pSystem, &counter);
+	return timer_ticks_to_seconds(timer_elapsed_ticks(start)) * 1000.0;
+}
+
+//the same nested workload from one thread up to one per cpu, the calling thread helps and counts as one
+void benchmarkJobSystem(){
+	const uint32_t threadMax = getCpuCount() < JOBWORKERMAX + 1 ? getCpuCount() : JOBWORKERMAX + 1;
+	const uint32_t resultNum = JOBBENCHMARKPARENTS * JOBBENCHMARKCHILDREN;
+	float *reference = malloc(resultNum * sizeof(float));
+	float *results = malloc(resultNum * sizeof(float));
+	double singleTime = 0.0;
+	for(uint32_t threads = 1; threads <= threadMax; threads++){
+		jobSystem *pSystem = createJobSystem(threads - 1);
+		double time = 0.0;
+		for(uint32_t run = 0; run < JOBBENCHMARKRUNS; run++){
+			time += runJobBenchmark(pSystem, threads == 1 ? reference : results);
+		}
+		deleteJobSystem(&pSystem);
+		time /= JOBBENCHMARKRUNS;
+		if(threads == 1){
+			singleTime = time;
+		}
+		const bool match = threads == 1 || memcmp(results, reference, resultNum * sizeof(float)) == 0;
+		printf("job system with %2u threads: %8.3f ms, %5.2fx speedup, %3.0f%% efficiency, %s\n",
+			threads, time, singleTime / time, singleTime / time / threads * 100.0, match ? "same results" : "RESULT MISMATCH");
+	}
+	free(reference);
+	free(results);
+}
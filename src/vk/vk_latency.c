@@ -0,0 +1,65 @@
+#include "vk_fun.h"
+
+static double ticksToMilliseconds(const tick_t start, const tick_t end){
+	if(end <= start){
+		return 0.0;
+	}
+	return (double)timer_ticks_to_seconds(end - start) * 1000.0;
+}
+
+static int compareDoubles(const void *a, const void *b){
+	const double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+static void printLatencyReport(const latencyRecorder *pRecorder, const char *label){
+	const uint32_t n = pRecorder->frameNum;
+	double *total = malloc(n * sizeof(double));
+	double pollToStart = 0.0, startToAcquire = 0.0, acquireToSubmit = 0.0, submitToPresent = 0.0, sum = 0.0;
+	for(uint32_t i = 0; i < n; i++){
+		const frameTiming *pFrame = &pRecorder->frames[i];
+		pollToStart += ticksToMilliseconds(pFrame->poll, pFrame->start);
+		startToAcquire += ticksToMilliseconds(pFrame->start, pFrame->acquired);
+		acquireToSubmit += ticksToMilliseconds(pFrame->acquired, pFrame->submitted);
+		submitToPresent += ticksToMilliseconds(pFrame->submitted, pFrame->presented);
+		total[i] = ticksToMilliseconds(pFrame->poll, pFrame->presented);
+		sum += total[i];
+	}
+	qsort(total, n, sizeof(double), compareDoubles);
+	uint32_t p99 = (uint32_t)(0.99 * (n - 1));
+	printf("latency %s, %u frames (ms): poll->present min %.3f avg %.3f p99 %.3f max %.3f | poll->render %.3f, render->acquire %.3f, acquire->submit %.3f, submit->present %.3f\n",
+		label, n, total[0], sum / n, total[p99], total[n - 1],
+		pollToStart / n, startToAcquire / n, acquireToSubmit / n, submitToPresent / n);
+	free(total);
+}
+
+latencyRecorder createLatencyRecorder(const uint32_t reportInterval){
+	latencyRecorder recorder;
+	recorder.frames = malloc(reportInterval * sizeof(frameTiming));
+	recorder.frameNum = 0;
+	recorder.reportInterval = reportInterval;
+	return recorder;
+}
+
+void deleteLatencyRecorder(latencyRecorder *pRecorder){
+	free(pRecorder->frames);
+	pRecorder->frames = NULL;
+}
+
+//prints a report and starts a new window every reportInterval frames
+void recordFrameTiming(latencyRecorder *pRecorder, const frameTiming timing, const char *label){
+	//the first frames after startup have no poll timestamp yet
+	if(timing.poll == 0){
+		return;
+	}
+	pRecorder->frames[pRecorder->frameNum++] = timing;
+	if(pRecorder->frameNum == pRecorder->reportInterval){
+		printLatencyReport(pRecorder, label);
+		pRecorder->frameNum = 0;
+	}
+}
+
+//drop a partially filled window, e.g. after the present mode changed
+void resetLatencyRecorder(latencyRecorder *pRecorder){
+	pRecorder->frameNum = 0;
+}
@@ -0,0 +1,302 @@
+#include "vk_fun.h"
+
+#define OCCLUSIONNEARW 0.01f // clip w below which a box is treated as crossing the camera plane
+
+static uint32_t levelWidth(const uint32_t level){
+	return HIZWIDTH >> level > 0 ? HIZWIDTH >> level : 1;
+}
+
+static uint32_t levelHeight(const uint32_t level){
+	return HIZHEIGHT >> level > 0 ? HIZHEIGHT >> level : 1;
+}
+
+static depthPyramid createDepthPyramid(){
+	depthPyramid pyramid;
+	uint32_t size = 0;
+	for(uint32_t level = 0; level < HIZLEVELNUM; level++){
+		pyramid.offsets[level] = size;
+		size += levelWidth(level) * levelHeight(level);
+	}
+	pyramid.depth = malloc(size * sizeof(float));
+	pyramid.valid = false;
+	return pyramid;
+}
+
+occlusionCuller createOcclusionCuller(){
+	occlusionCuller culler;
+	culler.current = createDepthPyramid();
+	culler.history = createDepthPyramid();
+	culler.coverage = malloc(HIZWIDTH * HIZHEIGHT * sizeof(float));
+	culler.capacity = 64;
+	culler.visible = malloc(culler.capacity * sizeof(bool));
+	culler.stats = (occlusionStats){0, 0, 0};
+	culler.framesSinceReport = 0;
+	printf("occlusion culling: %ux%u depth pyramid, occluders from %.2f units\n", HIZWIDTH, HIZHEIGHT, OCCLUDERMINSIZE);
+	return culler;
+}
+
+void deleteOcclusionCuller(occlusionCuller *pCuller){
+	free(pCuller->current.depth);
+	free(pCuller->history.depth);
+	free(pCuller->coverage);
+	free(pCuller->visible);
+}
+
+//the cpu applyRotation, x first, then y, then z
+static void rotate(float v[3], const float rotation[3]){
+	float c = cosf(rotation[0]), s = sinf(rotation[0]);
+	float y = v[1] * c - v[2] * s, z = v[1] * s + v[2] * c;
+	v[1] = y; v[2] = z;
+	c = cosf(rotation[1]); s = sinf(rotation[1]);
+	float x = v[0] * c + v[2] * s;
+	z = -v[0] * s + v[2] * c;
+	v[0] = x; v[2] = z;
+	c = cosf(rotation[2]); s = sinf(rotation[2]);
+	x = v[0] * c - v[1] * s;
+	y = v[0] * s + v[1] * c;
+	v[0] = x; v[1] = y;
+}
+
+//to level 0 texel coordinates and depth, false if the point is not in front of the camera
+static bool projectPoint(const float viewProj[4][4], const float p[3], float screen[3]){
+	float clip[4];
+	for(uint32_t row = 0; row < 4; row++){
+		clip[row] = viewProj[0][row] * p[0] + viewProj[1][row] * p[1] + viewProj[2][row] * p[2] + viewProj[3][row];
+	}
+	if(clip[3] < OCCLUSIONNEARW){
+		return false;
+	}
+	screen[0] = (clip[0] / clip[3] * 0.5f + 0.5f) * HIZWIDTH;
+	screen[1] = (clip[1] / clip[3] * 0.5f + 0.5f) * HIZHEIGHT;
+	screen[2] = clip[2] / clip[3];
+	return true;
+}
+
+//texels whose center is covered keep the nearest depth, depth is affine in screen space
+static void rasterizeTriangle(float *coverage, const float a[3], const float b[3], const float c[3]){
+	const float area = (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+	if(area == 0.0f){
+		return;
+	}
+	const float minX = fminf(a[0], fminf(b[0], c[0])), maxX = fmaxf(a[0], fmaxf(b[0], c[0]));
+	const float minY = fminf(a[1], fminf(b[1], c[1])), maxY = fmaxf(a[1], fmaxf(b[1], c[1]));
+	const int x0 = minX < 0.0f ? 0 : (int)minX, x1 = maxX >= HIZWIDTH ? HIZWIDTH - 1 : (int)maxX;
+	const int y0 = minY < 0.0f ? 0 : (int)minY, y1 = maxY >= HIZHEIGHT ? HIZHEIGHT - 1 : (int)maxY;
+	for(int y = y0; y <= y1; y++){
+		for(int x = x0; x <= x1; x++){
+			const float px = x + 0.5f, py = y + 0.5f;
+			//barycentric weights, the division makes them positive for both windings
+			const float wa = ((b[0] - px) * (c[1] - py) - (b[1] - py) * (c[0] - px)) / area;
+			const float wb = ((c[0] - px) * (a[1] - py) - (c[1] - py) * (a[0] - px)) / area;
+			const float wc = 1.0f - wa - wb;
+			if(wa < 0.0f || wb < 0.0f || wc < 0.0f){
+				continue;
+			}
+			const float z = wa * a[2] + wb * b[2] + wc * c[2];
+			float *pTexel = &coverage[y * HIZWIDTH + x];
+			*pTexel = z < *pTexel ? z : *pTexel;
+		}
+	}
+}
+
+//half extents of a box inside the object, so an occluder never covers more than the object does
+static void getInnerBox(const obj3d obj, const objectShape shape, float halfExtents[3]){
+	const float scales[OBJECTSHAPENUM][3] = {
+		{0.5f, 0.5f, 0.5f},
+		{0.5f / sqrtf(3.0f), 0.5f / sqrtf(3.0f), 0.5f / sqrtf(3.0f)},
+		{0.5f / sqrtf(2.0f), 0.5f / sqrtf(2.0f), 0.5f}
+	};
+	for(uint32_t axis = 0; axis < 3; axis++){
+		halfExtents[axis] = obj.dimension[axis] * scales[shape][axis];
+	}
+}
+
+//a texel is only written when the centers of it and its eight neighbours are all covered, so the whole texel is,
+//the visible surface of a box is convex in depth, so their farthest depth bounds the texel's from behind
+static void rasterizeOccluder(occlusionCuller *pCuller, const obj3d obj, const objectShape shape){
+	depthPyramid *pPyramid = &pCuller->current;
+	float halfExtents[3];
+	getInnerBox(obj, shape, halfExtents);
+	if(2.0f * fmaxf(halfExtents[0], fmaxf(halfExtents[1], halfExtents[2])) < OCCLUDERMINSIZE){
+		return;
+	}
+	//corner bit 0 is x, bit 1 is y, bit 2 is z, there is no clipping so boxes at the camera are skipped
+	float corners[8][3];
+	for(uint32_t corner = 0; corner < 8; corner++){
+		float p[3];
+		for(uint32_t axis = 0; axis < 3; axis++){
+			p[axis] = corner >> axis & 1 ? halfExtents[axis] : -halfExtents[axis];
+		}
+		rotate(p, obj.rotation);
+		for(uint32_t axis = 0; axis < 3; axis++){
+			p[axis] += obj.pos[axis];
+		}
+		if(!projectPoint((const float(*)[4])pPyramid->viewProj, p, corners[corner])){
+			return;
+		}
+	}
+	float minX = INFINITY, maxX = -INFINITY, minY = INFINITY, maxY = -INFINITY;
+	for(uint32_t corner = 0; corner < 8; corner++){
+		minX = fminf(minX, corners[corner][0]);
+		maxX = fmaxf(maxX, corners[corner][0]);
+		minY = fminf(minY, corners[corner][1]);
+		maxY = fmaxf(maxY, corners[corner][1]);
+	}
+	if(maxX < 0.0f || maxY < 0.0f || minX >= HIZWIDTH || minY >= HIZHEIGHT){
+		return;
+	}
+	const int x0 = minX < 0.0f ? 0 : (int)minX, x1 = maxX >= HIZWIDTH ? HIZWIDTH - 1 : (int)maxX;
+	const int y0 = minY < 0.0f ? 0 : (int)minY, y1 = maxY >= HIZHEIGHT ? HIZHEIGHT - 1 : (int)maxY;
+	float *coverage = pCuller->coverage;
+	for(int y = y0; y <= y1; y++){
+		for(int x = x0; x <= x1; x++){
+			coverage[y * HIZWIDTH + x] = INFINITY;
+		}
+	}
+	static const uint32_t faces[6][4] = {{0, 2, 6, 4}, {1, 3, 7, 5}, {0, 1, 5, 4}, {2, 3, 7, 6}, {0, 1, 3, 2}, {4, 5, 7, 6}};
+	for(uint32_t face = 0; face < 6; face++){
+		const uint32_t *f = faces[face];
+		rasterizeTriangle(coverage, corners[f[0]], corners[f[1]], corners[f[2]]);
+		rasterizeTriangle(coverage, corners[f[0]], corners[f[2]], corners[f[3]]);
+	}
+	//the rectangle's border has an uncovered neighbour or none at all
+	for(int y = y0 + 1; y < y1; y++){
+		for(int x = x0 + 1; x < x1; x++){
+			float farthest = 0.0f;
+			for(int dy = -1; dy <= 1; dy++){
+				for(int dx = -1; dx <= 1; dx++){
+					farthest = fmaxf(farthest, coverage[(y + dy) * HIZWIDTH + x + dx]);
+				}
+			}
+			float *pTexel = &pPyramid->depth[y * HIZWIDTH + x];
+			*pTexel = farthest < *pTexel ? farthest : *pTexel;
+		}
+	}
+}
+
+static void buildDepthPyramid(depthPyramid *pPyramid){
+	for(uint32_t level = 1; level < HIZLEVELNUM; level++){
+		const float *src = &pPyramid->depth[pPyramid->offsets[level - 1]];
+		float *dst = &pPyramid->depth[pPyramid->offsets[level]];
+		const uint32_t srcWidth = levelWidth(level - 1), srcHeight = levelHeight(level - 1);
+		for(uint32_t y = 0; y < levelHeight(level); y++){
+			for(uint32_t x = 0; x < levelWidth(level); x++){
+				const uint32_t sx = 2 * x + 1 < srcWidth ? 2 * x + 1 : srcWidth - 1;
+				const uint32_t sy = 2 * y + 1 < srcHeight ? 2 * y + 1 : srcHeight - 1;
+				dst[y * levelWidth(level) + x] = fmaxf(fmaxf(src[2 * y * srcWidth + 2 * x], src[2 * y * srcWidth + sx]), fmaxf(src[sy * srcWidth + 2 * x], src[sy * srcWidth + sx]));
+			}
+		}
+	}
+	pPyramid->valid = true;
+}
+
+//the bounding sphere's box on screen against the level where it spans at most two texels per axis
+static bool isOccluded(const depthPyramid *pPyramid, const obj3d obj){
+	const float radius = 0.5f * sqrtf(obj.dimension[0] * obj.dimension[0] + obj.dimension[1] * obj.dimension[1] + obj.dimension[2] * obj.dimension[2]);
+	float minX = INFINITY, maxX = -INFINITY, minY = INFINITY, maxY = -INFINITY, nearest = INFINITY;
+	for(uint32_t corner = 0; corner < 8; corner++){
+		const float p[3] = {
+			obj.pos[0] + (corner & 1 ? radius : -radius),
+			obj.pos[1] + (corner & 2 ? radius : -radius),
+			obj.pos[2] + (corner & 4 ? radius : -radius)
+		};
+		float screen[3];
+		if(!projectPoint((const float(*)[4])pPyramid->viewProj, p, screen)){
+			return false;
+		}
+		minX = fminf(minX, screen[0]);
+		maxX = fmaxf(maxX, screen[0]);
+		minY = fminf(minY, screen[1]);
+		maxY = fmaxf(maxY, screen[1]);
+		nearest = fminf(nearest, screen[2]);
+	}
+	//off screen objects are left to the frustum
+	if(nearest < 0.0f || maxX < 0.0f || maxY < 0.0f || minX >= HIZWIDTH || minY >= HIZHEIGHT){
+		return false;
+	}
+	uint32_t level = 0;
+	float size = fmaxf(maxX - minX, maxY - minY);
+	while(size > 2.0f && level + 1 < HIZLEVELNUM){
+		size *= 0.5f;
+		level++;
+	}
+	const uint32_t x0 = minX < 0.0f ? 0 : (uint32_t)minX >> level, y0 = minY < 0.0f ? 0 : (uint32_t)minY >> level;
+	const uint32_t x1 = maxX >= HIZWIDTH ? levelWidth(level) - 1 : (uint32_t)maxX >> level;
+	const uint32_t y1 = maxY >= HIZHEIGHT ? levelHeight(level) - 1 : (uint32_t)maxY >> level;
+	const float *depth = &pPyramid->depth[pPyramid->offsets[level]];
+	for(uint32_t y = y0; y <= y1; y++){
+		for(uint32_t x = x0; x <= x1; x++){
+			if(depth[y * levelWidth(level) + x] >= nearest){
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static void printOcclusionStats(occlusionCuller *pCuller){
+	const occlusionStats stats = pCuller->stats;
+	printf("occlusion culling over %u frames: %llu tested, %llu culled, %llu false negatives\n", OCCLUSIONREPORTINTERVAL, (unsigned long long)stats.tested, (unsigned long long)stats.culled, (unsigned long long)stats.falseNegatives);
+	pCuller->stats = (occlusionStats){0, 0, 0};
+}
+
+//fills pCuller->visible, viewProj is the unjittered camera matrix the scene pass draws with this frame
+void updateOcclusionCulling(occlusionCuller *pCuller, const float viewProj[4][4], const vec objects[OBJECTSHAPENUM]){
+	uint32_t objectNum = 0;
+	for(uint32_t shape = 0; shape < OBJECTSHAPENUM; shape++){
+		objectNum += objects[shape].n;
+	}
+	if(objectNum > pCuller->capacity){
+		while(pCuller->capacity < objectNum){
+			pCuller->capacity *= 2;
+		}
+		pCuller->visible = realloc(pCuller->visible, pCuller->capacity * sizeof(bool));
+	}
+
+	//phase one, last frame's occluders, nothing is hidden before there is a pyramid
+	uint32_t object = 0;
+	for(uint32_t shape = 0; shape < OBJECTSHAPENUM; shape++){
+		for(int i = 0; i < objects[shape].n; i++, object++){
+			pCuller->visible[object] = pCuller->history.valid ? !isOccluded(&pCuller->history, ((obj3d *)objects[shape].array)[i]) : false;
+			pCuller->stats.tested++;
+		}
+	}
+
+	//phase two, this frame's occluders for everything phase one hid, what they bring back was hidden by stale depth
+	depthPyramid *pCurrent = &pCuller->current;
+	memcpy(pCurrent->viewProj, viewProj, sizeof(pCurrent->viewProj));
+	for(uint32_t texel = 0; texel < HIZWIDTH * HIZHEIGHT; texel++){
+		pCurrent->depth[texel] = 1.0f;
+	}
+	for(uint32_t shape = 0; shape < OBJECTSHAPENUM; shape++){
+		for(int i = 0; i < objects[shape].n; i++){
+			rasterizeOccluder(pCuller, ((obj3d *)objects[shape].array)[i], (objectShape)shape);
+		}
+	}
+	buildDepthPyramid(pCurrent);
+	object = 0;
+	for(uint32_t shape = 0; shape < OBJECTSHAPENUM; shape++){
+		for(int i = 0; i < objects[shape].n; i++, object++){
+			if(pCuller->visible[object]){
+				continue;
+			}
+			pCuller->visible[object] = !isOccluded(pCurrent, ((obj3d *)objects[shape].array)[i]);
+			if(!pCuller->visible[object]){
+				pCuller->stats.culled++;
+			}else if(pCuller->history.valid){
+				pCuller->stats.falseNegatives++;
+			}
+		}
+	}
+
+	//this frame's pyramid is the next frame's history
+	depthPyramid swap = pCuller->history;
+	pCuller->history = pCuller->current;
+	pCuller->current = swap;
+
+	pCuller->framesSinceReport++;
+	if(pCuller->framesSinceReport >= OCCLUSIONREPORTINTERVAL){
+		pCuller->framesSinceReport = 0;
+		printOcclusionStats(pCuller);
+	}
+}
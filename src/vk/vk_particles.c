@@ -0,0 +1,169 @@
+#include "vk_fun.h"
+
+#define PARTICLEFRAMERATE 60.0f // the emitters move per frame so headless runs stay reproducible
+
+typedef enum ParticleEffect {
+	PARTICLE_DUST = 0,
+	PARTICLE_SPARKS = 1,
+	PARTICLE_TRAIL = 2,
+	PARTICLEEFFECTNUM = 3
+} particleEffect;
+
+//share of the pool, then everything but the position, which follows the scene every frame
+static const float effectShares[PARTICLEEFFECTNUM] = {0.5f, 0.3f, 0.2f};
+static const particleEmitter effects[PARTICLEEFFECTNUM] = {
+	//slow motes drifting through the whole arena
+	{.posLife = {0.0f, 0.0f, 5.0f, 10.0f}, .velocity = {0.0f, 0.0f, 0.02f, 0.15f}, .color = {0.05f, 0.045f, 0.04f, 0.02f}, .physics = {0.01f, 0.3f, 0.2f, 10.0f}},
+	//a fountain thrown up and bouncing off the floor and walls
+	{.posLife = {0.0f, 0.0f, 0.5f, 1.5f}, .velocity = {0.0f, 0.0f, 4.0f, 2.0f}, .color = {0.9f, 0.45f, 0.1f, 0.03f}, .physics = {9.81f, 0.2f, 0.5f, 0.05f}},
+	//rising behind the player
+	{.posLife = {0.0f, 0.0f, 0.0f, 0.8f}, .velocity = {0.0f, 0.0f, 0.3f, 0.3f}, .color = {0.15f, 0.3f, 0.6f, 0.04f}, .physics = {-0.5f, 1.5f, 0.3f, 0.2f}}
+};
+
+static VkDescriptorSetLayout createParticleSetLayout(const VkDevice device){
+	VkDescriptorSetLayoutBinding bindings[2];
+	for(uint32_t i = 0; i < 2; i++){
+		bindings[i] = (VkDescriptorSetLayoutBinding){
+			.binding = i,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT,
+			.pImmutableSamplers = VK_NULL_HANDLE
+		};
+	}
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = sizeof(bindings) / sizeof(bindings[0]),
+		.pBindings = bindings
+	};
+	VkDescriptorSetLayout setLayout;
+	if(vkCreateDescriptorSetLayout(device, &layoutInfo, VK_NULL_HANDLE, &setLayout) != VK_SUCCESS){
+		fprintf(stderr, "Failed to create descriptor set layout\n");
+		exit(EXIT_FAILURE);
+	}
+	return setLayout;
+}
+
+static VkDescriptorPool createParticleDescriptorPool(const VkDevice device, const uint32_t frameNum){
+	VkDescriptorPoolSize poolSize = {
+		.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		.descriptorCount = 2 * frameNum
+	};
+	VkDescriptorPoolCreateInfo poolInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.poolSizeCount = 1,
+		.pPoolSizes = &poolSize,
+		.maxSets = frameNum
+	};
+	VkDescriptorPool pool;
+	if(vkCreateDescriptorPool(device, &poolInfo, VK_NULL_HANDLE, &pool) != VK_SUCCESS){
+		fprintf(stderr, "Failed to create descriptor pool\n");
+		exit(EXIT_FAILURE);
+	}
+	return pool;
+}
+
+static void writeParticleDescriptors(const VkDevice device, const gpuParticles *pParticles, const uint32_t frame){
+	VkDescriptorBufferInfo bufferInfos[] = {
+		{pParticles->params[frame].buffer.buffer, 0, VK_WHOLE_SIZE},
+		{pParticles->state.buffer, 0, VK_WHOLE_SIZE}
+	};
+	VkWriteDescriptorSet descriptorWrite = {
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.dstSet = pParticles->sets[frame],
+		.dstBinding = 0,
+		.dstArrayElement = 0,
+		.descriptorCount = 2, // consecutive bindings
+		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		.pBufferInfo = bufferInfos
+	};
+	vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, VK_NULL_HANDLE);
+}
+
+//capacity is rounded up to whole workgroups, the state stays on the gpu and is never read back
+gpuParticles createGpuParticles(const VkDevice device, const VkPhysicalDevice physicalDevice, const uint32_t frameNum, const uint32_t capacity, const VkPipelineCache pipelineCache, shaderCache *pShaderCache){
+	gpuParticles particles;
+	particles.frameNum = frameNum;
+	particles.capacity = (capacity + PARTICLEGROUPSIZE - 1) / PARTICLEGROUPSIZE * PARTICLEGROUPSIZE;
+	particles.setLayout = createParticleSetLayout(device);
+	particles.pool = createParticleDescriptorPool(device, frameNum);
+	particles.pipe = createParticlePipe(device, &particles.setLayout, pipelineCache, pShaderCache);
+	particles.state = createBuffer(device, physicalDevice, 2 * particles.capacity * sizeof(particle), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	particles.sets = malloc(frameNum * sizeof(VkDescriptorSet));
+	particles.params = malloc(frameNum * sizeof(mappedBuffer));
+	for(uint32_t i = 0; i < frameNum; i++){
+		VkDescriptorSetAllocateInfo allocInfo = {
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.descriptorPool = particles.pool,
+			.descriptorSetCount = 1,
+			.pSetLayouts = &particles.setLayout
+		};
+		if(vkAllocateDescriptorSets(device, &allocInfo, &particles.sets[i]) != VK_SUCCESS){fprintf(stderr, "Failed to allocate descriptor sets\n");exit(EXIT_FAILURE);}
+		particles.params[i].buffer = createBuffer(device, physicalDevice, sizeof(particleParams), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		vkMapMemory(device, particles.params[i].buffer.memory, 0, sizeof(particleParams), 0, &particles.params[i].pMappedData);
+		writeParticleDescriptors(device, &particles, i);
+	}
+	printf("gpu particles: %u in the pool, %u emitters\n", particles.capacity, PARTICLEEFFECTNUM);
+	return particles;
+}
+
+void deleteGpuParticles(const VkDevice device, gpuParticles *pParticles){
+	deleteMappedBuffers(device, pParticles->params, pParticles->frameNum);
+	deleteBuffer(device, &pParticles->state);
+	deleteComputePipe(device, &pParticles->pipe);
+	//destroying the pool frees the sets
+	vkDestroyDescriptorPool(device, pParticles->pool, VK_NULL_HANDLE);
+	vkDestroyDescriptorSetLayout(device, pParticles->setLayout, VK_NULL_HANDLE);
+	free(pParticles->sets);
+	free(pParticles->params);
+}
+
+//call after the frame slot's fence, a few hundred bytes of emitters is all the cpu touches
+void updateGpuParticles(gpuParticles *pParticles, const uint32_t frame, const uint64_t frameIndex, const float dt, const float playerPos[3]){
+	particleParams *pParams = pParticles->params[frame].pMappedData;
+	pParams->parity = (uint32_t)(frameIndex & 1);
+	pParams->emitterNum = PARTICLEEFFECTNUM;
+	pParams->capacity = pParticles->capacity;
+	pParams->seed = (uint32_t)frameIndex;
+	pParams->dt = dt < PARTICLEMAXSTEP ? dt : PARTICLEMAXSTEP;
+	pParams->reset = frameIndex == 0;
+	const float arenaMin[4] = {-ARENAHALFWIDTH, -ARENAHALFWIDTH, 0.0f, 0.0f};
+	const float arenaMax[4] = {ARENAHALFWIDTH, ARENAHALFWIDTH, ARENAHEIGHT, 0.0f};
+	memcpy(pParams->arenaMin, arenaMin, sizeof(arenaMin));
+	memcpy(pParams->arenaMax, arenaMax, sizeof(arenaMax));
+
+	uint32_t first = 0;
+	for(uint32_t effect = 0; effect < PARTICLEEFFECTNUM; effect++){
+		particleEmitter emitter = effects[effect];
+		emitter.first = first;
+		emitter.count = effect + 1 < PARTICLEEFFECTNUM ? (uint32_t)(pParticles->capacity * effectShares[effect]) : pParticles->capacity - first;
+		//enough to keep every slot alive on average
+		emitter.rate = emitter.count / emitter.posLife[3];
+		first += emitter.count;
+		pParams->emitters[effect] = emitter;
+	}
+	float angle = frameIndex / PARTICLEFRAMERATE * 0.4f;
+	pParams->emitters[PARTICLE_SPARKS].posLife[0] = 5.0f * cosf(angle);
+	pParams->emitters[PARTICLE_SPARKS].posLife[1] = 5.0f * sinf(angle);
+	memcpy(pParams->emitters[PARTICLE_TRAIL].posLife, playerPos, 3 * sizeof(float));
+}
+
+//one thread per pool slot, the scene pass draws the half written here
+void recordGpuParticles(const VkCommandBuffer commandBuffer, const gpuParticles *pParticles, const uint32_t frame){
+	//the previous frame wrote the half read here and drew the half written here
+	VkMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.pNext = VK_NULL_HANDLE,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+	};
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pParticles->pipe.pipe);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pParticles->pipe.layout, 0, 1, &pParticles->sets[frame], 0, VK_NULL_HANDLE);
+	vkCmdDispatch(commandBuffer, pParticles->capacity / PARTICLEGROUPSIZE, 1, 1);
+
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 1, &barrier, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+}
@@ -18,7 +18,7 @@ static VkPipelineLayout createPipelineLayout(const VkDevice device, const VkDesc
 
 static VkPipelineLayout createOffScrenePipelineLayout(const VkDevice device, const VkDescriptorSetLayout *pDescriptorSetLayout){
 	VkPushConstantRange pushConstantRange = {
-		.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+		.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, // ray cast quadrics need the face view for their depth
 		.offset = 0,
 		.size = sizeof(float[4][4])
 	};
@@ -51,18 +51,44 @@ static VkPipelineShaderStageCreateInfo configureShaderStageCreateInfo(const VkSh
 	return shaderStageCreateInfo;
 }
 
-static VkVertexInputBindingDescription *getBindingDescriptions(uint32_t *pBindingNum) {
+//quadric pipelines read one quadricInstance per instance instead of vertices
+static VkVertexInputBindingDescription *getBindingDescriptions(const bool quadrics, uint32_t *pBindingNum) {
 	*pBindingNum = 1;
     VkVertexInputBindingDescription *bindingDescription = malloc(*pBindingNum * sizeof(VkVertexInputBindingDescription));
 	bindingDescription[0] = (VkVertexInputBindingDescription){
         .binding = 0,
-        .stride = sizeof(vertex_t),
-        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX
+        .stride = quadrics ? sizeof(quadricInstance) : sizeof(vertex_t),
+        .inputRate = quadrics ? VK_VERTEX_INPUT_RATE_INSTANCE : VK_VERTEX_INPUT_RATE_VERTEX
     };
     return bindingDescription;
 }
 
-static VkVertexInputAttributeDescription *getAttributeDescriptions(uint32_t *pAttributeNum) {
+static VkVertexInputAttributeDescription *getQuadricAttributeDescriptions(uint32_t *pAttributeNum) {
+	const uint32_t offsets[] = {
+		offsetof(quadricInstance, center),
+		offsetof(quadricInstance, radii),
+		offsetof(quadricInstance, axes[0]),
+		offsetof(quadricInstance, axes[1]),
+		offsetof(quadricInstance, axes[2]),
+		offsetof(quadricInstance, color)
+	};
+	*pAttributeNum = sizeof(offsets) / sizeof(offsets[0]);
+    VkVertexInputAttributeDescription *attributeDescriptions = malloc(*pAttributeNum * sizeof(VkVertexInputAttributeDescription));
+	for(uint32_t i = 0; i < *pAttributeNum; i++){
+		attributeDescriptions[i] = (VkVertexInputAttributeDescription){
+			.location = i,
+			.binding = 0,
+			.format = VK_FORMAT_R32G32B32A32_SFLOAT,
+			.offset = offsets[i]
+		};
+	}
+    return attributeDescriptions;
+}
+
+static VkVertexInputAttributeDescription *getAttributeDescriptions(const bool quadrics, uint32_t *pAttributeNum) {
+	if(quadrics){
+		return getQuadricAttributeDescriptions(pAttributeNum);
+	}
 	*pAttributeNum = 3;
     VkVertexInputAttributeDescription *attributeDescriptions = malloc(*pAttributeNum * sizeof(VkVertexInputAttributeDescription));
     attributeDescriptions[0] = (VkVertexInputAttributeDescription){
@@ -176,12 +202,12 @@ static VkPipelineColorBlendAttachmentState configureColorBlendAttachmentState()
     return colorBlendAttachmentState;
 }
 
-static VkPipelineColorBlendStateCreateInfo configureColorBlendStateCreateInfo(const VkPipelineColorBlendAttachmentState *pColorBlendAttachmentState) {
+static VkPipelineColorBlendStateCreateInfo configureColorBlendStateCreateInfo(const VkPipelineColorBlendAttachmentState *pColorBlendAttachmentState, const uint32_t attachmentCount) {
     VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
         .logicOpEnable = VK_FALSE,
         .logicOp = VK_LOGIC_OP_COPY,
-        .attachmentCount = 1,
+        .attachmentCount = attachmentCount,
         .pAttachments = pColorBlendAttachmentState,
         .blendConstants = {1.0f, 1.0f, 1.0f, 1.0f},
 		.flags = 0,
@@ -243,49 +269,123 @@ static VkPipelineDepthStencilStateCreateInfo configureDepthStencilStateCreateInf
 	return depthStencilStateCreateInfo;
 }
 
-static VkPipelineCache createPipelineCache(const VkDevice device){
-	VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
-		.pNext = VK_NULL_HANDLE,
-		.flags = 0,
-		.initialDataSize = 0,
-		.pInitialData = VK_NULL_HANDLE
-	};
-
-	VkPipelineCache pipelineCache;
-	vkCreatePipelineCache(device, &pipelineCacheCreateInfo, VK_NULL_HANDLE, &pipelineCache);
-	return pipelineCache;
+//pipelines cannot be built without their stages, so a missing shader is fatal here
+static VkShaderModule requireShader(const VkDevice device, shaderCache *pShaderCache, const char *fileName){
+	VkShaderModule shaderModule = getShader(device, pShaderCache, fileName);
+	if(shaderModule == VK_NULL_HANDLE){
+		exit(EXIT_FAILURE);
+	}
+	return shaderModule;
 }
 
-static void deletePipelineCache(const VkDevice device, VkPipelineCache *pPipelineCache){
-	vkDestroyPipelineCache(device, *pPipelineCache, VK_NULL_HANDLE);
-}
+static const char *pipelineShaders[] = {"shaders/scene.vert.spv", "shaders/scene.frag.spv", "shaders/shadow.vert.spv", "shaders/shadow.frag.spv", "shaders/fullscreen.vert.spv", "shaders/temporal.frag.spv", "shaders/quadric.vert.spv", "shaders/quadric.frag.spv", "shaders/quadric_shadow.vert.spv", "shaders/quadric_shadow.frag.spv", "shaders/tessellate.comp.spv", "shaders/cull.comp.spv", "shaders/depth.vert.spv", "shaders/shadow_atlas.vert.spv", "shaders/shadow_atlas.frag.spv", "shaders/particles.comp.spv", "shaders/particle.vert.spv", "shaders/particle.frag.spv", "shaders/scene_velocity.frag.spv", "shaders/quadric_velocity.frag.spv"};
 
+//warms the shader cache so the pipelines only find modules that already exist
+void loadPipelineShaders(const VkDevice device, shaderCache *pShaderCache){
+	for(uint32_t i = 0; i < sizeof(pipelineShaders) / sizeof(pipelineShaders[0]); i++){
+		requireShader(device, pShaderCache, pipelineShaders[i]);
+	}
+}
 
 static void deletePipeline(const VkDevice device, VkPipeline *pPipeline){
 	vkDestroyPipeline(device, *pPipeline, VK_NULL_HANDLE);
 }
 
 
-pipelines createPipelines(const VkDevice device, const VkRenderPass sceneRenderPass, const VkRenderPass offscreenRenderPass, const VkSampleCountFlagBits numSamples, const VkDescriptorSetLayout *pDescriptorSetLayout, const VkExtent2D sceneExtent, const uint32_t shadowMapResolution){
-	pipelines pipes;
-	pipes.scene.layout = createPipelineLayout(device, pDescriptorSetLayout);
-	pipes.offscreen.layout = createOffScrenePipelineLayout(device, pDescriptorSetLayout);
-	VkPipelineCache pipelineCache = createPipelineCache(device);
+//the depth pre-pass splits the usual depth test and write into its two halves
+typedef enum DepthMode {
+	DEPTH_TEST_AND_WRITE,
+	DEPTH_ONLY, // positions only, no fragment shader and no color writes
+	DEPTH_EQUAL // shades exactly the fragments the pre-pass kept
+} depthMode;
+
+//all mesh and quadric pipelines share every fixed function state except the pass, the sample count, the culled face, the color attachments, the vertex input and the depth mode
+static VkPipeline createGraphicsPipeline(const VkDevice device, const VkPipelineLayout layout, const VkRenderPass renderPass, const VkSampleCountFlagBits numSamples, const VkCullModeFlags cullMode, const uint32_t colorAttachmentNum, const VkSpecializationInfo *pFragmentSpecialization, const bool quadrics, const depthMode depth, const char *vertexShader, const char *fragmentShader, const VkPipelineCache pipelineCache, shaderCache *pShaderCache){
 	VkPipelineInputAssemblyStateCreateInfo inputAssembly = configureInputAssemblyStateCreateInfo();
 	VkPipelineRasterizationStateCreateInfo rasterization = configureRasterizationStateCreateInfo();
-	VkPipelineColorBlendAttachmentState blendAttachment = configureColorBlendAttachmentState();
-	VkPipelineColorBlendStateCreateInfo blendState = configureColorBlendStateCreateInfo(&blendAttachment);
+	rasterization.cullMode = cullMode;
+	VkPipelineColorBlendAttachmentState blendAttachments[] = {configureColorBlendAttachmentState(), configureColorBlendAttachmentState()};
+	if(depth == DEPTH_ONLY){
+		blendAttachments[0].colorWriteMask = 0;
+		blendAttachments[1].colorWriteMask = 0;
+	}
+	VkPipelineColorBlendStateCreateInfo blendState = configureColorBlendStateCreateInfo(blendAttachments, colorAttachmentNum);
 	VkPipelineDepthStencilStateCreateInfo depthStencil = configureDepthStencilStateCreateInfo();
+	if(depth == DEPTH_EQUAL){
+		depthStencil.depthWriteEnable = VK_FALSE;
+		depthStencil.depthCompareOp = VK_COMPARE_OP_EQUAL;
+	}
 	VkPipelineViewportStateCreateInfo viewportState = configureViewportStateCreateInfo();
 	VkPipelineMultisampleStateCreateInfo multisample = configureMultisampleStateCreateInfo(numSamples);
 	VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR, VK_DYNAMIC_STATE_DEPTH_BIAS};
 	VkPipelineDynamicStateCreateInfo dynamicState = configureDynamicStateCreateInfo(dynamicStates, 2);
 	uint32_t bindNum, attributeNum;
-	VkVertexInputBindingDescription *bindingDescriptions = getBindingDescriptions(&bindNum);
-	VkVertexInputAttributeDescription *attributeDescriptions = getAttributeDescriptions(&attributeNum);
+	VkVertexInputBindingDescription *bindingDescriptions = getBindingDescriptions(quadrics, &bindNum);
+	VkVertexInputAttributeDescription *attributeDescriptions = getAttributeDescriptions(quadrics, &attributeNum);
+	//the position comes first, the rest of the vertex is skipped by the stride
+	if(depth == DEPTH_ONLY){
+		attributeNum = 1;
+	}
 	VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo = configureVertexInputStateCreateInfo(bindingDescriptions, bindNum, attributeDescriptions, attributeNum);
-	VkPipelineShaderStageCreateInfo shaderStage[2];
+	VkPipelineShaderStageCreateInfo shaderStage[2] = {
+		configureShaderStageCreateInfo(requireShader(device, pShaderCache, vertexShader), VK_SHADER_STAGE_VERTEX_BIT, "main")
+	};
+	if(depth != DEPTH_ONLY){
+		shaderStage[1] = configureShaderStageCreateInfo(requireShader(device, pShaderCache, fragmentShader), VK_SHADER_STAGE_FRAGMENT_BIT, "main");
+		shaderStage[1].pSpecializationInfo = pFragmentSpecialization;
+	}
+
+	VkGraphicsPipelineCreateInfo pipelineCI = {
+	    .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+	    .pNext = NULL,
+	    .flags = 0,
+	    .stageCount = depth == DEPTH_ONLY ? 1 : 2,
+	    .pStages = shaderStage,
+	    .pInputAssemblyState = &inputAssembly,
+	    .pViewportState = &viewportState,
+	    .pRasterizationState = &rasterization,
+	    .pMultisampleState = &multisample,
+	    .pDepthStencilState = &depthStencil,
+	    .pColorBlendState = &blendState,
+	    .pDynamicState = &dynamicState,
+	    .layout = layout,
+	    .renderPass = renderPass,
+	    .subpass = 0,
+		.pVertexInputState = &vertexInputStateCreateInfo,
+		.basePipelineHandle = VK_NULL_HANDLE,
+		.basePipelineIndex = -1
+	};
+	VkPipeline pipeline;
+	if(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, VK_NULL_HANDLE, &pipeline) != VK_SUCCESS){printf("failed to create graphics pipeline\n");exit(EXIT_FAILURE);}
+	free(bindingDescriptions);
+	free(attributeDescriptions);
+	return pipeline;
+}
+
+//billboards generated in the vertex shader, added on top of the scene without writing depth or motion vectors
+static VkPipeline createParticlePipeline(const VkDevice device, const VkPipelineLayout layout, const VkRenderPass sceneRenderPass, const VkSampleCountFlagBits numSamples, const uint32_t colorAttachmentNum, const VkPipelineCache pipelineCache, shaderCache *pShaderCache){
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly = configureInputAssemblyStateCreateInfo();
+	VkPipelineRasterizationStateCreateInfo rasterization = configureRasterizationStateCreateInfo();
+	rasterization.cullMode = VK_CULL_MODE_NONE;
+	VkPipelineColorBlendAttachmentState blendAttachments[] = {configureColorBlendAttachmentState(), configureColorBlendAttachmentState()};
+	blendAttachments[0].blendEnable = VK_TRUE;
+	blendAttachments[0].srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	blendAttachments[0].dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	blendAttachments[0].srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	blendAttachments[0].dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	blendAttachments[1].colorWriteMask = 0;
+	VkPipelineColorBlendStateCreateInfo blendState = configureColorBlendStateCreateInfo(blendAttachments, colorAttachmentNum);
+	VkPipelineDepthStencilStateCreateInfo depthStencil = configureDepthStencilStateCreateInfo();
+	depthStencil.depthWriteEnable = VK_FALSE;
+	VkPipelineViewportStateCreateInfo viewportState = configureViewportStateCreateInfo();
+	VkPipelineMultisampleStateCreateInfo multisample = configureMultisampleStateCreateInfo(numSamples);
+	VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+	VkPipelineDynamicStateCreateInfo dynamicState = configureDynamicStateCreateInfo(dynamicStates, 2);
+	VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo = configureVertexInputStateCreateInfo(VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 0);
+	VkPipelineShaderStageCreateInfo shaderStage[2] = {
+		configureShaderStageCreateInfo(requireShader(device, pShaderCache, pipelineShaders[16]), VK_SHADER_STAGE_VERTEX_BIT, "main"),
+		configureShaderStageCreateInfo(requireShader(device, pShaderCache, pipelineShaders[17]), VK_SHADER_STAGE_FRAGMENT_BIT, "main")
+	};
 
 	VkGraphicsPipelineCreateInfo pipelineCI = {
 	    .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
@@ -300,49 +400,343 @@ pipelines createPipelines(const VkDevice device, const VkRenderPass sceneRenderP
 	    .pDepthStencilState = &depthStencil,
 	    .pColorBlendState = &blendState,
 	    .pDynamicState = &dynamicState,
-	    .layout = pipes.scene.layout,
+	    .layout = layout,
 	    .renderPass = sceneRenderPass,
 	    .subpass = 0,
 		.pVertexInputState = &vertexInputStateCreateInfo,
 		.basePipelineHandle = VK_NULL_HANDLE,
 		.basePipelineIndex = -1
 	};
-	//scenepipeline
-	shaderStage[0] = configureShaderStageCreateInfo(getShader(device, "shaders/scene.vert.spv"), VK_SHADER_STAGE_VERTEX_BIT, "main");
-	shaderStage[1] = configureShaderStageCreateInfo(getShader(device, "shaders/scene.frag.spv"), VK_SHADER_STAGE_FRAGMENT_BIT, "main");
-	if(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, VK_NULL_HANDLE, &pipes.scene.pipe) != VK_SUCCESS){printf("failed to create graphics pipeline\n");exit(EXIT_FAILURE);}
-	pipes.scene.scissor = configureScissor(sceneExtent);
-	pipes.scene.viewport = configureViewport(sceneExtent);
-	vkDestroyShaderModule(device, shaderStage[0].module, VK_NULL_HANDLE);
-	vkDestroyShaderModule(device, shaderStage[1].module, VK_NULL_HANDLE);
-	//offscreen pipeline
-	shaderStage[0] = configureShaderStageCreateInfo(getShader(device, "shaders/shadow.vert.spv"), VK_SHADER_STAGE_VERTEX_BIT, "main");
-	shaderStage[1] = configureShaderStageCreateInfo(getShader(device, "shaders/shadow.frag.spv"), VK_SHADER_STAGE_FRAGMENT_BIT, "main");
-	pipelineCI.layout = pipes.offscreen.layout;
-	rasterization.cullMode = VK_CULL_MODE_FRONT_BIT;
-	//rasterization.frontFace = VK_FRONT_FACE_CLOCKWISE;
-	//rasterization.depthBiasEnable = VK_TRUE;
-	//dynamicState.dynamicStateCount = 3;
-	pipelineCI.renderPass = offscreenRenderPass;
-	multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-	if(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, VK_NULL_HANDLE, &pipes.offscreen.pipe) != VK_SUCCESS){printf("failed to create graphics pipeline\n");exit(EXIT_FAILURE);}
-	pipes.offscreen.scissor = configureScissor((VkExtent2D){shadowMapResolution, shadowMapResolution});
-	pipes.offscreen.viewport = configureViewport((VkExtent2D){shadowMapResolution, shadowMapResolution});
-	pipes.offscreen.bias = (depthBias){0.0f, 0.0f, 0.0f};
-	vkDestroyShaderModule(device, shaderStage[0].module, VK_NULL_HANDLE);
-	vkDestroyShaderModule(device, shaderStage[1].module, VK_NULL_HANDLE);
-	//cleanup
-	deletePipelineCache(device, &pipelineCache);
+	VkPipeline pipeline;
+	if(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, VK_NULL_HANDLE, &pipeline) != VK_SUCCESS){printf("failed to create graphics pipeline\n");exit(EXIT_FAILURE);}
+	return pipeline;
+}
+
+//safe to call concurrently with createOffScreenPipe, the pipeline and shader caches are both synchronized
+//temporal scene pipelines also write motion vectors to the second color attachment
+//the particle pipeline is only built with a particle set layout
+scenePipe createScenePipe(const VkDevice device, const VkRenderPass sceneRenderPass, const VkSampleCountFlagBits numSamples, const VkDescriptorSetLayout *pDescriptorSetLayout, const VkDescriptorSetLayout *pParticleSetLayout, const VkExtent2D sceneExtent, const bool temporal, const VkPipelineCache pipelineCache, shaderCache *pShaderCache){
+	scenePipe pipe;
+	//the light cluster grid of vk_cluster.c, so the shaders can never disagree with the binning
+	const uint32_t clusterGrid[3] = {CLUSTERX, CLUSTERY, CLUSTERZ};
+	const VkSpecializationMapEntry clusterEntries[3] = {{0, 0, sizeof(uint32_t)}, {1, sizeof(uint32_t), sizeof(uint32_t)}, {2, 2 * sizeof(uint32_t), sizeof(uint32_t)}};
+	const VkSpecializationInfo specialization = {
+		.mapEntryCount = 3,
+		.pMapEntries = clusterEntries,
+		.dataSize = sizeof(clusterGrid),
+		.pData = clusterGrid
+	};
+	const char *sceneShader = pipelineShaders[temporal ? 18 : 1];
+	const char *quadricShader = pipelineShaders[temporal ? 19 : 7];
+	pipe.layout = createPipelineLayout(device, pDescriptorSetLayout);
+	pipe.pipe = createGraphicsPipeline(device, pipe.layout, sceneRenderPass, numSamples, VK_CULL_MODE_BACK_BIT, temporal ? 2 : 1, &specialization, false, DEPTH_TEST_AND_WRITE, pipelineShaders[0], sceneShader, pipelineCache, pShaderCache);
+	//depth.vert and scene.vert compute invariant positions, so the equal test matches the pre-pass exactly
+	pipe.depthPrepass = createGraphicsPipeline(device, pipe.layout, sceneRenderPass, numSamples, VK_CULL_MODE_BACK_BIT, temporal ? 2 : 1, VK_NULL_HANDLE, false, DEPTH_ONLY, pipelineShaders[12], NULL, pipelineCache, pShaderCache);
+	pipe.depthEqual = createGraphicsPipeline(device, pipe.layout, sceneRenderPass, numSamples, VK_CULL_MODE_BACK_BIT, temporal ? 2 : 1, &specialization, false, DEPTH_EQUAL, pipelineShaders[0], sceneShader, pipelineCache, pShaderCache);
+	//only the far side of the bounding box, so the ray still starts at the eye when the camera is inside it
+	pipe.quadrics = createGraphicsPipeline(device, pipe.layout, sceneRenderPass, numSamples, VK_CULL_MODE_FRONT_BIT, temporal ? 2 : 1, &specialization, true, DEPTH_TEST_AND_WRITE, pipelineShaders[6], quadricShader, pipelineCache, pShaderCache);
+	pipe.particles = VK_NULL_HANDLE;
+	pipe.particleLayout = VK_NULL_HANDLE;
+	if(pParticleSetLayout != NULL){
+		const VkDescriptorSetLayout setLayouts[] = {*pDescriptorSetLayout, *pParticleSetLayout};
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+			.pNext = VK_NULL_HANDLE,
+			.flags = 0,
+			.setLayoutCount = 2,
+			.pSetLayouts = setLayouts,
+			.pushConstantRangeCount = 0,
+			.pPushConstantRanges = VK_NULL_HANDLE
+		};
+		vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, VK_NULL_HANDLE, &pipe.particleLayout);
+		pipe.particles = createParticlePipeline(device, pipe.particleLayout, sceneRenderPass, numSamples, temporal ? 2 : 1, pipelineCache, pShaderCache);
+	}
+	pipe.scissor = configureScissor(sceneExtent);
+	pipe.viewport = configureViewport(sceneExtent);
+	return pipe;
+}
+
+offScreenPipe createOffScreenPipe(const VkDevice device, const VkRenderPass offscreenRenderPass, const VkDescriptorSetLayout *pDescriptorSetLayout, const uint32_t shadowMapResolution, const VkPipelineCache pipelineCache, shaderCache *pShaderCache){
+	offScreenPipe pipe;
+	pipe.layout = createOffScrenePipelineLayout(device, pDescriptorSetLayout);
+	pipe.pipe = createGraphicsPipeline(device, pipe.layout, offscreenRenderPass, VK_SAMPLE_COUNT_1_BIT, VK_CULL_MODE_FRONT_BIT, 1, VK_NULL_HANDLE, false, DEPTH_TEST_AND_WRITE, pipelineShaders[2], pipelineShaders[3], pipelineCache, pShaderCache);
+	//the light pass has no y flip, which swaps front and back faces
+	pipe.quadrics = createGraphicsPipeline(device, pipe.layout, offscreenRenderPass, VK_SAMPLE_COUNT_1_BIT, VK_CULL_MODE_BACK_BIT, 1, VK_NULL_HANDLE, true, DEPTH_TEST_AND_WRITE, pipelineShaders[8], pipelineShaders[9], pipelineCache, pShaderCache);
+	pipe.scissor = configureScissor((VkExtent2D){shadowMapResolution, shadowMapResolution});
+	pipe.viewport = configureViewport((VkExtent2D){shadowMapResolution, shadowMapResolution});
+	pipe.bias = (depthBias){0.0f, 0.0f, 0.0f};
+	return pipe;
+}
+
+//the mesh detail is a specialization constant, so the shader writes exactly the counts the cpu sized the buffers for
+computePipe createTessellationPipe(const VkDevice device, const VkDescriptorSetLayout *pDescriptorSetLayout, const VkPipelineCache pipelineCache, shaderCache *pShaderCache){
+	computePipe pipe;
+	VkPushConstantRange pushConstantRange = {
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(tessellationCounts)
+	};
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.pNext = VK_NULL_HANDLE,
+		.flags = 0,
+		.setLayoutCount = 1,
+		.pSetLayouts = pDescriptorSetLayout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &pushConstantRange
+	};
+	vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, VK_NULL_HANDLE, &pipe.layout);
+
+	const uint32_t detail = ELLIPSOIDDETAIL;
+	VkSpecializationMapEntry detailEntry = {0, 0, sizeof(uint32_t)};
+	VkSpecializationInfo specialization = {
+		.mapEntryCount = 1,
+		.pMapEntries = &detailEntry,
+		.dataSize = sizeof(uint32_t),
+		.pData = &detail
+	};
+	VkPipelineShaderStageCreateInfo shaderStage = configureShaderStageCreateInfo(requireShader(device, pShaderCache, pipelineShaders[10]), VK_SHADER_STAGE_COMPUTE_BIT, "main");
+	shaderStage.pSpecializationInfo = &specialization;
+	VkComputePipelineCreateInfo pipelineCI = {
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.pNext = VK_NULL_HANDLE,
+		.flags = 0,
+		.stage = shaderStage,
+		.layout = pipe.layout,
+		.basePipelineHandle = VK_NULL_HANDLE,
+		.basePipelineIndex = -1
+	};
+	if(vkCreateComputePipelines(device, pipelineCache, 1, &pipelineCI, VK_NULL_HANDLE, &pipe.pipe) != VK_SUCCESS){printf("failed to create compute pipeline\n");exit(EXIT_FAILURE);}
+	return pipe;
+}
+
+//compact selects the draw count path, the ellipsoid and cylinder index counts follow the tessellation detail
+computePipe createCullingPipe(const VkDevice device, const VkDescriptorSetLayout *pDescriptorSetLayout, const bool compact, const VkPipelineCache pipelineCache, shaderCache *pShaderCache){
+	computePipe pipe;
+	VkPushConstantRange pushConstantRange = {
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(cullingConstants)
+	};
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.pNext = VK_NULL_HANDLE,
+		.flags = 0,
+		.setLayoutCount = 1,
+		.pSetLayouts = pDescriptorSetLayout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &pushConstantRange
+	};
+	vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, VK_NULL_HANDLE, &pipe.layout);
+
+	const uint32_t constants[] = {ELLIPSOIDDETAIL, compact ? VK_TRUE : VK_FALSE};
+	VkSpecializationMapEntry entries[] = {
+		{0, 0, sizeof(uint32_t)},
+		{1, sizeof(uint32_t), sizeof(VkBool32)}
+	};
+	VkSpecializationInfo specialization = {
+		.mapEntryCount = 2,
+		.pMapEntries = entries,
+		.dataSize = sizeof(constants),
+		.pData = constants
+	};
+	VkPipelineShaderStageCreateInfo shaderStage = configureShaderStageCreateInfo(requireShader(device, pShaderCache, pipelineShaders[11]), VK_SHADER_STAGE_COMPUTE_BIT, "main");
+	shaderStage.pSpecializationInfo = &specialization;
+	VkComputePipelineCreateInfo pipelineCI = {
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.pNext = VK_NULL_HANDLE,
+		.flags = 0,
+		.stage = shaderStage,
+		.layout = pipe.layout,
+		.basePipelineHandle = VK_NULL_HANDLE,
+		.basePipelineIndex = -1
+	};
+	if(vkCreateComputePipelines(device, pipelineCache, 1, &pipelineCI, VK_NULL_HANDLE, &pipe.pipe) != VK_SUCCESS){printf("failed to create compute pipeline\n");exit(EXIT_FAILURE);}
+	return pipe;
+}
+
+//one thread per pool slot, the emitters come from the per frame parameters
+computePipe createParticlePipe(const VkDevice device, const VkDescriptorSetLayout *pDescriptorSetLayout, const VkPipelineCache pipelineCache, shaderCache *pShaderCache){
+	computePipe pipe;
+	pipe.layout = createPipelineLayout(device, pDescriptorSetLayout);
+	VkPipelineShaderStageCreateInfo shaderStage = configureShaderStageCreateInfo(requireShader(device, pShaderCache, pipelineShaders[15]), VK_SHADER_STAGE_COMPUTE_BIT, "main");
+	VkComputePipelineCreateInfo pipelineCI = {
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.pNext = VK_NULL_HANDLE,
+		.flags = 0,
+		.stage = shaderStage,
+		.layout = pipe.layout,
+		.basePipelineHandle = VK_NULL_HANDLE,
+		.basePipelineIndex = -1
+	};
+	if(vkCreateComputePipelines(device, pipelineCache, 1, &pipelineCI, VK_NULL_HANDLE, &pipe.pipe) != VK_SUCCESS){printf("failed to create compute pipeline\n");exit(EXIT_FAILURE);}
+	return pipe;
+}
+
+void deleteComputePipe(const VkDevice device, computePipe *pPipe){
+	deletePipeline(device, &pPipe->pipe);
+	deletePipelineLayout(device, &pPipe->layout);
+}
+
+//positions only, clear selects the tile sized far plane triangle in both stages
+static VkPipeline createShadowAtlasPipeline(const VkDevice device, const VkPipelineLayout layout, const VkRenderPass atlasRenderPass, const bool clear, const VkPipelineCache pipelineCache, shaderCache *pShaderCache){
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly = configureInputAssemblyStateCreateInfo();
+	VkPipelineRasterizationStateCreateInfo rasterization = configureRasterizationStateCreateInfo();
+	//the face projections are not y flipped, both sides cast so the winding does not matter
+	rasterization.cullMode = VK_CULL_MODE_NONE;
+	VkPipelineColorBlendAttachmentState blendAttachment = configureColorBlendAttachmentState();
+	VkPipelineColorBlendStateCreateInfo blendState = configureColorBlendStateCreateInfo(&blendAttachment, 1);
+	VkPipelineDepthStencilStateCreateInfo depthStencil = configureDepthStencilStateCreateInfo();
+	VkPipelineViewportStateCreateInfo viewportState = configureViewportStateCreateInfo();
+	VkPipelineMultisampleStateCreateInfo multisample = configureMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT);
+	VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+	VkPipelineDynamicStateCreateInfo dynamicState = configureDynamicStateCreateInfo(dynamicStates, 2);
+	uint32_t bindNum, attributeNum;
+	VkVertexInputBindingDescription *bindingDescriptions = getBindingDescriptions(false, &bindNum);
+	VkVertexInputAttributeDescription *attributeDescriptions = getAttributeDescriptions(false, &attributeNum);
+	VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo = configureVertexInputStateCreateInfo(bindingDescriptions, bindNum, attributeDescriptions, 1);
+
+	const VkBool32 clearTile = clear ? VK_TRUE : VK_FALSE;
+	VkSpecializationMapEntry clearEntry = {0, 0, sizeof(VkBool32)};
+	VkSpecializationInfo specialization = {
+		.mapEntryCount = 1,
+		.pMapEntries = &clearEntry,
+		.dataSize = sizeof(VkBool32),
+		.pData = &clearTile
+	};
+	VkPipelineShaderStageCreateInfo shaderStage[2] = {
+		configureShaderStageCreateInfo(requireShader(device, pShaderCache, pipelineShaders[13]), VK_SHADER_STAGE_VERTEX_BIT, "main"),
+		configureShaderStageCreateInfo(requireShader(device, pShaderCache, pipelineShaders[14]), VK_SHADER_STAGE_FRAGMENT_BIT, "main")
+	};
+	shaderStage[0].pSpecializationInfo = &specialization;
+	shaderStage[1].pSpecializationInfo = &specialization;
+
+	VkGraphicsPipelineCreateInfo pipelineCI = {
+	    .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+	    .pNext = NULL,
+	    .flags = 0,
+	    .stageCount = 2,
+	    .pStages = shaderStage,
+	    .pInputAssemblyState = &inputAssembly,
+	    .pViewportState = &viewportState,
+	    .pRasterizationState = &rasterization,
+	    .pMultisampleState = &multisample,
+	    .pDepthStencilState = &depthStencil,
+	    .pColorBlendState = &blendState,
+	    .pDynamicState = &dynamicState,
+	    .layout = layout,
+	    .renderPass = atlasRenderPass,
+	    .subpass = 0,
+		.pVertexInputState = &vertexInputStateCreateInfo,
+		.basePipelineHandle = VK_NULL_HANDLE,
+		.basePipelineIndex = -1
+	};
+	VkPipeline pipeline;
+	if(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, VK_NULL_HANDLE, &pipeline) != VK_SUCCESS){printf("failed to create graphics pipeline\n");exit(EXIT_FAILURE);}
 	free(bindingDescriptions);
 	free(attributeDescriptions);
-	return pipes;
+	return pipeline;
+}
+
+//shares the scene descriptor set for the shadow records, the push constant picks the face slot
+shadowAtlasPipe createShadowAtlasPipe(const VkDevice device, const VkRenderPass atlasRenderPass, const VkDescriptorSetLayout *pDescriptorSetLayout, const uint32_t atlasSize, const VkPipelineCache pipelineCache, shaderCache *pShaderCache){
+	shadowAtlasPipe pipe;
+	VkPushConstantRange pushConstantRange = {
+		.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+		.offset = 0,
+		.size = sizeof(uint32_t)
+	};
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.pNext = VK_NULL_HANDLE,
+		.flags = 0,
+		.setLayoutCount = 1,
+		.pSetLayouts = pDescriptorSetLayout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &pushConstantRange
+	};
+	vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, VK_NULL_HANDLE, &pipe.layout);
+	pipe.pipe = createShadowAtlasPipeline(device, pipe.layout, atlasRenderPass, false, pipelineCache, pShaderCache);
+	pipe.clear = createShadowAtlasPipeline(device, pipe.layout, atlasRenderPass, true, pipelineCache, pShaderCache);
+	pipe.scissor = configureScissor((VkExtent2D){atlasSize, atlasSize});
+	pipe.viewport = configureViewport((VkExtent2D){atlasSize, atlasSize});
+	return pipe;
+}
+
+void deleteShadowAtlasPipe(const VkDevice device, shadowAtlasPipe *pPipe){
+	deletePipeline(device, &pPipe->pipe);
+	deletePipeline(device, &pPipe->clear);
+	deletePipelineLayout(device, &pPipe->layout);
+}
+
+//a fullscreen triangle generated in the vertex shader, no vertex input and no depth
+temporalPipe createTemporalPipe(const VkDevice device, const VkRenderPass temporalRenderPass, const VkDescriptorSetLayout *pDescriptorSetLayout, const VkExtent2D extent, const VkPipelineCache pipelineCache, shaderCache *pShaderCache){
+	temporalPipe pipe;
+	pipe.layout = createPipelineLayout(device, pDescriptorSetLayout);
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly = configureInputAssemblyStateCreateInfo();
+	VkPipelineRasterizationStateCreateInfo rasterization = configureRasterizationStateCreateInfo();
+	rasterization.cullMode = VK_CULL_MODE_NONE;
+	VkPipelineColorBlendAttachmentState blendAttachment = configureColorBlendAttachmentState();
+	VkPipelineColorBlendStateCreateInfo blendState = configureColorBlendStateCreateInfo(&blendAttachment, 1);
+	VkPipelineViewportStateCreateInfo viewportState = configureViewportStateCreateInfo();
+	VkPipelineMultisampleStateCreateInfo multisample = configureMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT);
+	VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+	VkPipelineDynamicStateCreateInfo dynamicState = configureDynamicStateCreateInfo(dynamicStates, 2);
+	VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo = configureVertexInputStateCreateInfo(VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 0);
+	VkPipelineShaderStageCreateInfo shaderStage[2] = {
+		configureShaderStageCreateInfo(requireShader(device, pShaderCache, pipelineShaders[4]), VK_SHADER_STAGE_VERTEX_BIT, "main"),
+		configureShaderStageCreateInfo(requireShader(device, pShaderCache, pipelineShaders[5]), VK_SHADER_STAGE_FRAGMENT_BIT, "main")
+	};
+
+	VkGraphicsPipelineCreateInfo pipelineCI = {
+	    .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+	    .pNext = NULL,
+	    .flags = 0,
+	    .stageCount = 2,
+	    .pStages = shaderStage,
+	    .pInputAssemblyState = &inputAssembly,
+	    .pViewportState = &viewportState,
+	    .pRasterizationState = &rasterization,
+	    .pMultisampleState = &multisample,
+	    .pDepthStencilState = VK_NULL_HANDLE,
+	    .pColorBlendState = &blendState,
+	    .pDynamicState = &dynamicState,
+	    .layout = pipe.layout,
+	    .renderPass = temporalRenderPass,
+	    .subpass = 0,
+		.pVertexInputState = &vertexInputStateCreateInfo,
+		.basePipelineHandle = VK_NULL_HANDLE,
+		.basePipelineIndex = -1
+	};
+	if(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, VK_NULL_HANDLE, &pipe.pipe) != VK_SUCCESS){printf("failed to create graphics pipeline\n");exit(EXIT_FAILURE);}
+	pipe.scissor = configureScissor(extent);
+	pipe.viewport = configureViewport(extent);
+	return pipe;
+}
+
+//the governor rebuilds the scene pipeline when the sample count changes
+void deleteScenePipe(const VkDevice device, scenePipe *pPipe){
+	deletePipelineLayout(device, &pPipe->layout);
+	deletePipeline(device, &pPipe->pipe);
+	deletePipeline(device, &pPipe->depthPrepass);
+	deletePipeline(device, &pPipe->depthEqual);
+	deletePipeline(device, &pPipe->quadrics);
+	if(pPipe->particles != VK_NULL_HANDLE){
+		deletePipeline(device, &pPipe->particles);
+		deletePipelineLayout(device, &pPipe->particleLayout);
+	}
 }
 
 void deletePipelines(const VkDevice device, pipelines *pPipelines){
 	deletePipelineLayout(device, &pPipelines->offscreen.layout);
-	deletePipelineLayout(device, &pPipelines->scene.layout);
-	deletePipeline(device, &pPipelines->scene.pipe);
+	deleteScenePipe(device, &pPipelines->scene);
 	deletePipeline(device, &pPipelines->offscreen.pipe);
+	deletePipeline(device, &pPipelines->offscreen.quadrics);
+	if(pPipelines->temporal.pipe != VK_NULL_HANDLE){
+		deletePipeline(device, &pPipelines->temporal.pipe);
+		deletePipelineLayout(device, &pPipelines->temporal.layout);
+	}
 }
 
 VkViewport configureViewport(const VkExtent2D extent) {
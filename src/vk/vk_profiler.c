@@ -0,0 +1,174 @@
+#include "vk_fun.h"
+
+static const char *passNames[RECORDPASSNUM] = {
+	"shadow +X", "shadow -X", "shadow +Y", "shadow -Y", "shadow +Z", "shadow -Z", "scene"
+};
+
+static VkQueryPool createTimestampQueryPool(const VkDevice device, const uint32_t queryCount){
+	VkQueryPoolCreateInfo queryPoolCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.pNext = VK_NULL_HANDLE,
+		.flags = 0,
+		.queryType = VK_QUERY_TYPE_TIMESTAMP,
+		.queryCount = queryCount,
+		.pipelineStatistics = 0
+	};
+
+	VkQueryPool queryPool;
+	if(vkCreateQueryPool(device, &queryPoolCreateInfo, VK_NULL_HANDLE, &queryPool) != VK_SUCCESS){
+		printf("failed to create timestamp query pool!\n");
+		exit(EXIT_FAILURE);
+	}
+	return queryPool;
+}
+
+static int compareDoubles(const void *a, const void *b){
+	const double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+static void printGpuProfile(gpuProfiler *pProfiler, const uint64_t frame){
+	printf("gpu timings over %u frames (ms, min/avg/p99):", pProfiler->sampleNum);
+	for(uint32_t pass = 0; pass < RECORDPASSNUM; pass++){
+		gpuPassStats stats = getGpuPassStats(pProfiler, pass);
+		printf(" %s %.3f/%.3f/%.3f%s", passNames[pass], stats.min, stats.avg, stats.p99, pass + 1 < RECORDPASSNUM ? "," : "\n");
+		if(pProfiler->csv != NULL){
+			fprintf(pProfiler->csv, "%llu,%s,%.4f,%.4f,%.4f\n", (unsigned long long)frame, passNames[pass], stats.min, stats.avg, stats.p99);
+		}
+	}
+	if(pProfiler->csv != NULL){
+		fflush(pProfiler->csv);
+	}
+}
+
+//timestampValidBits of the graphics queue family, 0 means timestamps are not supported
+gpuProfiler createGpuProfiler(const VkDevice device, const VkPhysicalDevice physicalDevice, const uint32_t timestampValidBits, const uint32_t frameNum, const char *csvPath){
+	gpuProfiler profiler;
+	VkPhysicalDeviceProperties physicalDeviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+
+	profiler.supported = timestampValidBits > 0 && physicalDeviceProperties.limits.timestampPeriod > 0.0f;
+	profiler.timestampPeriod = physicalDeviceProperties.limits.timestampPeriod;
+	profiler.timestampMask = timestampValidBits >= 64 ? UINT64_MAX : ((uint64_t)1 << timestampValidBits) - 1;
+	profiler.frameNum = frameNum;
+	profiler.pools = malloc(frameNum * sizeof(VkQueryPool));
+	profiler.pending = malloc(frameNum * sizeof(bool));
+	for(uint32_t i = 0; i < frameNum; i++){
+		profiler.pools[i] = profiler.supported ? createTimestampQueryPool(device, PROFILERQUERYNUM) : VK_NULL_HANDLE;
+		profiler.pending[i] = false;
+	}
+	profiler.samples = malloc(PROFILERWINDOW * RECORDPASSNUM * sizeof(double));
+	profiler.sampleNum = 0;
+	profiler.nextSample = 0;
+	profiler.framesSinceReport = 0;
+	profiler.frameTime = 0.0;
+	profiler.csv = NULL;
+	if(!profiler.supported){
+		printf("gpu timestamps not supported, profiler disabled\n");
+	}else if(csvPath != NULL){
+		profiler.csv = fopen(csvPath, "w");
+		if(profiler.csv == NULL){
+			printf("failed to open %s, gpu timings go to stdout only\n", csvPath);
+		}else{
+			fprintf(profiler.csv, "frame,pass,min_ms,avg_ms,p99_ms\n");
+		}
+	}
+	return profiler;
+}
+
+void deleteGpuProfiler(const VkDevice device, gpuProfiler *pProfiler){
+	for(uint32_t i = 0; i < pProfiler->frameNum; i++){
+		if(pProfiler->pools[i] != VK_NULL_HANDLE){
+			vkDestroyQueryPool(device, pProfiler->pools[i], VK_NULL_HANDLE);
+		}
+	}
+	if(pProfiler->csv != NULL){
+		fclose(pProfiler->csv);
+	}
+	free(pProfiler->pools);
+	free(pProfiler->pending);
+	free(pProfiler->samples);
+}
+
+//recorded into the primary buffer before any pass, outside of a render pass
+void resetGpuTimestamps(const gpuProfiler *pProfiler, const VkCommandBuffer commandBuffer, const uint32_t frame){
+	if(pProfiler->supported){
+		vkCmdResetQueryPool(commandBuffer, pProfiler->pools[frame], 0, PROFILERQUERYNUM);
+	}
+}
+
+void writeGpuTimestamp(const gpuProfiler *pProfiler, const VkCommandBuffer commandBuffer, const uint32_t frame, const uint32_t pass, const bool end){
+	if(pProfiler->supported){
+		vkCmdWriteTimestamp(commandBuffer, end ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pProfiler->pools[frame], pass * 2 + (end ? 1 : 0));
+	}
+}
+
+//recorded right after the reset so the frame time also covers the copies and compute dispatches
+void writeGpuFrameStart(const gpuProfiler *pProfiler, const VkCommandBuffer commandBuffer, const uint32_t frame){
+	if(pProfiler->supported){
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pProfiler->pools[frame], FRAMESTARTQUERY);
+	}
+}
+
+void markGpuTimestampsSubmitted(gpuProfiler *pProfiler, const uint32_t frame){
+	pProfiler->pending[frame] = pProfiler->supported;
+}
+
+//call after the frame slot's fence was waited on, the results are then available and reading them never stalls
+void collectGpuTimestamps(gpuProfiler *pProfiler, const VkDevice device, const uint32_t frame, const uint64_t frameCount){
+	if(!pProfiler->pending[frame]){
+		return;
+	}
+	pProfiler->pending[frame] = false;
+
+	uint64_t timestamps[PROFILERQUERYNUM];
+	if(vkGetQueryPoolResults(device, pProfiler->pools[frame], 0, PROFILERQUERYNUM, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS){
+		return;
+	}
+	double *pSample = &pProfiler->samples[pProfiler->nextSample * RECORDPASSNUM];
+	for(uint32_t pass = 0; pass < RECORDPASSNUM; pass++){
+		uint64_t ticks = (timestamps[pass * 2 + 1] - timestamps[pass * 2]) & pProfiler->timestampMask;
+		pSample[pass] = ticks * (double)pProfiler->timestampPeriod / 1000000.0;
+	}
+	uint64_t frameTicks = (timestamps[RECORDPASSNUM * 2 - 1] - timestamps[FRAMESTARTQUERY]) & pProfiler->timestampMask;
+	pProfiler->frameTime = frameTicks * (double)pProfiler->timestampPeriod / 1000000.0;
+	pProfiler->nextSample = (pProfiler->nextSample + 1) % PROFILERWINDOW;
+	if(pProfiler->sampleNum < PROFILERWINDOW){
+		pProfiler->sampleNum++;
+	}
+
+	pProfiler->framesSinceReport++;
+	if(pProfiler->framesSinceReport >= PROFILERREPORTINTERVAL){
+		pProfiler->framesSinceReport = 0;
+		printGpuProfile(pProfiler, frameCount);
+	}
+}
+
+//statistics over the last PROFILERWINDOW frames, in milliseconds
+gpuPassStats getGpuPassStats(const gpuProfiler *pProfiler, const uint32_t pass){
+	gpuPassStats stats = {0.0, 0.0, 0.0, pProfiler->sampleNum};
+	if(pProfiler->sampleNum == 0 || pass >= RECORDPASSNUM){
+		return stats;
+	}
+	double sorted[PROFILERWINDOW];
+	double sum = 0.0;
+	for(uint32_t i = 0; i < pProfiler->sampleNum; i++){
+		sorted[i] = pProfiler->samples[i * RECORDPASSNUM + pass];
+		sum += sorted[i];
+	}
+	qsort(sorted, pProfiler->sampleNum, sizeof(double), compareDoubles);
+	stats.min = sorted[0];
+	stats.avg = sum / pProfiler->sampleNum;
+	stats.p99 = sorted[(uint32_t)(0.99 * (pProfiler->sampleNum - 1))];
+	return stats;
+}
+
+//drops every collected and in flight sample, call only with the device idle
+void resetGpuProfiler(gpuProfiler *pProfiler){
+	for(uint32_t frame = 0; frame < pProfiler->frameNum; frame++){
+		pProfiler->pending[frame] = false;
+	}
+	pProfiler->sampleNum = 0;
+	pProfiler->nextSample = 0;
+	pProfiler->framesSinceReport = 0;
+}
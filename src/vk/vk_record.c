@@ -0,0 +1,58 @@
+#include "vk_fun.h"
+
+//one pass into its secondary buffer of the slot, on whichever thread took the job
+static void recordPassJob(void *data){
+	recordJob *pJob = (recordJob *)data;
+	commandRecorder *pRecorder = pJob->pRecorder;
+	const uint32_t index = pJob->slot * RECORDPASSNUM + pJob->pass;
+	vkResetCommandPool(pRecorder->device, pRecorder->pools[index], 0);
+	pRecorder->record(pRecorder->buffers[index], pJob->pass);
+}
+
+//every slot owns its secondaries, so re-recording one slot leaves the others valid for reuse
+commandRecorder *createCommandRecorder(const VkDevice device, const uint32_t queueFamilyIndex, const uint32_t slotNum, jobSystem *pJobs, const recordPassFunction record){
+	commandRecorder *pRecorder = malloc(sizeof(commandRecorder));
+	pRecorder->device = device;
+	pRecorder->slotNum = slotNum;
+	pRecorder->record = record;
+	pRecorder->pJobs = pJobs;
+	pRecorder->jobs = malloc(RECORDPASSNUM * sizeof(recordJob));
+
+	//command pools are externally synchronized, a pool per pass is only ever used by the job recording that pass
+	pRecorder->pools = malloc(slotNum * RECORDPASSNUM * sizeof(VkCommandPool));
+	pRecorder->buffers = malloc(slotNum * RECORDPASSNUM * sizeof(VkCommandBuffer));
+	for(uint32_t i = 0; i < slotNum * RECORDPASSNUM; i++){
+		pRecorder->pools[i] = createCommandPool(device, queueFamilyIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+		VkCommandBuffer *pBuffer = createCommandBuffers(device, pRecorder->pools[i], VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1);
+		pRecorder->buffers[i] = *pBuffer;
+		free(pBuffer);
+	}
+	return pRecorder;
+}
+
+void deleteCommandRecorder(const VkDevice device, commandRecorder **ppRecorder){
+	commandRecorder *pRecorder = *ppRecorder;
+	//destroying the pools frees the secondary buffers allocated from them
+	for(uint32_t i = 0; i < pRecorder->slotNum * RECORDPASSNUM; i++){
+		deleteCommandPool(device, &pRecorder->pools[i]);
+	}
+	free(pRecorder->pools);
+	free(pRecorder->buffers);
+	free(pRecorder->jobs);
+	free(pRecorder);
+	*ppRecorder = NULL;
+}
+
+//a job per pass, the rendering thread records passes too while it waits for the rest
+const VkCommandBuffer *recordSecondaryCommandBuffers(commandRecorder *pRecorder, const uint32_t slot){
+	jobCounter counter;
+	atomic_init(&counter.pending, 0);
+	job jobs[RECORDPASSNUM];
+	for(uint32_t pass = 0; pass < RECORDPASSNUM; pass++){
+		pRecorder->jobs[pass] = (recordJob){pRecorder, pass, slot};
+		jobs[pass] = (job){recordPassJob, &pRecorder->jobs[pass], &counter};
+	}
+	runJobs(pRecorder->pJobs, jobs, RECORDPASSNUM);
+	waitForJobs(pRecorder->pJobs, &counter);
+	return &pRecorder->buffers[slot * RECORDPASSNUM];
+}
@@ -1,36 +1,95 @@
 #include "vk_fun.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
-static uint32_t getShaderSize(const char *fileName){
-	FILE *fp = VK_NULL_HANDLE;
-	fp = fopen(fileName, "rb+");
-	if(fp == VK_NULL_HANDLE){
-		printf("failed to open shader!\n");
-		exit(EXIT_FAILURE);
+#ifdef EMBED_SHADERS
+//generated from the compiled spir-v by cmake/embed_shaders.cmake
+extern const embeddedShader embeddedShaders[];
+extern const uint32_t embeddedShaderNum;
+
+static bool findEmbeddedShader(const char *fileName, shaderBlob *pBlob){
+	for(uint32_t i = 0; i < embeddedShaderNum; i++){
+		if(strcmp(embeddedShaders[i].name, fileName) == 0){
+			*pBlob = (shaderBlob){embeddedShaders[i].code, embeddedShaders[i].size, NULL, NULL};
+			return true;
+		}
 	}
-	fseek(fp, 0l, SEEK_END);
-	uint32_t shaderSize = (uint32_t)ftell(fp);
-	fclose(fp);
-	return shaderSize;
+	return false;
 }
+#endif
 
-static uint32_t *getShaderCode(const char *fileName, const uint32_t shaderSize){
-	FILE *fp =VK_NULL_HANDLE;
-	fp = fopen(fileName, "rb+");
-	if(fp == VK_NULL_HANDLE){
-		printf("failed to open shader!\n");
-		exit(EXIT_FAILURE);
+//one read-only mapping of the whole file, the code is used straight from the page cache
+static bool mapShaderFile(const char *fileName, shaderBlob *pBlob){
+#ifdef _WIN32
+	HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE){
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if(!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0){
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if(mapping == NULL){
+		return false;
+	}
+	void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if(view == NULL){
+		CloseHandle(mapping);
+		return false;
+	}
+	*pBlob = (shaderBlob){view, (size_t)fileSize.QuadPart, view, mapping};
+#else
+	int fd = open(fileName, O_RDONLY);
+	if(fd < 0){
+		return false;
+	}
+	struct stat fileStat;
+	if(fstat(fd, &fileStat) != 0 || fileStat.st_size == 0){
+		close(fd);
+		return false;
 	}
-	uint32_t *shaderCode = malloc((shaderSize) * sizeof(char));
-	fread(shaderCode, 1, shaderSize, fp);
-	fclose(fp);
-	return shaderCode;
+	void *view = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(view == MAP_FAILED){
+		return false;
+	}
+	*pBlob = (shaderBlob){view, (size_t)fileStat.st_size, view, NULL};
+#endif
+	return true;
 }
 
-static void deleteShaderCode(uint32_t **pShaderCode){
-	free(*pShaderCode);
+static bool loadShaderBlob(const char *fileName, shaderBlob *pBlob){
+#ifdef EMBED_SHADERS
+	if(findEmbeddedShader(fileName, pBlob)){
+		return true;
+	}
+#endif
+	return mapShaderFile(fileName, pBlob);
+}
+
+static void releaseShaderBlob(shaderBlob *pBlob){
+	if(pBlob->view == NULL){
+		return;
+	}
+#ifdef _WIN32
+	UnmapViewOfFile(pBlob->view);
+	CloseHandle(pBlob->mapping);
+#else
+	munmap(pBlob->view, pBlob->size);
+#endif
+	pBlob->view = NULL;
 }
 
-static VkShaderModule createShaderModule(const VkDevice device, const uint32_t *shaderCode, const uint32_t shaderSize){
+static VkShaderModule createShaderModule(const VkDevice device, const uint32_t *shaderCode, const size_t shaderSize){
 	VkShaderModuleCreateInfo shaderModuleCreateInfo = {
 		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
 		.codeSize = shaderSize,
@@ -39,8 +98,7 @@ static VkShaderModule createShaderModule(const VkDevice device, const uint32_t *
 
 	VkShaderModule shaderModule;
 	if(vkCreateShaderModule(device, &shaderModuleCreateInfo, VK_NULL_HANDLE, &shaderModule) != VK_SUCCESS){
-		printf("failed to create shader module!\n");
-		exit(EXIT_FAILURE);
+		return VK_NULL_HANDLE;
 	}
 	return shaderModule;
 }
@@ -49,14 +107,55 @@ static void deleteShaderModule(const VkDevice device, VkShaderModule *pShaderMod
 	vkDestroyShaderModule(device, *pShaderModule, VK_NULL_HANDLE);
 }
 
-VkShaderModule getShader(const VkDevice device, const char *fileName){
-	uint32_t shaderSize = getShaderSize(fileName);
-	uint32_t *shaderCode = getShaderCode(fileName, shaderSize);
-	VkShaderModule shaderModule = createShaderModule(device, shaderCode, shaderSize);
-	deleteShaderCode(&shaderCode);
-	return shaderModule;
+shaderCache createShaderCache(){
+	shaderCache cache;
+	initVector(&cache.shaders, sizeof(cachedShader), 8, 8);
+	cthreads_mutex_init(&cache.mutex, NULL);
+	return cache;
+}
+
+void deleteShaderCache(const VkDevice device, shaderCache *pCache){
+	cachedShader *shaders = pCache->shaders.array;
+	for(int i = 0; i < pCache->shaders.n; i++){
+		deleteShaderModule(device, &shaders[i].module);
+	}
+	deleteVector(&pCache->shaders);
+	cthreads_mutex_destroy(&pCache->mutex);
 }
 
-void deleteShader(const VkDevice device, VkShaderModule *pShaderModule){
-	deleteShaderModule(device, pShaderModule);
+//modules are owned by the cache and shared between every pipeline built from the same spir-v
+VkShaderModule getShader(const VkDevice device, shaderCache *pCache, const char *fileName){
+	shaderBlob blob;
+	if(!loadShaderBlob(fileName, &blob)){
+		printf("failed to open shader %s!\n", fileName);
+		return VK_NULL_HANDLE;
+	}
+	if(blob.size % sizeof(uint32_t) != 0){
+		printf("shader %s is not valid spir-v!\n", fileName);
+		releaseShaderBlob(&blob);
+		return VK_NULL_HANDLE;
+	}
+
+	uint64_t hash = hashBytes(blob.code, blob.size, HASHSEED);
+	cthreads_mutex_lock(&pCache->mutex);
+	cachedShader *shaders = pCache->shaders.array;
+	for(int i = 0; i < pCache->shaders.n; i++){
+		if(shaders[i].hash == hash && shaders[i].size == blob.size){
+			VkShaderModule shaderModule = shaders[i].module;
+			cthreads_mutex_unlock(&pCache->mutex);
+			releaseShaderBlob(&blob);
+			return shaderModule;
+		}
+	}
+
+	cachedShader shader = {hash, blob.size, createShaderModule(device, blob.code, blob.size)};
+	if(shader.module != VK_NULL_HANDLE){
+		vectorAdd(&pCache->shaders, &shader);
+	}
+	cthreads_mutex_unlock(&pCache->mutex);
+	releaseShaderBlob(&blob);
+	if(shader.module == VK_NULL_HANDLE){
+		printf("failed to create shader module for %s!\n", fileName);
+	}
+	return shader.module;
 }
@@ -0,0 +1,272 @@
+#include "vk_fun.h"
+
+#define SHADOWNEAR 0.05f // near plane of the atlas faces
+#define SHADOWNOFACE 0xffffffffu
+
+static const float faceDirections[6][3] = {{1.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, -1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, -1.0f}};
+static const float faceUps[6][3] = {{0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 1.0f, 0.0f}};
+
+static uint32_t tileSize(const shadowAtlas *pAtlas, const uint32_t level){
+	return pAtlas->pass.size >> level;
+}
+
+static mappedBuffer createShadowBuffer(const VkDevice device, const VkPhysicalDevice physicalDevice, const VkDeviceSize size){
+	mappedBuffer buffer;
+	buffer.buffer = createBuffer(device, physicalDevice, (uint32_t)size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	vkMapMemory(device, buffer.buffer.memory, 0, size, 0, &buffer.pMappedData);
+	return buffer;
+}
+
+//the casters are the first lights of the cluster list, without any the atlas is a single tile kept for the descriptor
+shadowAtlas createShadowAtlas(const VkDevice device, const VkPhysicalDevice physicalDevice, const VkFormat depthFormat, const uint32_t frameNum, const uint32_t casterNum, const VkCommandPool commandPool, const VkQueue drawingQueue){
+	shadowAtlas atlas = {.casterNum = casterNum, .frameNum = frameNum};
+	VkPhysicalDeviceFeatures features;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+	if(casterNum > 0 && features.shaderClipDistance != VK_TRUE){
+		printf("shadow atlas: no clip distances to keep the faces inside their tiles, lights stay unshadowed\n");
+		atlas.casterNum = 0;
+	}
+	atlas.pass = createShadowAtlasPass(device, physicalDevice, depthFormat, atlas.casterNum > 0 ? SHADOWATLASSIZE : SHADOWTILEMIN, commandPool, drawingQueue);
+
+	atlas.casters = malloc((atlas.casterNum > 0 ? atlas.casterNum : 1) * sizeof(shadowCaster));
+	atlas.records = calloc(atlas.casterNum > 0 ? atlas.casterNum : 1, sizeof(shadowRecord));
+	for(uint32_t i = 0; i < atlas.casterNum; i++){
+		atlas.casters[i] = (shadowCaster){.level = SHADOWLEVELNUM, .age = 0, .influence = 0.0f};
+	}
+	//every node of a level can be free at once
+	for(uint32_t level = 0; level < SHADOWLEVELNUM; level++){
+		atlas.freeTiles[level] = malloc(((size_t)1 << (2 * level)) * sizeof(shadowTile));
+		atlas.freeNum[level] = 0;
+	}
+	if(atlas.casterNum > 0){
+		atlas.freeTiles[0][atlas.freeNum[0]++] = (shadowTile){0, 0};
+	}
+
+	atlas.shadows = malloc(frameNum * sizeof(mappedBuffer));
+	atlas.slots = malloc(frameNum * sizeof(mappedBuffer));
+	const VkDeviceSize shadowSize = 4 * sizeof(uint32_t) + (atlas.casterNum > 0 ? atlas.casterNum : 1) * sizeof(shadowRecord);
+	for(uint32_t i = 0; i < frameNum; i++){
+		atlas.shadows[i] = createShadowBuffer(device, physicalDevice, shadowSize);
+		atlas.slots[i] = createShadowBuffer(device, physicalDevice, SHADOWFACEBUDGET * sizeof(uint32_t));
+		memset(atlas.shadows[i].pMappedData, 0, shadowSize);
+		memset(atlas.slots[i].pMappedData, 0xff, SHADOWFACEBUDGET * sizeof(uint32_t));
+	}
+	if(atlas.casterNum > 0){
+		printf("shadow atlas: %u shadow casting lights, %ux%u atlas, %u to %u texel faces, %u faces per frame\n", atlas.casterNum, SHADOWATLASSIZE, SHADOWATLASSIZE, SHADOWTILEMIN, SHADOWTILEMAX, SHADOWFACEBUDGET);
+	}
+	return atlas;
+}
+
+void deleteShadowAtlas(const VkDevice device, shadowAtlas *pAtlas){
+	deleteMappedBuffers(device, pAtlas->shadows, pAtlas->frameNum);
+	deleteMappedBuffers(device, pAtlas->slots, pAtlas->frameNum);
+	for(uint32_t level = 0; level < SHADOWLEVELNUM; level++){
+		free(pAtlas->freeTiles[level]);
+	}
+	free(pAtlas->casters);
+	free(pAtlas->records);
+	deleteShadowAtlasPass(device, &pAtlas->pass);
+}
+
+//splits a larger node when the level has nothing free
+static bool allocateTile(shadowAtlas *pAtlas, const uint32_t level, shadowTile *pTile){
+	if(pAtlas->freeNum[level] > 0){
+		*pTile = pAtlas->freeTiles[level][--pAtlas->freeNum[level]];
+		return true;
+	}
+	shadowTile parent;
+	if(level == 0 || !allocateTile(pAtlas, level - 1, &parent)){
+		return false;
+	}
+	const uint16_t size = (uint16_t)tileSize(pAtlas, level);
+	pAtlas->freeTiles[level][pAtlas->freeNum[level]++] = (shadowTile){parent.x + size, parent.y};
+	pAtlas->freeTiles[level][pAtlas->freeNum[level]++] = (shadowTile){parent.x, parent.y + size};
+	pAtlas->freeTiles[level][pAtlas->freeNum[level]++] = (shadowTile){parent.x + size, parent.y + size};
+	*pTile = parent;
+	return true;
+}
+
+//merges the tile with its three siblings into their parent when they are all free
+static void releaseTile(shadowAtlas *pAtlas, const uint32_t level, const shadowTile tile){
+	if(level > 0){
+		const uint16_t parentSize = (uint16_t)tileSize(pAtlas, level - 1);
+		const shadowTile parent = {tile.x - tile.x % parentSize, tile.y - tile.y % parentSize};
+		uint32_t siblings[3];
+		uint32_t siblingNum = 0;
+		for(uint32_t i = 0; i < pAtlas->freeNum[level] && siblingNum < 3; i++){
+			const shadowTile free = pAtlas->freeTiles[level][i];
+			if(free.x - free.x % parentSize == parent.x && free.y - free.y % parentSize == parent.y){
+				siblings[siblingNum++] = i;
+			}
+		}
+		if(siblingNum == 3){
+			//highest index first so the swaps with the last entry do not move the others
+			for(int32_t i = 2; i >= 0; i--){
+				pAtlas->freeTiles[level][siblings[i]] = pAtlas->freeTiles[level][--pAtlas->freeNum[level]];
+			}
+			releaseTile(pAtlas, level - 1, parent);
+			return;
+		}
+	}
+	pAtlas->freeTiles[level][pAtlas->freeNum[level]++] = tile;
+}
+
+static void releaseCaster(shadowAtlas *pAtlas, const uint32_t caster){
+	shadowCaster *pCaster = &pAtlas->casters[caster];
+	if(pCaster->level == SHADOWLEVELNUM){
+		return;
+	}
+	for(uint32_t face = 0; face < 6; face++){
+		releaseTile(pAtlas, pCaster->level, pCaster->tiles[face]);
+		pAtlas->records[caster].faces[face].rect[3] = 0.0f;
+	}
+	pCaster->level = SHADOWLEVELNUM;
+}
+
+//all six faces or none
+static bool allocateCaster(shadowAtlas *pAtlas, const uint32_t caster, const uint32_t level){
+	shadowCaster *pCaster = &pAtlas->casters[caster];
+	for(uint32_t face = 0; face < 6; face++){
+		if(!allocateTile(pAtlas, level, &pCaster->tiles[face])){
+			while(face-- > 0){
+				releaseTile(pAtlas, level, pCaster->tiles[face]);
+			}
+			return false;
+		}
+	}
+	pCaster->level = level;
+	return true;
+}
+
+//the finest level the light's screen radius asks for, between SHADOWTILEMAX and SHADOWTILEMIN texels
+static uint32_t desiredLevel(const shadowAtlas *pAtlas, const float influence){
+	uint32_t level = 0;
+	while(tileSize(pAtlas, level) > SHADOWTILEMAX){
+		level++;
+	}
+	while(level + 1 < SHADOWLEVELNUM && tileSize(pAtlas, level + 1) >= influence){
+		level++;
+	}
+	return level;
+}
+
+//gives the caster tiles at its level or coarser ones, taking them from the least influential casters not updated this frame when the atlas is full
+static bool placeCaster(shadowAtlas *pAtlas, const uint32_t caster, const bool *updated){
+	const uint32_t wanted = desiredLevel(pAtlas, pAtlas->casters[caster].influence);
+	if(pAtlas->casters[caster].level == wanted){
+		return true;
+	}
+	releaseCaster(pAtlas, caster);
+	for(;;){
+		for(uint32_t level = wanted; level < SHADOWLEVELNUM; level++){
+			if(allocateCaster(pAtlas, caster, level)){
+				return true;
+			}
+		}
+		uint32_t victim = pAtlas->casterNum;
+		for(uint32_t i = 0; i < pAtlas->casterNum; i++){
+			if(!updated[i] && pAtlas->casters[i].level < SHADOWLEVELNUM && (victim == pAtlas->casterNum || pAtlas->casters[i].influence < pAtlas->casters[victim].influence)){
+				victim = i;
+			}
+		}
+		if(victim == pAtlas->casterNum || pAtlas->casters[victim].influence >= pAtlas->casters[caster].influence){
+			return false;
+		}
+		releaseCaster(pAtlas, victim);
+		pAtlas->evictions++;
+	}
+}
+
+//screen radius in pixels, zero once the light's sphere is behind the camera
+static float lightInfluence(const pointLight *pLight, const float view[4][4], const float proj[4][4], const VkExtent2D extent){
+	float depth = -(view[0][2] * pLight->pos[0] + view[1][2] * pLight->pos[1] + view[2][2] * pLight->pos[2] + view[3][2]);
+	if(depth + pLight->radius <= 0.0f){
+		return 0.0f;
+	}
+	float distance = depth > pLight->radius ? depth : pLight->radius;
+	return pLight->radius / distance * fabsf(proj[1][1]) * 0.5f * extent.height;
+}
+
+static void renderCaster(shadowAtlas *pAtlas, const uint32_t caster, const pointLight *pLight){
+	shadowRecord *pRecord = &pAtlas->records[caster];
+	const shadowCaster *pCaster = &pAtlas->casters[caster];
+	float proj[4][4];
+	mat4_perspective(proj, radians(90.0f), 1.0f, SHADOWNEAR, pLight->radius);
+	for(uint32_t face = 0; face < 6; face++){
+		float view[4][4];
+		const float target[3] = {pLight->pos[0] + faceDirections[face][0], pLight->pos[1] + faceDirections[face][1], pLight->pos[2] + faceDirections[face][2]};
+		mat4_lookat(view, pLight->pos, target, faceUps[face]);
+		mat4_multiply(pRecord->faces[face].viewProj, (const float(*)[4])view, (const float(*)[4])proj);
+		pRecord->faces[face].rect[0] = pCaster->tiles[face].x / (float)pAtlas->pass.size;
+		pRecord->faces[face].rect[1] = pCaster->tiles[face].y / (float)pAtlas->pass.size;
+		pRecord->faces[face].rect[2] = tileSize(pAtlas, pCaster->level) / (float)pAtlas->pass.size;
+		pRecord->faces[face].rect[3] = 1.0f;
+	}
+	memcpy(pRecord->posFar, pLight->pos, sizeof(pLight->pos));
+	pRecord->posFar[3] = pLight->radius;
+}
+
+static void reportShadowAtlas(shadowAtlas *pAtlas){
+	uint32_t unshadowed = 0;
+	for(uint32_t i = 0; i < pAtlas->casterNum; i++){
+		unshadowed += pAtlas->casters[i].level == SHADOWLEVELNUM && pAtlas->casters[i].influence > 0.0f;
+	}
+	pAtlas->unshadowedMax = unshadowed > pAtlas->unshadowedMax ? unshadowed : pAtlas->unshadowedMax;
+	if(++pAtlas->framesSinceReport < SHADOWREPORTINTERVAL){
+		return;
+	}
+	printf("shadow atlas over %u frames: %.1f faces rendered per frame, %u evictions, at most %u visible lights without tiles\n",
+		SHADOWREPORTINTERVAL, pAtlas->faceSum / (double)SHADOWREPORTINTERVAL, pAtlas->evictions, pAtlas->unshadowedMax);
+	pAtlas->faceSum = 0;
+	pAtlas->evictions = 0;
+	pAtlas->unshadowedMax = 0;
+	pAtlas->framesSinceReport = 0;
+}
+
+//picks the lights re-rendered this frame by screen influence times frames since their last update, lights without tiles first
+void updateShadowAtlas(shadowAtlas *pAtlas, const uint32_t frame, const pointLight *lights, const float view[4][4], const float proj[4][4], const VkExtent2D extent){
+	if(pAtlas->casterNum == 0){
+		return;
+	}
+	bool updated[SHADOWLIGHTMAX] = {false};
+	float priority[SHADOWLIGHTMAX];
+	for(uint32_t i = 0; i < pAtlas->casterNum; i++){
+		shadowCaster *pCaster = &pAtlas->casters[i];
+		pCaster->influence = lightInfluence(&lights[i], view, proj, extent);
+		pCaster->age++;
+		priority[i] = pCaster->influence * pCaster->age * (pCaster->level == SHADOWLEVELNUM ? (float)SHADOWLIGHTMAX : 1.0f);
+	}
+
+	uint32_t *slots = pAtlas->slots[frame].pMappedData;
+	uint32_t faceNum = 0;
+	while(faceNum + 6 <= SHADOWFACEBUDGET){
+		uint32_t best = pAtlas->casterNum;
+		for(uint32_t i = 0; i < pAtlas->casterNum; i++){
+			if(!updated[i] && priority[i] > 0.0f && (best == pAtlas->casterNum || priority[i] > priority[best])){
+				best = i;
+			}
+		}
+		if(best == pAtlas->casterNum){
+			break;
+		}
+		updated[best] = true;
+		if(!placeCaster(pAtlas, best, updated)){
+			continue;
+		}
+		renderCaster(pAtlas, best, &lights[best]);
+		pAtlas->casters[best].age = 0;
+		for(uint32_t face = 0; face < 6; face++){
+			slots[faceNum++] = best * 6 + face;
+		}
+	}
+	for(uint32_t slot = faceNum; slot < SHADOWFACEBUDGET; slot++){
+		slots[slot] = SHADOWNOFACE;
+	}
+
+	uint32_t *info = pAtlas->shadows[frame].pMappedData;
+	info[0] = pAtlas->casterNum;
+	info[1] = pAtlas->pass.size;
+	memcpy(info + 4, pAtlas->records, pAtlas->casterNum * sizeof(shadowRecord));
+	pAtlas->faceSum += faceNum;
+	reportShadowAtlas(pAtlas);
+}
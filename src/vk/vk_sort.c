@@ -0,0 +1,186 @@
+#include "vk_fun.h"
+
+#define DRAWKEYDEPTHSHIFT DRAWKEYINDEXBITS
+#define DRAWKEYMATERIALSHIFT (DRAWKEYDEPTHSHIFT + DRAWKEYDEPTHBITS)
+#define DRAWKEYPIPELINESHIFT (DRAWKEYMATERIALSHIFT + DRAWKEYMATERIALBITS)
+#define DRAWKEYPASSSHIFT (DRAWKEYPIPELINESHIFT + DRAWKEYPIPELINEBITS)
+#define DRAWSORTBUCKETNUM (1u << DRAWSORTDIGITBITS)
+#define FIELDMASK(bits) ((1ull << (bits)) - 1)
+
+drawQueue createDrawQueue(const float near, const float far){
+	drawQueue queue = {
+		.keys = malloc(64 * sizeof(uint64_t)),
+		.scratch = malloc(64 * sizeof(uint64_t)),
+		.commands = malloc(64 * sizeof(drawCommand)),
+		.capacity = 64,
+		.near = near,
+		.far = far
+	};
+	return queue;
+}
+
+void deleteDrawQueue(drawQueue *pQueue){
+	free(pQueue->keys);
+	free(pQueue->scratch);
+	free(pQueue->commands);
+	pQueue->keys = NULL;
+	pQueue->scratch = NULL;
+	pQueue->commands = NULL;
+	pQueue->drawNum = 0;
+	pQueue->capacity = 0;
+}
+
+void resetDrawQueue(drawQueue *pQueue){
+	pQueue->drawNum = 0;
+}
+
+//depths outside the camera planes share the first or last step
+static uint64_t quantizeDepth(const float depth, const float near, const float far){
+	float t = (depth - near) / (far - near);
+	t = t < 0.0f ? 0.0f : t > 1.0f ? 1.0f : t;
+	return (uint64_t)(t * FIELDMASK(DRAWKEYDEPTHBITS));
+}
+
+//the most significant field decides first, so draws group by pass, then pipeline, then material and are nearest first inside a group
+void addDraw(drawQueue *pQueue, const uint32_t pass, const drawPipeline pipeline, const uint32_t material, const float depth, const drawCommand command){
+	if(pQueue->drawNum == DRAWQUEUEMAX){
+		printf("more than %u draws queued in a frame\n", DRAWQUEUEMAX);
+		exit(EXIT_FAILURE);
+	}
+	if(pQueue->drawNum == pQueue->capacity){
+		pQueue->capacity *= 2;
+		pQueue->keys = realloc(pQueue->keys, pQueue->capacity * sizeof(uint64_t));
+		pQueue->scratch = realloc(pQueue->scratch, pQueue->capacity * sizeof(uint64_t));
+		pQueue->commands = realloc(pQueue->commands, pQueue->capacity * sizeof(drawCommand));
+	}
+	const uint32_t draw = pQueue->drawNum++;
+	pQueue->commands[draw] = command;
+	pQueue->keys[draw] = ((uint64_t)pass & FIELDMASK(DRAWKEYPASSBITS)) << DRAWKEYPASSSHIFT
+		| ((uint64_t)pipeline & FIELDMASK(DRAWKEYPIPELINEBITS)) << DRAWKEYPIPELINESHIFT
+		| ((uint64_t)material & FIELDMASK(DRAWKEYMATERIALBITS)) << DRAWKEYMATERIALSHIFT
+		| quantizeDepth(depth, pQueue->near, pQueue->far) << DRAWKEYDEPTHSHIFT
+		| draw;
+}
+
+//least significant digit first over the bits above the draw index, the sorted keys end up in either array
+uint64_t *sortDrawKeys(uint64_t *keys, uint64_t *scratch, const uint32_t keyNum){
+	if(keyNum < 2){
+		return keys;
+	}
+	//one read for every digit's histogram
+	uint32_t histograms[DRAWSORTDIGITNUM][DRAWSORTBUCKETNUM];
+	memset(histograms, 0, sizeof(histograms));
+	for(uint32_t i = 0; i < keyNum; i++){
+		const uint64_t key = keys[i] >> DRAWKEYINDEXBITS;
+		for(uint32_t digit = 0; digit < DRAWSORTDIGITNUM; digit++){
+			histograms[digit][(key >> (digit * DRAWSORTDIGITBITS)) & (DRAWSORTBUCKETNUM - 1)]++;
+		}
+	}
+
+	uint64_t *source = keys;
+	uint64_t *target = scratch;
+	for(uint32_t digit = 0; digit < DRAWSORTDIGITNUM; digit++){
+		const uint32_t shift = DRAWKEYINDEXBITS + digit * DRAWSORTDIGITBITS;
+		uint32_t *histogram = histograms[digit];
+		//a digit every key shares would only copy, a pass and pipeline per queue is the common case
+		if(histogram[(source[0] >> shift) & (DRAWSORTBUCKETNUM - 1)] == keyNum){
+			continue;
+		}
+		uint32_t offset = 0;
+		for(uint32_t bucket = 0; bucket < DRAWSORTBUCKETNUM; bucket++){
+			const uint32_t count = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += count;
+		}
+		for(uint32_t i = 0; i < keyNum; i++){
+			target[histogram[(source[i] >> shift) & (DRAWSORTBUCKETNUM - 1)]++] = source[i];
+		}
+		uint64_t *swap = source;
+		source = target;
+		target = swap;
+	}
+	return source;
+}
+
+void sortDrawQueue(drawQueue *pQueue){
+	uint64_t *sorted = sortDrawKeys(pQueue->keys, pQueue->scratch, pQueue->drawNum);
+	if(sorted != pQueue->keys){
+		pQueue->scratch = pQueue->keys;
+		pQueue->keys = sorted;
+	}
+	//the emitted order, depth changes that keep it leave the recorded commands valid
+	uint64_t hash = HASHSEED;
+	for(uint32_t draw = 0; draw < pQueue->drawNum; draw++){
+		const uint64_t key = pQueue->keys[draw];
+		const uint64_t emitted[2] = {key >> DRAWKEYPIPELINESHIFT, key & FIELDMASK(DRAWKEYINDEXBITS)};
+		hash = hashBytes(emitted, sizeof(emitted), hash);
+		hash = hashBytes(&pQueue->commands[emitted[1]], sizeof(drawCommand), hash);
+	}
+	pQueue->orderHash = hash;
+}
+
+drawPipeline getDrawKeyPipeline(const uint64_t key){
+	return (drawPipeline)((key >> DRAWKEYPIPELINESHIFT) & FIELDMASK(DRAWKEYPIPELINEBITS));
+}
+
+//after sortDrawQueue, the draw-th command in sorted order
+drawCommand getSortedDraw(const drawQueue *pQueue, const uint32_t draw){
+	return pQueue->commands[pQueue->keys[draw] & FIELDMASK(DRAWKEYINDEXBITS)];
+}
+
+static int compareKeys(const void *a, const void *b){
+	const uint64_t x = *(const uint64_t *)a;
+	const uint64_t y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+//every pass, a few pipelines and materials and random depths, like a frame of individually drawn objects
+static void createBenchmarkKeys(drawQueue *pQueue, const uint32_t keyNum){
+	uint32_t seed = 12345u;
+	resetDrawQueue(pQueue);
+	for(uint32_t i = 0; i < keyNum; i++){
+		uint32_t r[4];
+		for(uint32_t j = 0; j < 4; j++){
+			seed = seed * 1664525u + 1013904223u;
+			r[j] = seed >> 8;
+		}
+		addDraw(pQueue, r[0] % RECORDPASSNUM, (drawPipeline)(r[1] % 4), r[2] % 64, pQueue->near + (pQueue->far - pQueue->near) * (r[3] / (float)(1u << 24)), (drawCommand){i, 36});
+	}
+}
+
+//average radix and qsort times per key count, with the radix order checked against the qsort one
+void benchmarkDrawSort(){
+	const uint32_t keyNums[] = {10000, 100000, 1000000};
+	drawQueue queue = createDrawQueue(0.1f, 50.0f);
+	for(uint32_t size = 0; size < sizeof(keyNums) / sizeof(keyNums[0]); size++){
+		const uint32_t keyNum = keyNums[size];
+		createBenchmarkKeys(&queue, keyNum);
+		uint64_t *unsorted = malloc(keyNum * sizeof(uint64_t));
+		uint64_t *reference = malloc(keyNum * sizeof(uint64_t));
+		memcpy(unsorted, queue.keys, keyNum * sizeof(uint64_t));
+
+		double radixTime = 0.0;
+		uint64_t *sorted = NULL;
+		for(uint32_t run = 0; run < DRAWSORTBENCHMARKRUNS; run++){
+			memcpy(queue.keys, unsorted, keyNum * sizeof(uint64_t));
+			tick_t start = timer_current();
+			sorted = sortDrawKeys(queue.keys, queue.scratch, keyNum);
+			radixTime += timer_ticks_to_seconds(timer_elapsed_ticks(start)) * 1000.0;
+		}
+		double qsortTime = 0.0;
+		for(uint32_t run = 0; run < DRAWSORTBENCHMARKRUNS; run++){
+			memcpy(reference, unsorted, keyNum * sizeof(uint64_t));
+			tick_t start = timer_current();
+			qsort(reference, keyNum, sizeof(uint64_t), compareKeys);
+			qsortTime += timer_ticks_to_seconds(timer_elapsed_ticks(start)) * 1000.0;
+		}
+		const bool match = memcmp(sorted, reference, keyNum * sizeof(uint64_t)) == 0;
+		radixTime /= DRAWSORTBENCHMARKRUNS;
+		qsortTime /= DRAWSORTBENCHMARKRUNS;
+		printf("draw sort of %u keys: radix %.3f ms (%.1f Mkeys/s), qsort %.3f ms, %s\n",
+			keyNum, radixTime, keyNum / (radixTime * 1000.0), qsortTime, match ? "same order" : "ORDER MISMATCH");
+		free(unsorted);
+		free(reference);
+	}
+	deleteDrawQueue(&queue);
+}
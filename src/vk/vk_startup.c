@@ -0,0 +1,129 @@
+#include "vk_fun.h"
+
+void initStartupGraph(startupGraph *pGraph){
+	pGraph->taskNum = 0;
+	pGraph->finishedNum = 0;
+	pGraph->origin = timer_current();
+	cthreads_mutex_init(&pGraph->mutex, NULL);
+	cthreads_cond_init(&pGraph->changed, NULL);
+}
+
+void deleteStartupGraph(startupGraph *pGraph){
+	cthreads_mutex_destroy(&pGraph->mutex);
+	cthreads_cond_destroy(&pGraph->changed);
+}
+
+//dependencies is a mask of the indices returned by earlier calls
+uint32_t addStartupTask(startupGraph *pGraph, const char *name, const startupFunction run, void *data, const uint32_t dependencies){
+	if(pGraph->taskNum >= STARTUPTASKMAX){
+		printf("too many startup tasks, raise STARTUPTASKMAX\n");
+		exit(EXIT_FAILURE);
+	}
+	pGraph->tasks[pGraph->taskNum] = (startupTask){name, run, data, dependencies, false, false, 0, 0, 0};
+	return pGraph->taskNum++;
+}
+
+//runs a step on the calling thread right away, it still shows up in the timeline
+void runStartupTaskNow(startupGraph *pGraph, const char *name, const startupFunction run, void *data){
+	uint32_t index = addStartupTask(pGraph, name, run, data, 0);
+	startupTask *pTask = &pGraph->tasks[index];
+	pTask->started = true;
+	pTask->start = timer_current();
+	run(data);
+	pTask->end = timer_current();
+	pTask->finished = true;
+	pGraph->finishedNum++;
+}
+
+static uint32_t getFinishedMask(const startupGraph *pGraph){
+	uint32_t mask = 0;
+	for(uint32_t i = 0; i < pGraph->taskNum; i++){
+		if(pGraph->tasks[i].finished){
+			mask |= 1u << i;
+		}
+	}
+	return mask;
+}
+
+//takes the first task whose dependencies are done, in insertion order, so earlier tasks get the threads first
+static startupTask *takeReadyTask(startupGraph *pGraph){
+	uint32_t finished = getFinishedMask(pGraph);
+	for(uint32_t i = 0; i < pGraph->taskNum; i++){
+		startupTask *pTask = &pGraph->tasks[i];
+		if(!pTask->started && (pTask->dependencies & finished) == pTask->dependencies){
+			pTask->started = true;
+			return pTask;
+		}
+	}
+	return NULL;
+}
+
+static void runStartupTasks(startupGraph *pGraph, const uint32_t threadIndex){
+	cthreads_mutex_lock(&pGraph->mutex);
+	while(pGraph->finishedNum < pGraph->taskNum){
+		startupTask *pTask = takeReadyTask(pGraph);
+		if(pTask == NULL){
+			cthreads_cond_wait(&pGraph->changed, &pGraph->mutex);
+			continue;
+		}
+		cthreads_mutex_unlock(&pGraph->mutex);
+
+		pTask->thread = threadIndex;
+		pTask->start = timer_current();
+		pTask->run(pTask->data);
+		pTask->end = timer_current();
+
+		cthreads_mutex_lock(&pGraph->mutex);
+		pTask->finished = true;
+		pGraph->finishedNum++;
+		cthreads_cond_broadcast(&pGraph->changed);
+	}
+	cthreads_mutex_unlock(&pGraph->mutex);
+}
+
+static void *startupWorkerThread(void *arg){
+	startupWorker *pWorker = (startupWorker *)arg;
+	runStartupTasks(pWorker->pGraph, pWorker->index);
+	return NULL;
+}
+
+//returns once every added task has finished, the calling thread works as thread 0
+void runStartupGraph(startupGraph *pGraph, const uint32_t threadNum){
+	for(uint32_t i = 0; i < pGraph->taskNum; i++){
+		if(pGraph->tasks[i].dependencies >> i != 0){
+			printf("startup task %s depends on a later task\n", pGraph->tasks[i].name);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	startupWorker *workers = malloc(threadNum * sizeof(startupWorker));
+	for(uint32_t thread = 1; thread < threadNum; thread++){
+		workers[thread].pGraph = pGraph;
+		workers[thread].index = thread;
+		if(cthreads_thread_create(&workers[thread].thread, NULL, startupWorkerThread, &workers[thread], &workers[thread].args) != 0){
+			printf("failed to create startup thread %u\n", thread);
+			exit(EXIT_FAILURE);
+		}
+	}
+	runStartupTasks(pGraph, 0);
+	for(uint32_t thread = 1; thread < threadNum; thread++){
+		cthreads_thread_join(workers[thread].thread, NULL);
+	}
+	free(workers);
+}
+
+void printStartupTimeline(const startupGraph *pGraph){
+	tick_t end = pGraph->origin;
+	printf("startup timeline (ms since start, duration, thread):\n");
+	for(uint32_t i = 0; i < pGraph->taskNum; i++){
+		const startupTask *pTask = &pGraph->tasks[i];
+		printf("  %-20s %8.2f %8.2f  %u\n", pTask->name,
+			timer_ticks_to_seconds(pTask->start - pGraph->origin) * 1000.0,
+			timer_ticks_to_seconds(pTask->end - pTask->start) * 1000.0,
+			pTask->thread);
+		if(pTask->end > end){
+			end = pTask->end;
+		}
+	}
+	printf("startup total: %.2f ms\n", timer_ticks_to_seconds(end - pGraph->origin) * 1000.0);
+}
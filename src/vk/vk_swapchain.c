@@ -36,7 +36,12 @@ static void deleteImageViews(const VkDevice device, VkImageView *ImageViews, con
 	free(ImageViews);
 }
 
-static VkSwapchainKHR createSwapChain(const VkDevice device, const VkSurfaceKHR surface, const VkSurfaceCapabilitiesKHR surfaceCapabilities, const VkSurfaceFormatKHR surfaceFormat, const VkExtent2D extent, const VkPresentModeKHR presentMode, const uint32_t imageArrayLayers, const uint32_t graphicsQueueMode){
+static VkSwapchainKHR createSwapChain(const VkDevice device, const VkSurfaceKHR surface, const VkSurfaceCapabilitiesKHR surfaceCapabilities, const VkSurfaceFormatKHR surfaceFormat, const VkExtent2D extent, const VkPresentModeKHR presentMode, const uint32_t minImageCount, const uint32_t imageArrayLayers, const uint32_t graphicsQueueMode, const VkSwapchainKHR oldSwapchain){
+	//the scene is blitted into the swapchain image instead of rendered to it
+	if((surfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) == 0){
+		printf("swapchain images do not support transfer writes!\n");
+		exit(EXIT_FAILURE);
+	}
 	VkSharingMode imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
 	uint32_t queueFamilyIndexCount = 0, *pQueueFamilyIndices = VK_NULL_HANDLE;
 	uint32_t queueFamilyIndices[] = {0, 1};
@@ -51,12 +56,12 @@ static VkSwapchainKHR createSwapChain(const VkDevice device, const VkSurfaceKHR
 		.pNext = VK_NULL_HANDLE,
 		.flags = 0,
 		.surface = surface,
-		.minImageCount = surfaceCapabilities.minImageCount,
+		.minImageCount = minImageCount,
 		.imageFormat = surfaceFormat.format,
 		.imageColorSpace = surfaceFormat.colorSpace,
 		.imageExtent = extent,
 		.imageArrayLayers = imageArrayLayers,
-		.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+		.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
 		.imageSharingMode = imageSharingMode,
 		.queueFamilyIndexCount = queueFamilyIndexCount,
 		.pQueueFamilyIndices = pQueueFamilyIndices,
@@ -64,11 +69,14 @@ static VkSwapchainKHR createSwapChain(const VkDevice device, const VkSurfaceKHR
 		.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
 		.presentMode = presentMode,
 		.clipped = VK_TRUE,
-		.oldSwapchain = VK_NULL_HANDLE
+		.oldSwapchain = oldSwapchain
 	};
 
 	VkSwapchainKHR swapchain;
-	vkCreateSwapchainKHR(device, &swapchainCreateInfo, VK_NULL_HANDLE, &swapchain);
+	if(vkCreateSwapchainKHR(device, &swapchainCreateInfo, VK_NULL_HANDLE, &swapchain) != VK_SUCCESS){
+		printf("failed to create swap chain!\n");
+		exit(EXIT_FAILURE);
+	}
 	return swapchain;
 }
 
@@ -93,17 +101,39 @@ static VkSurfaceFormatKHR getBestSurfaceFormat(const VkSurfaceKHR surface, const
 	return bestSurfaceFormat;
 }
 
-static VkPresentModeKHR getBestPresentMode(const VkSurfaceKHR surface, const VkPhysicalDevice physicalDevice){
+static bool presentModeSupported(const VkPresentModeKHR *presentModes, const uint32_t presentModeNumber, const VkPresentModeKHR presentMode){
+	for(uint32_t i = 0; i < presentModeNumber; i++){
+		if(presentModes[i] == presentMode){
+			return true;
+		}
+	}
+	return false;
+}
+
+static VkPresentModeKHR getBestPresentMode(const VkSurfaceKHR surface, const VkPhysicalDevice physicalDevice, const latencyModes latencyMode){
 	uint32_t presentModeNumber = 0;
 	vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeNumber, VK_NULL_HANDLE);
 	VkPresentModeKHR *presentModes = (VkPresentModeKHR *)malloc(presentModeNumber * sizeof(VkPresentModeKHR));
 	vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeNumber, presentModes);
 
-	VkPresentModeKHR bestPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+	//preferred modes per latency policy, FIFO is always supported
+	static const VkPresentModeKHR lowest[] = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR};
+	static const VkPresentModeKHR balanced[] = {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR};
+	const VkPresentModeKHR *preferred = VK_NULL_HANDLE;
+	uint32_t preferredNumber = 0;
+	if(latencyMode == LATENCY_LOWEST){
+		preferred = lowest;
+		preferredNumber = sizeof(lowest) / sizeof(lowest[0]);
+	}else if(latencyMode == LATENCY_BALANCED){
+		preferred = balanced;
+		preferredNumber = sizeof(balanced) / sizeof(balanced[0]);
+	}
 
-	for(uint32_t i = 0; i < presentModeNumber; i++){
-		if(presentModes[i] == VK_PRESENT_MODE_MAILBOX_KHR){
-			bestPresentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+	VkPresentModeKHR bestPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+	for(uint32_t i = 0; i < preferredNumber; i++){
+		if(presentModeSupported(presentModes, presentModeNumber, preferred[i])){
+			bestPresentMode = preferred[i];
+			break;
 		}
 	}
 
@@ -111,6 +141,28 @@ static VkPresentModeKHR getBestPresentMode(const VkSurfaceKHR surface, const VkP
 	return bestPresentMode;
 }
 
+//mailbox needs a third image to never block, the other modes queue less with fewer images
+static uint32_t getSwapchainMinImageCount(const VkSurfaceCapabilitiesKHR surfaceCapabilities, const VkPresentModeKHR presentMode, const latencyModes latencyMode){
+	uint32_t imageCount = surfaceCapabilities.minImageCount;
+	if(presentMode == VK_PRESENT_MODE_MAILBOX_KHR || (latencyMode == LATENCY_BALANCED && presentMode != VK_PRESENT_MODE_IMMEDIATE_KHR)){
+		imageCount = imageCount < 3 ? 3 : imageCount;
+	}
+	if(surfaceCapabilities.maxImageCount > 0 && imageCount > surfaceCapabilities.maxImageCount){
+		imageCount = surfaceCapabilities.maxImageCount;
+	}
+	return imageCount;
+}
+
+static const char *getPresentModeName(const VkPresentModeKHR presentMode){
+	switch(presentMode){
+	case VK_PRESENT_MODE_IMMEDIATE_KHR: return "IMMEDIATE";
+	case VK_PRESENT_MODE_MAILBOX_KHR: return "MAILBOX";
+	case VK_PRESENT_MODE_FIFO_KHR: return "FIFO";
+	case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "FIFO_RELAXED";
+	default: return "UNKNOWN";
+	}
+}
+
 static VkExtent2D getBestSwapchainExtent(const VkSurfaceCapabilitiesKHR surfaceCapabilities, const int FramebufferWidth, const int FramebufferHeight){
 
 	VkExtent2D bestSwapchainExtent;
@@ -130,17 +182,18 @@ static VkExtent2D getBestSwapchainExtent(const VkSurfaceCapabilitiesKHR surfaceC
 	return bestSwapchainExtent;
 }
 
-swapchainAttachment createSwapchainAttachment(const VkDevice device, const VkPhysicalDevice physicalDevice, const VkSurfaceKHR surface, GLFWwindow *pWindow, const uint32_t imageArrayLayers, const uint32_t graphicsQueueMode){
+//framebufferExtent comes from the main thread, glfw window queries are not allowed on the rendering thread
+swapchainAttachment createSwapchainAttachment(const VkDevice device, const VkPhysicalDevice physicalDevice, const VkSurfaceKHR surface, const VkExtent2D framebufferExtent, const uint32_t imageArrayLayers, const uint32_t graphicsQueueMode, const VkSwapchainKHR oldSwapchain, const latencyModes latencyMode){
 	swapchainAttachment attachment;
-	VkPresentModeKHR presentMode = getBestPresentMode(surface, physicalDevice);
-	int FramebufferWidth = 0, FramebufferHeight = 0;
-	glfwGetFramebufferSize(pWindow, &FramebufferWidth, &FramebufferHeight);
 	VkSurfaceCapabilitiesKHR surfaceCapabilities = getSurfaceCapabilities(surface, physicalDevice);
+	attachment.presentMode = getBestPresentMode(surface, physicalDevice, latencyMode);
+	uint32_t minImageCount = getSwapchainMinImageCount(surfaceCapabilities, attachment.presentMode, latencyMode);
 
-	attachment.extent = getBestSwapchainExtent(surfaceCapabilities, FramebufferWidth, FramebufferHeight);
+	attachment.extent = getBestSwapchainExtent(surfaceCapabilities, (int)framebufferExtent.width, (int)framebufferExtent.height);
 	attachment.surfaceFormat = getBestSurfaceFormat(surface, physicalDevice);
-	attachment.swapchain = createSwapChain(device, surface, surfaceCapabilities, attachment.surfaceFormat, attachment.extent, presentMode, imageArrayLayers, graphicsQueueMode);
+	attachment.swapchain = createSwapChain(device, surface, surfaceCapabilities, attachment.surfaceFormat, attachment.extent, attachment.presentMode, minImageCount, imageArrayLayers, graphicsQueueMode, oldSwapchain);
 	attachment.imageNum = getSwapchainImageNumber(device, attachment.swapchain);
+	printf("present mode: %s, swapchain images: %u\n", getPresentModeName(attachment.presentMode), attachment.imageNum);
 	attachment.images = getSwapchainImages(device, attachment.swapchain, attachment.imageNum);
 	attachment.imageViews = createImageViews(device, attachment.images, attachment.surfaceFormat, attachment.imageNum, imageArrayLayers);
 	return attachment;
@@ -149,20 +202,16 @@ swapchainAttachment createSwapchainAttachment(const VkDevice device, const VkPhy
 void deleteSwapchainAttachment(const VkDevice device, swapchainAttachment *pAttachment){
 	deleteImageViews(device, pAttachment->imageViews, pAttachment->imageNum);
 	deleteSwapchain(device, &pAttachment->swapchain);
+	//images are owned by the swapchain, only the handle array is ours
+	free(pAttachment->images);
 }
 
-uint32_t acquireNextImage(const VkDevice device, const VkSwapchainKHR swapchain, const uint64_t timeout, const VkSemaphore semaphore, const VkFence fence){
-	uint32_t imageIndex;
-	VkResult result = vkAcquireNextImageKHR(device, swapchain, timeout, semaphore, fence, &imageIndex);
-	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-		printf("swap chain out of date!\n");
-		exit(EXIT_FAILURE);
-	} else if (result == VK_SUBOPTIMAL_KHR) {
-		printf("swap chain suboptimal!\n");
-		exit(EXIT_FAILURE);
-    } else if (result != VK_SUCCESS) {
+//out of date and suboptimal are returned to the caller, which recreates the swapchain
+VkResult acquireNextImage(const VkDevice device, const VkSwapchainKHR swapchain, const uint64_t timeout, const VkSemaphore semaphore, const VkFence fence, uint32_t *pImageIndex){
+	VkResult result = vkAcquireNextImageKHR(device, swapchain, timeout, semaphore, fence, pImageIndex);
+	if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR && result != VK_ERROR_OUT_OF_DATE_KHR) {
 	    printf("failed to acquire swap chain image!\n");
 		exit(EXIT_FAILURE);
 	}
-	return imageIndex;
+	return result;
 }
\ No newline at end of file
@@ -0,0 +1,322 @@
+#include "vk_fun.h"
+
+//the history is fully overwritten every frame, then blitted to the swapchain image
+static VkRenderPass createTemporalRenderPass(const VkDevice device){
+	VkAttachmentDescription attachmentDescription = {
+		.flags = 0,
+		.format = TEMPORALHISTORYFORMAT,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+		.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+		.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+		.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+		.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+	};
+
+	VkAttachmentReference colorAttachmentReference = {
+		.attachment = 0,
+		.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+	};
+
+	VkSubpassDescription subpassDescription = {
+	    .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+	    .colorAttachmentCount = 1,
+		.pColorAttachments = &colorAttachmentReference,
+	    .pDepthStencilAttachment = VK_NULL_HANDLE,
+		.inputAttachmentCount = 0,
+		.pInputAttachments = NULL,
+		.pResolveAttachments = NULL,
+		.preserveAttachmentCount = 0,
+		.pPreserveAttachments = NULL
+	};
+
+	//the next frame slot read this history a frame ago and the blit read it last time it was written
+	VkSubpassDependency dependencies[] = {
+		{
+			.srcSubpass = VK_SUBPASS_EXTERNAL,
+			.dstSubpass = 0,
+			.srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			.srcAccessMask = 0,
+			.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+		},
+		{
+			.srcSubpass = 0,
+			.dstSubpass = VK_SUBPASS_EXTERNAL,
+			.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+			.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT
+		}
+	};
+
+	VkRenderPassCreateInfo renderPassCreateInfo = {
+		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+		.attachmentCount = 1,
+		.pAttachments = &attachmentDescription,
+		.subpassCount = 1,
+		.pSubpasses = &subpassDescription,
+		.dependencyCount = sizeof(dependencies) / sizeof(dependencies[0]),
+		.pDependencies = dependencies,
+		.flags = 0
+	};
+	VkRenderPass renderPass;
+	if(vkCreateRenderPass(device, &renderPassCreateInfo, VK_NULL_HANDLE, &renderPass) != VK_SUCCESS){fprintf(stderr, "Failed to create render pass\n");exit(EXIT_FAILURE);}
+	return renderPass;
+}
+
+//plain bilinear sampling, createSampler always enables depth comparison
+static VkSampler createTemporalSampler(const VkDevice device){
+	VkSamplerCreateInfo samplerInfo = {
+		.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+		.flags = 0,
+		.pNext = VK_NULL_HANDLE,
+		.magFilter = VK_FILTER_LINEAR,
+		.minFilter = VK_FILTER_LINEAR,
+		.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.anisotropyEnable = VK_FALSE,
+		.maxAnisotropy = 1.0f,
+		.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK,
+		.unnormalizedCoordinates = VK_FALSE,
+		.compareEnable = VK_FALSE,
+		.compareOp = VK_COMPARE_OP_ALWAYS,
+		.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+		.mipLodBias = 0.0f,
+		.minLod = 0.0f,
+		.maxLod = 0.0f
+	};
+	VkSampler sampler;
+	if(vkCreateSampler(device, &samplerInfo, VK_NULL_HANDLE, &sampler) != VK_SUCCESS){
+		fprintf(stderr, "Failed to create texture sampler\n");
+		exit(EXIT_FAILURE);
+	}
+	return sampler;
+}
+
+//current color, motion vectors, previous history and the per frame jitter
+static VkDescriptorSetLayout createTemporalSetLayout(const VkDevice device){
+	VkDescriptorSetLayoutBinding bindings[4];
+	for(uint32_t i = 0; i < 3; i++){
+		bindings[i] = (VkDescriptorSetLayoutBinding){
+			.binding = i,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+			.pImmutableSamplers = VK_NULL_HANDLE
+		};
+	}
+	bindings[3] = (VkDescriptorSetLayoutBinding){
+		.binding = 3,
+		.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+		.pImmutableSamplers = VK_NULL_HANDLE
+	};
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = sizeof(bindings) / sizeof(bindings[0]),
+		.pBindings = bindings
+	};
+	VkDescriptorSetLayout setLayout;
+	if(vkCreateDescriptorSetLayout(device, &layoutInfo, VK_NULL_HANDLE, &setLayout) != VK_SUCCESS){
+		fprintf(stderr, "Failed to create descriptor set layout\n");
+		exit(EXIT_FAILURE);
+	}
+	return setLayout;
+}
+
+static VkDescriptorPool createTemporalDescriptorPool(const VkDevice device, const uint32_t frameNum){
+	VkDescriptorPoolSize poolSizes[] = {
+		{
+			.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = 3 * frameNum
+		},
+		{
+			.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			.descriptorCount = frameNum
+		}
+	};
+	VkDescriptorPoolCreateInfo poolInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.poolSizeCount = sizeof(poolSizes) / sizeof(poolSizes[0]),
+		.pPoolSizes = poolSizes,
+		.maxSets = frameNum
+	};
+	VkDescriptorPool pool;
+	if(vkCreateDescriptorPool(device, &poolInfo, VK_NULL_HANDLE, &pool) != VK_SUCCESS){
+		fprintf(stderr, "Failed to create descriptor pool\n");
+		exit(EXIT_FAILURE);
+	}
+	return pool;
+}
+
+//radical inverse, index starts at 1 so the first sample is not the pixel corner
+static float halton(uint32_t index, const uint32_t base){
+	float result = 0.0f, fraction = 1.0f;
+	while(index > 0){
+		fraction /= base;
+		result += fraction * (index % base);
+		index /= base;
+	}
+	return result;
+}
+
+//histories start in SHADER_READ_ONLY so the first frame slot can bind its predecessor before it was ever written
+void createTemporalTargets(const VkDevice device, const VkPhysicalDevice physicalDevice, temporalResolve *pResolve, const VkExtent2D extent, const VkCommandPool commandPool, const VkQueue queue){
+	pResolve->extent = extent;
+	pResolve->historyFrames = 0;
+	pResolve->history = malloc(pResolve->frameNum * sizeof(frameBufferAttachment));
+	pResolve->frameBuffers = malloc(pResolve->frameNum * sizeof(VkFramebuffer));
+	pResolve->beginInfos = malloc(pResolve->frameNum * sizeof(VkRenderPassBeginInfo));
+	for(uint32_t i = 0; i < pResolve->frameNum; i++){
+		pResolve->history[i] = createFrameBufferAttachment(device, physicalDevice, extent.width, extent.height, TEMPORALHISTORYFORMAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_ASPECT_COLOR_BIT, 1, 0, VK_IMAGE_VIEW_TYPE_2D);
+		transferImageLayout(device, commandPool, queue, pResolve->history[i].image.image, 1, 0, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+
+		VkFramebufferCreateInfo framebufferCreateInfo = {
+			.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+			.renderPass = pResolve->renderPass,
+			.attachmentCount = 1,
+			.pAttachments = &pResolve->history[i].view,
+			.width = extent.width,
+			.height = extent.height,
+			.layers = 1
+		};
+		if(vkCreateFramebuffer(device, &framebufferCreateInfo, VK_NULL_HANDLE, &pResolve->frameBuffers[i]) != VK_SUCCESS){fprintf(stderr, "Failed to create frame buffer\n");exit(EXIT_FAILURE);}
+
+		pResolve->beginInfos[i] = (VkRenderPassBeginInfo){
+			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+			.pNext = VK_NULL_HANDLE,
+			.renderPass = pResolve->renderPass,
+			.framebuffer = pResolve->frameBuffers[i],
+			.renderArea = {{0, 0}, extent},
+			.clearValueCount = 0,
+			.pClearValues = VK_NULL_HANDLE
+		};
+	}
+}
+
+void deleteTemporalTargets(const VkDevice device, temporalResolve *pResolve){
+	for(uint32_t i = 0; i < pResolve->frameNum; i++){
+		vkDestroyFramebuffer(device, pResolve->frameBuffers[i], VK_NULL_HANDLE);
+		deleteFrameBufferAttachment(device, &pResolve->history[i]);
+	}
+	free(pResolve->history);
+	free(pResolve->frameBuffers);
+	free(pResolve->beginInfos);
+}
+
+//submits the history layout transitions on the queue with the command pool, both externally synchronized
+temporalResolve createTemporalResolve(const VkDevice device, const VkPhysicalDevice physicalDevice, const VkExtent2D extent, const uint32_t frameNum, const VkCommandPool commandPool, const VkQueue queue){
+	temporalResolve resolve;
+	resolve.frameNum = frameNum;
+	resolve.jitterIndex = 0;
+	resolve.renderPass = createTemporalRenderPass(device);
+	resolve.sampler = createTemporalSampler(device);
+	resolve.setLayout = createTemporalSetLayout(device);
+	resolve.pool = createTemporalDescriptorPool(device, frameNum);
+	resolve.uniforms = createTemporalUniformBuffers(device, physicalDevice, frameNum);
+	resolve.sets = malloc(frameNum * sizeof(VkDescriptorSet));
+	for(uint32_t i = 0; i < frameNum; i++){
+		VkDescriptorSetAllocateInfo allocInfo = {
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.descriptorPool = resolve.pool,
+			.descriptorSetCount = 1,
+			.pSetLayouts = &resolve.setLayout
+		};
+		if(vkAllocateDescriptorSets(device, &allocInfo, &resolve.sets[i]) != VK_SUCCESS){fprintf(stderr, "Failed to allocate descriptor sets\n");exit(EXIT_FAILURE);}
+	}
+	createTemporalTargets(device, physicalDevice, &resolve, extent, commandPool, queue);
+	return resolve;
+}
+
+void deleteTemporalResolve(const VkDevice device, temporalResolve *pResolve){
+	deleteTemporalTargets(device, pResolve);
+	deleteMappedBuffers(device, pResolve->uniforms, pResolve->frameNum);
+	//destroying the pool frees the sets
+	vkDestroyDescriptorPool(device, pResolve->pool, VK_NULL_HANDLE);
+	free(pResolve->sets);
+	vkDestroyDescriptorSetLayout(device, pResolve->setLayout, VK_NULL_HANDLE);
+	vkDestroySampler(device, pResolve->sampler, VK_NULL_HANDLE);
+	vkDestroyRenderPass(device, pResolve->renderPass, VK_NULL_HANDLE);
+}
+
+//only while no frame using the sets is in flight, after the scene targets or the histories were recreated
+void updateTemporalDescriptors(const VkDevice device, const temporalResolve *pResolve, const VkImageView colorView, const VkImageView velocityView){
+	for(uint32_t i = 0; i < pResolve->frameNum; i++){
+		const uint32_t previous = (i + pResolve->frameNum - 1) % pResolve->frameNum;
+		VkDescriptorImageInfo imageInfos[] = {
+			{pResolve->sampler, colorView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+			{pResolve->sampler, velocityView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+			{pResolve->sampler, pResolve->history[previous].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL}
+		};
+		VkDescriptorBufferInfo bufferInfo = {
+			.buffer = pResolve->uniforms[i].buffer.buffer,
+			.offset = 0,
+			.range = sizeof(uniformDataTemporal)
+		};
+		VkWriteDescriptorSet descriptorWrites[4];
+		for(uint32_t binding = 0; binding < 4; binding++){
+			descriptorWrites[binding] = (VkWriteDescriptorSet){
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = pResolve->sets[i],
+				.dstBinding = binding,
+				.dstArrayElement = 0,
+				.descriptorCount = 1,
+				.descriptorType = binding < 3 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+				.pImageInfo = binding < 3 ? &imageInfos[binding] : VK_NULL_HANDLE,
+				.pBufferInfo = binding < 3 ? VK_NULL_HANDLE : &bufferInfo
+			};
+		}
+		vkUpdateDescriptorSets(device, 4, descriptorWrites, 0, VK_NULL_HANDLE);
+	}
+}
+
+//sub-pixel offset of the next frame in normalized device coordinates, a halton(2, 3) sequence in render pixels
+void nextTemporalJitter(temporalResolve *pResolve, const VkExtent2D renderExtent, float jitter[2]){
+	const uint32_t index = pResolve->jitterIndex % TEMPORALJITTERPHASES + 1;
+	pResolve->jitterIndex++;
+	jitter[0] = (halton(index, 2) - 0.5f) * 2.0f / renderExtent.width;
+	jitter[1] = (halton(index, 3) - 0.5f) * 2.0f / renderExtent.height;
+}
+
+void updateTemporalUniforms(temporalResolve *pResolve, const uint32_t frame, const float jitter[2]){
+	uniformDataTemporal data = {
+		.jitter = {jitter[0] * 0.5f, jitter[1] * 0.5f},
+		.historyValid = pResolve->historyFrames > 0 ? 1.0f : 0.0f,
+		.feedback = TEMPORALFEEDBACK
+	};
+	memcpy(pResolve->uniforms[frame].pMappedData, &data, sizeof(data));
+	pResolve->historyFrames++;
+}
+
+//resolves into this frame slot's history, copies it to the target and hands it to the next slot for reading
+void recordTemporalResolve(const VkCommandBuffer commandBuffer, const temporalResolve *pResolve, const temporalPipe *pPipe, const uint32_t frame, const VkImage target, const VkExtent2D targetExtent, const VkImageLayout finalLayout){
+	vkCmdBeginRenderPass(commandBuffer, &pResolve->beginInfos[frame], VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdSetViewport(commandBuffer, 0, 1, &pPipe->viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &pPipe->scissor);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pPipe->pipe);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pPipe->layout, 0, 1, &pResolve->sets[frame], 0, VK_NULL_HANDLE);
+		vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+	vkCmdEndRenderPass(commandBuffer);
+
+	const VkImage history = pResolve->history[frame].image.image;
+	recordImageBlit(commandBuffer, history, pResolve->extent, VK_FILTER_NEAREST, target, targetExtent, finalLayout);
+
+	VkImageMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.pNext = VK_NULL_HANDLE,
+		.srcAccessMask = 0,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+		.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = history,
+		.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}
+	};
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 1, &barrier);
+}
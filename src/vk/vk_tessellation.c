@@ -0,0 +1,199 @@
+#include "vk_fun.h"
+
+static VkDescriptorSetLayout createTessellationSetLayout(const VkDevice device){
+	VkDescriptorSetLayoutBinding bindings[3];
+	for(uint32_t i = 0; i < 3; i++){
+		bindings[i] = (VkDescriptorSetLayoutBinding){
+			.binding = i,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+			.pImmutableSamplers = VK_NULL_HANDLE
+		};
+	}
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = sizeof(bindings) / sizeof(bindings[0]),
+		.pBindings = bindings
+	};
+	VkDescriptorSetLayout setLayout;
+	if(vkCreateDescriptorSetLayout(device, &layoutInfo, VK_NULL_HANDLE, &setLayout) != VK_SUCCESS){
+		fprintf(stderr, "Failed to create descriptor set layout\n");
+		exit(EXIT_FAILURE);
+	}
+	return setLayout;
+}
+
+static VkDescriptorPool createTessellationDescriptorPool(const VkDevice device, const uint32_t frameNum){
+	VkDescriptorPoolSize poolSize = {
+		.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		.descriptorCount = 3 * frameNum
+	};
+	VkDescriptorPoolCreateInfo poolInfo = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.poolSizeCount = 1,
+		.pPoolSizes = &poolSize,
+		.maxSets = frameNum
+	};
+	VkDescriptorPool pool;
+	if(vkCreateDescriptorPool(device, &poolInfo, VK_NULL_HANDLE, &pool) != VK_SUCCESS){
+		fprintf(stderr, "Failed to create descriptor pool\n");
+		exit(EXIT_FAILURE);
+	}
+	return pool;
+}
+
+//only for a frame slot whose fence was waited on, the cached command buffers key on the buffer handles
+static void writeTessellationDescriptors(const VkDevice device, const gpuTessellation *pTessellation, const uint32_t frame){
+	VkDescriptorBufferInfo bufferInfos[] = {
+		{pTessellation->objects[frame].buffer.buffer, 0, VK_WHOLE_SIZE},
+		{pTessellation->vertices[frame].buffer, 0, VK_WHOLE_SIZE},
+		{pTessellation->indices[frame].buffer, 0, VK_WHOLE_SIZE}
+	};
+	VkWriteDescriptorSet descriptorWrites[3];
+	for(uint32_t binding = 0; binding < 3; binding++){
+		descriptorWrites[binding] = (VkWriteDescriptorSet){
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = pTessellation->sets[frame],
+			.dstBinding = binding,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &bufferInfos[binding]
+		};
+	}
+	vkUpdateDescriptorSets(device, 3, descriptorWrites, 0, VK_NULL_HANDLE);
+}
+
+static void createObjectBuffer(const VkDevice device, const VkPhysicalDevice physicalDevice, gpuTessellation *pTessellation, const uint32_t frame, const uint32_t capacity){
+	pTessellation->objectCapacity[frame] = capacity;
+	pTessellation->objects[frame].buffer = createBuffer(device, physicalDevice, capacity * sizeof(obj3d), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	vkMapMemory(device, pTessellation->objects[frame].buffer.memory, 0, capacity * sizeof(obj3d), 0, &pTessellation->objects[frame].pMappedData);
+}
+
+static void createMeshBuffers(const VkDevice device, const VkPhysicalDevice physicalDevice, gpuTessellation *pTessellation, const uint32_t frame, const uint32_t vertexCapacity, const uint32_t indexCapacity){
+	pTessellation->vertexCapacity[frame] = vertexCapacity;
+	pTessellation->indexCapacity[frame] = indexCapacity;
+	pTessellation->vertices[frame] = createBuffer(device, physicalDevice, vertexCapacity * sizeof(vertex_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	pTessellation->indices[frame] = createBuffer(device, physicalDevice, indexCapacity * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+gpuTessellation createGpuTessellation(const VkDevice device, const VkPhysicalDevice physicalDevice, const uint32_t frameNum, const VkPipelineCache pipelineCache, shaderCache *pShaderCache){
+	gpuTessellation tessellation;
+	tessellation.frameNum = frameNum;
+	tessellation.generation = 0;
+	tessellation.setLayout = createTessellationSetLayout(device);
+	tessellation.pool = createTessellationDescriptorPool(device, frameNum);
+	tessellation.pipe = createTessellationPipe(device, &tessellation.setLayout, pipelineCache, pShaderCache);
+	tessellation.sets = malloc(frameNum * sizeof(VkDescriptorSet));
+	tessellation.objects = malloc(frameNum * sizeof(mappedBuffer));
+	tessellation.vertices = malloc(frameNum * sizeof(VkBufferandMemory));
+	tessellation.indices = malloc(frameNum * sizeof(VkBufferandMemory));
+	tessellation.objectCapacity = malloc(frameNum * sizeof(uint32_t));
+	tessellation.vertexCapacity = malloc(frameNum * sizeof(uint32_t));
+	tessellation.indexCapacity = malloc(frameNum * sizeof(uint32_t));
+	tessellation.counts = calloc(frameNum, sizeof(tessellationCounts));
+	tessellation.indexNum = calloc(frameNum, sizeof(uint32_t));
+	for(uint32_t i = 0; i < frameNum; i++){
+		VkDescriptorSetAllocateInfo allocInfo = {
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.descriptorPool = tessellation.pool,
+			.descriptorSetCount = 1,
+			.pSetLayouts = &tessellation.setLayout
+		};
+		if(vkAllocateDescriptorSets(device, &allocInfo, &tessellation.sets[i]) != VK_SUCCESS){fprintf(stderr, "Failed to allocate descriptor sets\n");exit(EXIT_FAILURE);}
+		//sized for ellipsoids, the largest meshes
+		createObjectBuffer(device, physicalDevice, &tessellation, i, TESSELLATIONMINOBJECTS);
+		createMeshBuffers(device, physicalDevice, &tessellation, i, TESSELLATIONMINOBJECTS * GpuVerticesPerEllipsoid, TESSELLATIONMINOBJECTS * GpuIndicesPerEllipsoid);
+		writeTessellationDescriptors(device, &tessellation, i);
+	}
+	return tessellation;
+}
+
+void deleteGpuTessellation(const VkDevice device, gpuTessellation *pTessellation){
+	for(uint32_t i = 0; i < pTessellation->frameNum; i++){
+		vkUnmapMemory(device, pTessellation->objects[i].buffer.memory);
+		deleteBuffer(device, &pTessellation->objects[i].buffer);
+		deleteBuffer(device, &pTessellation->vertices[i]);
+		deleteBuffer(device, &pTessellation->indices[i]);
+	}
+	deleteComputePipe(device, &pTessellation->pipe);
+	//destroying the pool frees the sets
+	vkDestroyDescriptorPool(device, pTessellation->pool, VK_NULL_HANDLE);
+	vkDestroyDescriptorSetLayout(device, pTessellation->setLayout, VK_NULL_HANDLE);
+	free(pTessellation->sets);
+	free(pTessellation->objects);
+	free(pTessellation->vertices);
+	free(pTessellation->indices);
+	free(pTessellation->objectCapacity);
+	free(pTessellation->vertexCapacity);
+	free(pTessellation->indexCapacity);
+	free(pTessellation->counts);
+	free(pTessellation->indexNum);
+}
+
+static uint32_t growCapacity(uint32_t capacity, const uint32_t needed){
+	while(capacity < needed){
+		capacity *= 2;
+	}
+	return capacity;
+}
+
+//call after the frame slot's fence, buffers only ever grow so a steady scene never reallocates
+void updateGpuTessellation(gpuTessellation *pTessellation, const VkDevice device, const VkPhysicalDevice physicalDevice, const uint32_t frame, const vec cuboids, const vec ellipsoids, const vec cylinders){
+	const tessellationCounts counts = {(uint32_t)cuboids.n, (uint32_t)ellipsoids.n, (uint32_t)cylinders.n};
+	const uint32_t objectNum = counts.cuboidNum + counts.ellipsoidNum + counts.cylinderNum;
+	const uint32_t vertexNum = counts.cuboidNum * VerticesPerCube + counts.ellipsoidNum * GpuVerticesPerEllipsoid + counts.cylinderNum * GpuVerticesPerEllipticCylinder;
+	const uint32_t indexNum = counts.cuboidNum * IndicesPerCube + counts.ellipsoidNum * GpuIndicesPerEllipsoid + counts.cylinderNum * GpuIndicesPerEllipticCylinder;
+
+	bool reallocated = false;
+	if(objectNum > pTessellation->objectCapacity[frame]){
+		vkUnmapMemory(device, pTessellation->objects[frame].buffer.memory);
+		deleteBuffer(device, &pTessellation->objects[frame].buffer);
+		createObjectBuffer(device, physicalDevice, pTessellation, frame, growCapacity(pTessellation->objectCapacity[frame], objectNum));
+		reallocated = true;
+	}
+	if(vertexNum > pTessellation->vertexCapacity[frame] || indexNum > pTessellation->indexCapacity[frame]){
+		deleteBuffer(device, &pTessellation->vertices[frame]);
+		deleteBuffer(device, &pTessellation->indices[frame]);
+		createMeshBuffers(device, physicalDevice, pTessellation, frame, growCapacity(pTessellation->vertexCapacity[frame], vertexNum), growCapacity(pTessellation->indexCapacity[frame], indexNum));
+		reallocated = true;
+	}
+	if(reallocated){
+		writeTessellationDescriptors(device, pTessellation, frame);
+		pTessellation->generation++;
+	}
+
+	//a few dozen bytes per object is all the cpu uploads
+	obj3d *pObjects = pTessellation->objects[frame].pMappedData;
+	const vec *types[] = {&cuboids, &ellipsoids, &cylinders};
+	for(uint32_t i = 0; i < 3; i++){
+		if(types[i]->n > 0){
+			memcpy(pObjects, types[i]->array, types[i]->n * sizeof(obj3d));
+			pObjects += types[i]->n;
+		}
+	}
+	pTessellation->counts[frame] = counts;
+	pTessellation->indexNum[frame] = indexNum;
+}
+
+//one workgroup per object, the shadow and scene passes read the results as vertex and index buffers
+void recordGpuTessellation(const VkCommandBuffer commandBuffer, const gpuTessellation *pTessellation, const uint32_t frame){
+	const tessellationCounts counts = pTessellation->counts[frame];
+	const uint32_t objectNum = counts.cuboidNum + counts.ellipsoidNum + counts.cylinderNum;
+	if(objectNum == 0){
+		return;
+	}
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pTessellation->pipe.pipe);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pTessellation->pipe.layout, 0, 1, &pTessellation->sets[frame], 0, VK_NULL_HANDLE);
+	vkCmdPushConstants(commandBuffer, pTessellation->pipe.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(counts), &counts);
+	vkCmdDispatch(commandBuffer, objectNum, 1, 1);
+
+	VkMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.pNext = VK_NULL_HANDLE,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT
+	};
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+}
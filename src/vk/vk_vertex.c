@@ -1,18 +1,26 @@
 #include "vk_fun.h"
 
 
-uint32_t findMemoryType(const uint32_t typeFilter, const VkMemoryPropertyFlags properties, const VkPhysicalDevice physicalDevice) {
+bool findMemoryTypeIndex(const uint32_t typeFilter, const VkMemoryPropertyFlags properties, const VkPhysicalDevice physicalDevice, uint32_t *pIndex) {
     VkPhysicalDeviceMemoryProperties memProperties;
     vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
 
     for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
         if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-            return i;
+            *pIndex = i;
+            return true;
         }
     }
+    return false;
+}
 
-    fprintf(stderr, "failed to find suitable memory type!\n");
-    exit(EXIT_FAILURE);
+uint32_t findMemoryType(const uint32_t typeFilter, const VkMemoryPropertyFlags properties, const VkPhysicalDevice physicalDevice) {
+    uint32_t index;
+    if (!findMemoryTypeIndex(typeFilter, properties, physicalDevice, &index)) {
+        fprintf(stderr, "failed to find suitable memory type!\n");
+        exit(EXIT_FAILURE);
+    }
+    return index;
 }
 
 static VkBufferCreateInfo getBufferCreateInfo(const uint32_t bufferSize, const VkBufferUsageFlags usage) {
@@ -29,7 +37,7 @@ static VkBufferCreateInfo getBufferCreateInfo(const uint32_t bufferSize, const V
     return bufferCreateInfo;
 }
 
-static VkBufferandMemory createBuffer(const VkDevice device, const VkPhysicalDevice physicalDevice, const uint32_t bufferSize, const VkBufferUsageFlags usage, const VkMemoryPropertyFlags properties) {
+VkBufferandMemory createBuffer(const VkDevice device, const VkPhysicalDevice physicalDevice, const uint32_t bufferSize, const VkBufferUsageFlags usage, const VkMemoryPropertyFlags properties) {
     VkBufferandMemory bufferandMemory;
     VkBufferCreateInfo bufferCreateInfo = getBufferCreateInfo(bufferSize, usage);
     //printf("Buffer size: %d\n", bufferSize);
@@ -104,6 +112,17 @@ mappedBuffer *createSceneUniformBuffers(const VkDevice device, const VkPhysicalD
     return uniformBuffers;
 }
 
+mappedBuffer *createTemporalUniformBuffers(const VkDevice device, const VkPhysicalDevice physicalDevice, const uint32_t maxFrames) {
+    VkDeviceSize bufferSize = sizeof(uniformDataTemporal);
+    mappedBuffer *uniformBuffers = malloc(maxFrames * sizeof(mappedBuffer));
+
+    for (uint32_t i = 0; i < maxFrames; i++) {
+        uniformBuffers[i].buffer = createBuffer(device, physicalDevice, bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        vkMapMemory(device, uniformBuffers[i].buffer.memory, 0, bufferSize, 0, &uniformBuffers[i].pMappedData);
+    }
+    return uniformBuffers;
+}
+
 mappedBuffer createOffScreenUniformBuffer(const VkDevice device, const VkPhysicalDevice physicalDevice) {
     VkDeviceSize bufferSize = sizeof(uniformDataOffscreen);
     mappedBuffer uniformBuffer;
@@ -112,6 +131,13 @@ mappedBuffer createOffScreenUniformBuffer(const VkDevice device, const VkPhysica
     return uniformBuffer;
 }
 
+mappedBuffer createReadbackBuffer(const VkDevice device, const VkPhysicalDevice physicalDevice, const VkDeviceSize size) {
+    mappedBuffer readbackBuffer;
+    readbackBuffer.buffer = createBuffer(device, physicalDevice, (uint32_t)size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    vkMapMemory(device, readbackBuffer.buffer.memory, 0, size, 0, &readbackBuffer.pMappedData);
+    return readbackBuffer;
+}
+
 void deleteMappedBuffers(const VkDevice device, mappedBuffer *buffers, const uint32_t bufferNum) {
     for (uint32_t i = 0; i < bufferNum; i++) {
         vkUnmapMemory(device, buffers[i].buffer.memory);
@@ -126,6 +152,7 @@ dynamicBuffers createDynamicBuffers(const VkDevice device, const VkPhysicalDevic
     dynamicBuffers buffers;
     buffers.buffers = malloc(frameNum * sizeof(vertexAndIndexBuffers));
     buffers.staging = malloc(frameNum * sizeof(stagingBufferAttachment));
+    buffers.generation = 0;
 
     for(uint32_t i = 0; i < frameNum; i++){
         //staging buffers
@@ -161,9 +188,13 @@ void deleteDynamicBuffers(const VkDevice device, dynamicBuffers *pBuffers, const
     free(pBuffers->staging);
 }
 
-void updateDynamicBuffers(dynamicBuffers *pBuffers, const vec indices, const vec vertices, const VkCommandBuffer commandBuffer, const VkDevice device, const VkPhysicalDevice physicalDevice, const uint32_t currentFrame){
+void updateDynamicBuffers(dynamicBuffers *pBuffers, const vec indices, const vec vertices, const VkDevice device, const VkPhysicalDevice physicalDevice, const uint32_t currentFrame){
     uint32_t indexSize = indices.c * indices.elemSize;
     uint32_t vertexSize = vertices.c * vertices.elemSize;
+    if(pBuffers->staging[currentFrame].indexBufferSize != indexSize || pBuffers->staging[currentFrame].vertexBufferSize != vertexSize
+        || pBuffers->buffers[currentFrame].indexBufferSize != indexSize || pBuffers->buffers[currentFrame].vertexBufferSize != vertexSize){
+        pBuffers->generation++;
+    }
 
     if(pBuffers->staging[currentFrame].indexBufferSize != indexSize){
         //(printf("createing new staging index buffer for buffers %d, currently used buffers %d in current frame %d\n", currentFrame, pBuffers->preparedBufferIndex, currentFrame);
@@ -199,6 +230,9 @@ void updateDynamicBuffers(dynamicBuffers *pBuffers, const vec indices, const vec
 
     memcpy(pBuffers->staging[currentFrame].vertex.pMappedData, vertices.array, vertices.n * vertices.elemSize);
     memcpy(pBuffers->staging[currentFrame].index.pMappedData, indices.array, indices.n * indices.elemSize);
+}
+
+void copyDynamicBuffers(const dynamicBuffers *pBuffers, const vec indices, const vec vertices, const VkCommandBuffer commandBuffer, const uint32_t currentFrame){
     VkBufferCopy copyRegion = {
         .srcOffset = 0,
         .dstOffset = 0,
@@ -208,4 +242,70 @@ void updateDynamicBuffers(dynamicBuffers *pBuffers, const vec indices, const vec
     vkCmdCopyBuffer(commandBuffer, pBuffers->staging[currentFrame].vertex.buffer.buffer, pBuffers->buffers[currentFrame].vertex.buffer, 1, &copyRegion);
     copyRegion.size = indices.n * indices.elemSize;
     vkCmdCopyBuffer(commandBuffer, pBuffers->staging[currentFrame].index.buffer.buffer, pBuffers->buffers[currentFrame].index.buffer, 1, &copyRegion);
-}
\ No newline at end of file
+}
+//instances take the same staging path as the vertices, sized by the capacity of the vector
+quadricBuffers createQuadricBuffers(const VkDevice device, const VkPhysicalDevice physicalDevice, const vec quadrics, const uint32_t frameNum){
+    quadricBuffers buffers;
+    buffers.buffers = malloc(frameNum * sizeof(VkBufferandMemory));
+    buffers.staging = malloc(frameNum * sizeof(mappedBuffer));
+    buffers.bufferSizes = malloc(frameNum * sizeof(uint32_t));
+    buffers.generation = 0;
+    for(uint32_t i = 0; i < frameNum; i++){
+        buffers.bufferSizes[i] = quadrics.c * quadrics.elemSize;
+        buffers.staging[i].buffer = createBuffer(device, physicalDevice, buffers.bufferSizes[i], VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        vkMapMemory(device, buffers.staging[i].buffer.memory, 0, buffers.bufferSizes[i], 0, &buffers.staging[i].pMappedData);
+        buffers.buffers[i] = createBuffer(device, physicalDevice, buffers.bufferSizes[i], VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+    return buffers;
+}
+
+void deleteQuadricBuffers(const VkDevice device, quadricBuffers *pBuffers, const uint32_t frameNum){
+    for(uint32_t i = 0; i < frameNum; i++){
+        vkUnmapMemory(device, pBuffers->staging[i].buffer.memory);
+        deleteBuffer(device, &pBuffers->staging[i].buffer);
+        deleteBuffer(device, &pBuffers->buffers[i]);
+    }
+    free(pBuffers->buffers);
+    free(pBuffers->staging);
+    free(pBuffers->bufferSizes);
+}
+
+void updateQuadricBuffers(quadricBuffers *pBuffers, const vec quadrics, const VkDevice device, const VkPhysicalDevice physicalDevice, const uint32_t currentFrame){
+    uint32_t size = quadrics.c * quadrics.elemSize;
+    if(pBuffers->bufferSizes[currentFrame] != size){
+        pBuffers->bufferSizes[currentFrame] = size;
+        pBuffers->generation++;
+        vkUnmapMemory(device, pBuffers->staging[currentFrame].buffer.memory);
+        deleteBuffer(device, &pBuffers->staging[currentFrame].buffer);
+        pBuffers->staging[currentFrame].buffer = createBuffer(device, physicalDevice, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        vkMapMemory(device, pBuffers->staging[currentFrame].buffer.memory, 0, size, 0, &pBuffers->staging[currentFrame].pMappedData);
+        deleteBuffer(device, &pBuffers->buffers[currentFrame]);
+        pBuffers->buffers[currentFrame] = createBuffer(device, physicalDevice, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+    memcpy(pBuffers->staging[currentFrame].pMappedData, quadrics.array, quadrics.n * quadrics.elemSize);
+}
+
+//the copy finishes before the shadow and scene passes read the instances
+void copyQuadricBuffers(const quadricBuffers *pBuffers, const vec quadrics, const VkCommandBuffer commandBuffer, const uint32_t currentFrame){
+    if(quadrics.n == 0){
+        return;
+    }
+    VkBufferCopy copyRegion = {
+        .srcOffset = 0,
+        .dstOffset = 0,
+        .size = quadrics.n * quadrics.elemSize
+    };
+    vkCmdCopyBuffer(commandBuffer, pBuffers->staging[currentFrame].buffer.buffer, pBuffers->buffers[currentFrame].buffer, 1, &copyRegion);
+    VkBufferMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .pNext = VK_NULL_HANDLE,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = pBuffers->buffers[currentFrame].buffer,
+        .offset = 0,
+        .size = copyRegion.size
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, VK_NULL_HANDLE, 1, &barrier, 0, VK_NULL_HANDLE);
+}